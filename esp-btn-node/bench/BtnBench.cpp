@@ -0,0 +1,135 @@
+/**
+ * BtnBench.cpp
+ *
+ * Host benchmark of the button sampling, built by env:native_bench.
+ * <p>
+ * Measures the cost of sampling the wired buttons once: a tick() of one
+ * OneButton per button, against one BtnSampler::sample() of the vertical
+ * counter, alone and followed by the loop side classification. The pins
+ * change level every BENCH_TOGGLE_PASSES passes, so both sides also run
+ * through their debounce and click paths. The sampler runs on its own clock
+ * of BTN_SAMPLE_PERIOD ms per sample, OneButton on millis(), so the event
+ * counts only show that the click paths were taken. Run with
+ * ESPNODE_NATIVE_LOOPS=1.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include <Arduino.h>
+#include <OneButton.h>
+#include "BtnSampler.h"
+
+const static int BENCH_PASSES = 200000;     // Sample passes per measurement
+const static int BENCH_TOGGLE_PASSES = 100; // Passes between two pin level changes, 500 ms on the sampler clock
+const static int BENCH_MAX_BUTTONS = 13;    // Usable digital pins of the ESP8266
+
+const int benchPins[BENCH_MAX_BUTTONS] = {D0, D1, D2, D3, D4, D5, D6, D7, D8, 1, 3, 9, 10};
+const uint8_t benchCnts[] = {1, 4, 8, BENCH_MAX_BUTTONS};
+
+unsigned long benchEvents = 0;
+
+void benchToggle(uint8_t cnt, int pass)
+{
+  if (pass % BENCH_TOGGLE_PASSES != 0)
+  {
+    return;
+  }
+
+  for (uint8_t index = 0; index < cnt; index++)
+  {
+    nativeSetPin(benchPins[index], (pass / BENCH_TOGGLE_PASSES) & 0x01);
+  }
+}
+
+void benchResetPins()
+{
+  for (uint8_t index = 0; index < BENCH_MAX_BUTTONS; index++)
+  {
+    nativeSetPin(benchPins[index], LOW);
+  }
+}
+
+unsigned long benchOneButton(uint8_t cnt)
+{
+  OneButton *buttons[BENCH_MAX_BUTTONS];
+  for (uint8_t index = 0; index < cnt; index++)
+  {
+    buttons[index] = new OneButton(benchPins[index], false, false);
+    buttons[index]->attachClick([](void *)
+                                { benchEvents++; },
+                                nullptr);
+    buttons[index]->attachLongPressStart([](void *)
+                                         { benchEvents++; },
+                                         nullptr);
+  }
+
+  benchResetPins();
+  unsigned long start = micros();
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    benchToggle(cnt, pass);
+    for (uint8_t index = 0; index < cnt; index++)
+    {
+      buttons[index]->tick();
+    }
+  }
+  unsigned long passed = micros() - start;
+
+  for (uint8_t index = 0; index < cnt; index++)
+  {
+    delete buttons[index];
+  }
+
+  return passed;
+}
+
+unsigned long benchSampler(uint8_t cnt, bool classify)
+{
+  BtnSampler *sampler = new BtnSampler();
+  sampler->attach(benchPins, cnt, [](uint8_t button, uint8_t type)
+                  { benchEvents++; });
+
+  benchResetPins();
+  unsigned long start = micros();
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    benchToggle(cnt, pass);
+    sampler->sample();
+    if (classify)
+    {
+      sampler->loop();
+    }
+  }
+  unsigned long passed = micros() - start;
+
+  delete sampler;
+  return passed;
+}
+
+void setup()
+{
+  for (uint8_t cnt : benchCnts)
+  {
+    benchEvents = 0;
+    unsigned long oneButton = benchOneButton(cnt);
+    unsigned long oneButtonEvents = benchEvents;
+
+    unsigned long sample = benchSampler(cnt, false);
+
+    benchEvents = 0;
+    unsigned long sampler = benchSampler(cnt, true);
+
+    printf("BENCH: buttons=%u oneButton=%.1fns/pass (%lu events) sample=%.1fns/pass sampleAndClassify=%.1fns/pass (%lu events)\n",
+           cnt,
+           oneButton * 1000.0 / BENCH_PASSES, oneButtonEvents,
+           sample * 1000.0 / BENCH_PASSES,
+           sampler * 1000.0 / BENCH_PASSES, benchEvents);
+  }
+}
+
+void loop()
+{
+}
@@ -0,0 +1,109 @@
+/**
+ * EspNodeDetector.h
+ *
+ * Threshold detector with hysteresis and hold time for EspNode sensors.
+ * <p>
+ * A signal is detected once its value reaches the threshold and stays
+ * detected while it doesn't fall below the threshold minus the hysteresis
+ * band. After the last value in that range the detection is held for the
+ * hold time, so a sensor flickering at its threshold neither flaps nor
+ * floods the broker. The state is published to the node topic given to
+ * begin(), interned once, with the static payloads below.
+ * <p>
+ * The hysteresis is a property of the signal and given as template
+ * parameter, threshold and hold time may come from the node configuration.
+ * evaluate() only works on the given value and time stamp, it neither reads
+ * the clock nor publishes, so it runs on the host as is.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef EspNodeDetector_h
+#define EspNodeDetector_h
+
+#include "EspNode.h"
+
+const char DETECTOR_PAYLOAD_DETECTED[] = "detected"; // Payload of a detected signal
+const char DETECTOR_PAYLOAD_NONE[] = "none";         // Payload of a signal not detected
+
+template <typename T, T Hysteresis = 0>
+class EspNodeDetector
+{
+public:
+  EspNodeDetector(T threshold, unsigned long holdMillis) : _threshold(threshold), _holdMillis(holdMillis)
+  {
+  }
+
+  void begin(EspNode *node, const char *subTopic)
+  {
+    _node = node;
+    _topic = node->mqttInternNodeTopic(subTopic);
+  }
+
+  void setThreshold(T threshold) { _threshold = threshold; }
+  void setHoldMillis(unsigned long holdMillis) { _holdMillis = holdMillis; }
+
+  // Evaluates the value at now, returns true if the state changed
+  bool evaluate(T value, unsigned long now)
+  {
+    // Once detected, the threshold drops by the hysteresis band, unless that leaves no value to release at
+    bool active = (value >= _threshold);
+    if (_detected && !active && _threshold > Hysteresis)
+    {
+      active = (value >= _threshold - Hysteresis);
+    }
+
+    if (active)
+    {
+      _activeMillis = now;
+      if (!_detected)
+      {
+        _detected = true;
+        return true;
+      }
+    }
+    else if (_detected && now - _activeMillis >= _holdMillis)
+    {
+      _detected = false;
+      return true;
+    }
+
+    return false;
+  }
+
+  // Evaluates the value now and publishes a changed state, returns true if the state changed
+  bool update(T value)
+  {
+    if (!evaluate(value, millis()))
+    {
+      return false;
+    }
+
+    publish();
+    return true;
+  }
+
+  void publish()
+  {
+    if (_node != nullptr)
+    {
+      _node->mqttSend(_topic, payload());
+    }
+  }
+
+  bool detected() const { return _detected; }
+  const char *payload() const { return _detected ? DETECTOR_PAYLOAD_DETECTED : DETECTOR_PAYLOAD_NONE; }
+
+private:
+  T _threshold;
+  unsigned long _holdMillis;
+  EspNode *_node = nullptr;
+  const char *_topic = nullptr;
+  bool _detected = false;
+  unsigned long _activeMillis = 0; // Time stamp of the last value above the released threshold
+};
+
+#endif
@@ -0,0 +1,23 @@
+/**
+ * EspNodePortal.h
+ *
+ * WiFi connection and config portal of EspNode, backed by WiFiManager.
+ * <p>
+ * Kept in its own translation unit so EspNode does not pull in the
+ * synchronous web server headers, which clash with the async backend.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef EspNodePortal_h
+#define EspNodePortal_h
+
+#include <Arduino.h>
+
+void espNodePortalConnect(const char *apName, unsigned long connectTimeout, unsigned long portalTimeout);
+void espNodePortalReset();
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * EspNodeTelemetry.cpp
+ *
+ * Deadband publisher of analog telemetry values, see EspNodeTelemetry.h.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "EspNodeTelemetry.h"
+
+EspNodeTelemetry::EspNodeTelemetry(float absDeadband, float relDeadband, unsigned long minIntervalMillis, unsigned long heartbeatMillis, uint8_t decimals)
+    : _absDeadband(absDeadband), _relDeadband(relDeadband), _minIntervalMillis(minIntervalMillis), _heartbeatMillis(heartbeatMillis), _decimals(decimals)
+{
+}
+
+void EspNodeTelemetry::begin(EspNode *node, const char *subTopic)
+{
+  _node = node;
+  _topic = node->mqttInternNodeTopic(subTopic);
+}
+
+bool EspNodeTelemetry::evaluate(float value, unsigned long now)
+{
+  _value = value;
+  _hasValue = true;
+
+  if (_hasPublished)
+  {
+    unsigned long passed = now - _publishMillis;
+    if (passed < _minIntervalMillis)
+    {
+      return false;
+    }
+
+    float deadband = max(_absDeadband, _relDeadband * fabsf(_published));
+    bool changed = (fabsf(value - _published) > deadband);
+    bool heartbeat = (_heartbeatMillis > 0 && passed >= _heartbeatMillis);
+    if (!changed && !heartbeat)
+    {
+      return false;
+    }
+  }
+
+  _hasPublished = true;
+  _published = value;
+  _publishMillis = now;
+  return true;
+}
+
+bool EspNodeTelemetry::update(float value)
+{
+  if (!evaluate(value, millis()))
+  {
+    return false;
+  }
+
+  _send();
+  return true;
+}
+
+void EspNodeTelemetry::publish()
+{
+  // Sends the latest value regardless of the deadband, e.g. when the broker connection is back
+  if (!_hasValue)
+  {
+    return;
+  }
+
+  _hasPublished = true;
+  _published = _value;
+  _publishMillis = millis();
+  _send();
+}
+
+void EspNodeTelemetry::_send()
+{
+  if (_node == nullptr)
+  {
+    return;
+  }
+
+  char payload[TELEMETRY_PAYLOAD_SIZE];
+  snprintf(payload, sizeof(payload), "%.*f", _decimals, _published);
+  _node->mqttSend(_topic, payload);
+}
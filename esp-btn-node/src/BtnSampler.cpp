@@ -0,0 +1,208 @@
+/**
+ * BtnSampler.cpp
+ *
+ * Timer driven button sampling of esp-btn-node, see BtnSampler.h.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifdef BTN_TIMER_SAMPLING
+
+#include "BtnSampler.h"
+
+BtnSampler *BtnSampler::_instance = nullptr;
+
+bool BtnEdgeQueue::pop(BtnEdge &edge)
+{
+  uint8_t head = _head.load(std::memory_order_relaxed);
+  if (head == _tail.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+
+  edge = _edges[head];
+  _head.store((head + 1) & (BTN_EDGE_QUEUE_SIZE - 1), std::memory_order_release);
+  return true;
+}
+
+void BtnSampler::attach(const int *pins, uint8_t cnt, BtnEventCallback callback)
+{
+  _pins = pins;
+  _cnt = min(cnt, (uint8_t)BTN_SAMPLER_MAX_BUTTONS);
+  _callback = callback;
+
+  for (uint8_t button = 0; button < _cnt; button++)
+  {
+    _buttonMask[button] = ((BtnPinWord)1 << _pins[button]);
+    _pinMask |= _buttonMask[button];
+
+#ifdef ESP8266
+    if (_pins[button] == A0)
+    {
+      _analog = true;
+      continue;
+    }
+#endif
+    pinMode(_pins[button], INPUT);
+  }
+}
+
+void BtnSampler::begin(const int *pins, uint8_t cnt, BtnEventCallback callback)
+{
+  attach(pins, cnt, callback);
+
+  // The interrupt has no context, only one sampler can run
+  _instance = this;
+
+#ifdef ESP8266
+  timer1_attachInterrupt(_onTimer);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+  timer1_write(BTN_SAMPLE_PERIOD * 5000); // 5 MHz after the divider
+#elif ESP32
+  _timer = timerBegin(0, 80, true); // 1 MHz after the divider
+  timerAttachInterrupt(_timer, _onTimer, true);
+  timerAlarmWrite(_timer, BTN_SAMPLE_PERIOD * 1000, true);
+  timerAlarmEnable(_timer);
+#endif
+}
+
+void IRAM_ATTR BtnSampler::_onTimer()
+{
+  if (_instance != nullptr)
+  {
+    _instance->sample();
+  }
+}
+
+void IRAM_ATTR BtnSampler::sample()
+{
+  uint32_t ticks = _ticks + 1;
+  BtnPinWord delta = (_readPins() & _pinMask) ^ _stable;
+
+  // Count the samples each pin differs from its debounced level, a bounce back restarts the count
+  _count2 = (_count2 ^ (_count1 & _count0)) & delta;
+  _count1 = (_count1 ^ _count0) & delta;
+  _count0 = ~_count0 & delta;
+
+  // A counter wrapping to zero held the new level for BTN_DEBOUNCE_SAMPLES samples
+  BtnPinWord toggle = delta & ~(_count0 | _count1 | _count2);
+  if (toggle != 0)
+  {
+    _stable ^= toggle;
+
+    uint32_t time = ticks * BTN_SAMPLE_PERIOD;
+    for (uint8_t button = 0; button < _cnt; button++)
+    {
+      if (toggle & _buttonMask[button])
+      {
+        _queue.push(time, button, (_stable & _buttonMask[button]) != 0);
+      }
+    }
+  }
+
+  // Advanced after the edges are queued, the loop never sees a time ahead of a pending edge
+  _ticks = ticks;
+}
+
+void BtnSampler::loop()
+{
+  // Hand the A0 level over to the interrupt, once per sample period is enough
+#ifdef ESP8266
+  if (_analog && _analogRead != _ticks)
+  {
+    _analogRead = _ticks;
+    _analogLevel = (analogRead(A0) > BTN_ANALOG_THRESHOLD) ? ((BtnPinWord)1 << A0) : 0;
+  }
+#endif
+
+  // Classify on the recorded time stamps, a late loop doesn't change the click
+  BtnEdge edge;
+  while (_queue.pop(edge))
+  {
+    _edge(edge.button, edge.pressed, edge.time);
+  }
+
+  // Read after draining, no edge older than this time is left in the queue
+  uint32_t time = now();
+  for (uint32_t busy = _busy; busy != 0; busy &= (busy - 1))
+  {
+    _timeout(__builtin_ctz(busy), time);
+  }
+}
+
+void BtnSampler::_edge(uint8_t button, bool pressed, uint32_t time)
+{
+  // Timeouts that ran out before this edge come first
+  _timeout(button, time);
+
+  BtnClick &click = _clicks[button];
+  if (pressed)
+  {
+    if (click.state == BTN_STATE_IDLE)
+    {
+      _busy |= (1UL << button);
+      click.clicks = 0;
+      click.state = BTN_STATE_DOWN;
+      click.start = time;
+    }
+    else if (click.state == BTN_STATE_UP)
+    {
+      click.state = BTN_STATE_DOWN;
+      click.start = time;
+    }
+  }
+  else
+  {
+    if (click.state == BTN_STATE_DOWN)
+    {
+      click.clicks++;
+      click.state = BTN_STATE_UP;
+      click.start = time;
+    }
+    else if (click.state == BTN_STATE_LONG)
+    {
+      _busy &= ~(1UL << button);
+      click.state = BTN_STATE_IDLE;
+    }
+  }
+}
+
+void BtnSampler::_timeout(uint8_t button, uint32_t time)
+{
+  BtnClick &click = _clicks[button];
+
+  if (click.state == BTN_STATE_DOWN && time - click.start >= BTN_PRESS_MS)
+  {
+    click.state = BTN_STATE_LONG;
+    _emit(button, BTN_TYPE_LONG);
+  }
+  else if (click.state == BTN_STATE_UP && time - click.start > BTN_CLICK_MS)
+  {
+    _busy &= ~(1UL << button);
+    click.state = BTN_STATE_IDLE;
+
+    uint8_t type = BTN_TYPE_MULTI;
+    if (click.clicks == 1)
+    {
+      type = BTN_TYPE_SINGLE;
+    }
+    else if (click.clicks == 2)
+    {
+      type = BTN_TYPE_DOUBLE;
+    }
+    _emit(button, type);
+  }
+}
+
+void BtnSampler::_emit(uint8_t button, uint8_t type)
+{
+  if (_callback != nullptr)
+  {
+    _callback(button, type);
+  }
+}
+
+#endif
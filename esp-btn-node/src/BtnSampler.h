@@ -0,0 +1,170 @@
+/**
+ * BtnSampler.h
+ *
+ * Timer driven button sampling of esp-btn-node, built with -D BTN_TIMER_SAMPLING.
+ * <p>
+ * A hardware timer interrupt reads all buttons every BTN_SAMPLE_PERIOD ms
+ * with one read of the GPIO input registers and debounces them at once with
+ * a vertical counter, a 3 bit counter per pin kept in three words and
+ * advanced with bitwise operations. The cost of a sample is the same for one
+ * or all pins. Each debounced edge is recorded with its time stamp in a
+ * lock-free single producer/single consumer queue. The loop drains
+ * the queue and classifies the edges into single, double, multi and long
+ * clicks with the timing of OneButton. As the classification works on the
+ * recorded time stamps, a loop blocked by MQTT or the web server delays a
+ * click, but neither misses nor misclassifies it.
+ * <p>
+ * ESP8266 uses timer1, which is shared with analogWrite(), tone() and Servo.
+ * The analog A0 button can't be read in the interrupt, its level is read by
+ * the loop and handed to the interrupt as bit A0 of the pin word.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef BtnSampler_h
+#define BtnSampler_h
+
+#include <Arduino.h>
+#include <atomic>
+#ifdef ESP32
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+#endif
+
+#define BTN_TYPE_SINGLE 1
+#define BTN_TYPE_DOUBLE 2
+#define BTN_TYPE_MULTI 3
+#define BTN_TYPE_LONG 4
+
+const static int BTN_SAMPLE_PERIOD = 5;          // Sampling period of the button timer in ms
+const static int BTN_DEBOUNCE_SAMPLES = 8;       // Equal samples needed to accept a level change, fixed by the 3 bit vertical counter
+const static int BTN_EDGE_QUEUE_SIZE = 32;       // Edges held for the loop, must be a power of two
+const static int BTN_SAMPLER_MAX_BUTTONS = 32;   // Buttons fitting in the level bit masks
+const static int BTN_ANALOG_THRESHOLD = 100;     // analogRead() level above which the A0 button is pressed
+const unsigned long BTN_CLICK_MS = 400;          // Max. time after a release to count a further click, like OneButton
+const unsigned long BTN_PRESS_MS = 800;          // Time held down to detect a long press, like OneButton
+
+typedef void (*BtnEventCallback)(uint8_t button, uint8_t type);
+
+#ifdef ESP32
+typedef uint64_t BtnPinWord; // GPIO 0-39, GPIO_IN_REG and GPIO_IN1_REG
+#else
+typedef uint32_t BtnPinWord; // GPIO 0-16 and A0
+#endif
+
+struct BtnEdge
+{
+  uint32_t time;  // ms on the sampler clock
+  uint8_t button; // index into the pins given to begin()
+  bool pressed;
+};
+
+class BtnEdgeQueue
+{
+public:
+  // Producer side, called from the timer interrupt only
+  inline bool IRAM_ATTR push(uint32_t time, uint8_t button, bool pressed)
+  {
+    uint8_t tail = _tail.load(std::memory_order_relaxed);
+    uint8_t next = (tail + 1) & (BTN_EDGE_QUEUE_SIZE - 1);
+    if (next == _head.load(std::memory_order_acquire))
+    {
+      _dropped++;
+      return false;
+    }
+
+    _edges[tail].time = time;
+    _edges[tail].button = button;
+    _edges[tail].pressed = pressed;
+    _tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, called from the loop only
+  bool pop(BtnEdge &edge);
+  uint32_t dropped() { return _dropped; }
+
+private:
+  BtnEdge _edges[BTN_EDGE_QUEUE_SIZE];
+  std::atomic<uint8_t> _head{0}; // Next edge to read, written by the consumer
+  std::atomic<uint8_t> _tail{0}; // Next free slot, written by the producer
+  volatile uint32_t _dropped = 0;
+};
+
+class BtnSampler
+{
+public:
+  void attach(const int *pins, uint8_t cnt, BtnEventCallback callback);
+  void begin(const int *pins, uint8_t cnt, BtnEventCallback callback);
+  void loop();
+
+  // Called by the timer interrupt, public for the host benchmark
+  void IRAM_ATTR sample();
+
+  uint32_t now() { return _ticks * BTN_SAMPLE_PERIOD; }
+  uint32_t dropped() { return _queue.dropped(); }
+
+private:
+  enum BtnState : uint8_t
+  {
+    BTN_STATE_IDLE,
+    BTN_STATE_DOWN,
+    BTN_STATE_UP,
+    BTN_STATE_LONG
+  };
+
+  struct BtnClick
+  {
+    BtnState state;
+    uint8_t clicks;
+    uint32_t start;
+  };
+
+  const int *_pins = nullptr;
+  uint8_t _cnt = 0;
+  BtnEventCallback _callback = nullptr;
+
+  BtnPinWord _pinMask = 0;                             // Pins of all buttons
+  BtnPinWord _buttonMask[BTN_SAMPLER_MAX_BUTTONS] = {0}; // Pin of each button
+
+  // Owned by the timer interrupt
+  BtnPinWord _stable = 0; // Debounced levels
+  BtnPinWord _count0 = 0; // Vertical counter bits, samples differing from the debounced level
+  BtnPinWord _count1 = 0;
+  BtnPinWord _count2 = 0;
+  volatile uint32_t _ticks = 0;
+
+  // Written by the loop, read by the interrupt
+  bool _analog = false;
+  volatile BtnPinWord _analogLevel = 0;
+  uint32_t _analogRead = 0;
+
+  BtnEdgeQueue _queue;
+  BtnClick _clicks[BTN_SAMPLER_MAX_BUTTONS] = {};
+  uint32_t _busy = 0; // Buttons in a click, only these are checked for timeouts
+
+#ifdef ESP32
+  hw_timer_t *_timer = nullptr;
+#endif
+
+  static BtnSampler *_instance;
+  static void IRAM_ATTR _onTimer();
+
+  inline BtnPinWord IRAM_ATTR _readPins()
+  {
+#ifdef ESP8266
+    return GPI | ((BtnPinWord)(GP16I & 0x01) << 16) | _analogLevel;
+#elif ESP32
+    return REG_READ(GPIO_IN_REG) | ((BtnPinWord)REG_READ(GPIO_IN1_REG) << 32);
+#endif
+  }
+
+  void _edge(uint8_t button, bool pressed, uint32_t time);
+  void _timeout(uint8_t button, uint32_t time);
+  void _emit(uint8_t button, uint8_t type);
+};
+
+#endif
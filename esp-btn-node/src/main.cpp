@@ -1,6 +1,9 @@
 #include <Arduino.h>
 #include <EspNode.h>
+#include "BtnSampler.h"
+#ifndef BTN_TIMER_SAMPLING
 #include <OneButton.h>
+#endif
 
 //***** ESP Node *****//
 char nodeName[32] = "btn";      // Nodes name - default value, may be overridden
@@ -9,17 +12,13 @@ char fwVersion[8] = "1.0";           // Version of the firmware
 
 EspNode *espNode;
 
-#define BTN_TYPE_SINGLE 1
-#define BTN_TYPE_DOUBLE 2
-#define BTN_TYPE_MULTI 3
-#define BTN_TYPE_LONG 4
 #define BTN_CMD_1X "Cmd1x"
 #define BTN_CMD_2X "Cmd2x"
 #define BTN_CMD_MU "CmdMu"
 #define BTN_CMD_LO "CmdLo"
 
 const char HTML_BUTTONS_FORM_START[] PROGMEM = "<form method='POST' action='saveButtons'>";
-const char HTML_BUTTONS_SECTION_START[] PROGMEM = "<h3>{buttonName}</h3>";
+const char HTML_BUTTONS_SECTION_START[] PROGMEM = "<h3>{buttonName} <small data-ev='{buttonName}'></small></h3>"; // last click, streamed for the default command topics
 const char HTML_BUTTONS_CMD_1X[] PROGMEM = "<b>Command Single</b> <i><small>(disabled, if empty)</small></i>";
 const char HTML_BUTTONS_CMD_2X[] PROGMEM = "<br/><b>Command Double</b> <i><small>(disabled, if empty)</small></i>";
 const char HTML_BUTTONS_CMD_MULTI[] PROGMEM = "<br/><b>Command Multi</b> <i><small>(disabled, if empty)</small></i>";
@@ -28,72 +27,104 @@ const char HTML_BUTTONS_CMD_MQTT[] PROGMEM = "<input id='{btnCfgId}' name='{btnC
 const char HTML_BUTTONS_FORM_END[] PROGMEM = "<br/><br/><button type='submit'>Save</button></form>";
 const char HTML_BUTTONS_BTN_BACK[] PROGMEM = "<hr><a href='/'><button>Back</button></a>";
 
+#ifdef BTN_TIMER_SAMPLING
+BtnSampler btnSampler; // Samples all buttons from the timer, classified by the loop
+#else
 int btnCurrentIndex = 0; // Control variable for loop
+#endif
 
 const char BTN_CMD_SEPERATOR[2] = "#";
+const int BTN_CONFIG_FILTER_SIZE = 192; // Size of the filter selecting the keys of one button
+const int BTN_CONFIG_DOC_SIZE = 640;    // Size of the document holding the commands of one button
+const char BTN_CONFIG_RECORD[] = "button"; // Record name of the button configuration
+const uint16_t BTN_CONFIG_VERSION = 1;   // Schema version of the button configuration record
 
 #ifdef ESP8266
 const uint16_t MAX_NUM_OF_BUTTONS = 8; // max is 8
 const uint16_t NUM_OF_BUTTONS_USED = 4;  // 4 button usage
 int btnId[MAX_NUM_OF_BUTTONS] = {0, 1, 2, 3, 4, 5, 6, 7};
 const char btnName[MAX_NUM_OF_BUTTONS][16] = {"btnD0", "btnD1", "btnD2", "btnD5", "btnD6", "btnD7", "btnD8", "btnA0"};
-char btnMqttCmdSingle[MAX_NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", ""};
-char btnMqttCmdDouble[MAX_NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", ""};
-char btnMqttCmdMulti[MAX_NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", ""};
-char btnMqttCmdLong[MAX_NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", ""};
 int btnPins[MAX_NUM_OF_BUTTONS] = {D0, D1, D2, D5, D6, D7, D8, A0};
-OneButton *btnArray[MAX_NUM_OF_BUTTONS];
 #elif ESP32
 const uint16_t MAX_NUM_OF_BUTTONS = 20; // max is 20
 const uint16_t NUM_OF_BUTTONS_USED = 10;
-int btnId[NUM_OF_BUTTONS] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
-const char btnName[NUM_OF_BUTTONS][16] = {"btn05", "btn13", "btn14", "btn15", "btn16", "btn17", "btn18", "btn19", "btn21", "btn22", "btn23", "btn25", "btn26", "btn27", "btn32", "btn33", "btn34", "btn35", "btn36", "btn39"};
-char btnMqttCmdSingle[NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", ""};
-char btnMqttCmdDouble[NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", ""};
-char btnMqttCmdMulti[NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", ""};
-char btnMqttCmdLong[NUM_OF_BUTTONS][128] = {"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", ""};
-int btnPins[NUM_OF_BUTTONS] = {5, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27, 32, 33, 34, 35, 36, 39};
-OneButton *btnArray[NUM_OF_BUTTONS];
+int btnId[MAX_NUM_OF_BUTTONS] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19};
+const char btnName[MAX_NUM_OF_BUTTONS][16] = {"btn05", "btn13", "btn14", "btn15", "btn16", "btn17", "btn18", "btn19", "btn21", "btn22", "btn23", "btn25", "btn26", "btn27", "btn32", "btn33", "btn34", "btn35", "btn36", "btn39"};
+int btnPins[MAX_NUM_OF_BUTTONS] = {5, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27, 32, 33, 34, 35, 36, 39};
 #else
 #error "Wrong board - ESP8266 or ESP32 must be used."
 #endif
 
+#ifndef BTN_TIMER_SAMPLING
+OneButton *btnArray[MAX_NUM_OF_BUTTONS];
+#endif
+
+struct BtnConfig
+{
+  char mqttCmdSingle[MAX_NUM_OF_BUTTONS][128];
+  char mqttCmdDouble[MAX_NUM_OF_BUTTONS][128];
+  char mqttCmdMulti[MAX_NUM_OF_BUTTONS][128];
+  char mqttCmdLong[MAX_NUM_OF_BUTTONS][128];
+} __attribute__((packed));
+
+struct BtnCmd
+{
+  uint8_t topicLen;      // Length of the topic at the start of the configured command
+  uint8_t payloadOffset; // Offset of the payload behind the separator, 0 if the command is not valid
+};
+
+BtnConfig btnConfig;                      // Commands of all buttons, loaded with one read of the config record
+const char *btnTopic[MAX_NUM_OF_BUTTONS]; // Interned default topic of each button
+BtnCmd btnCmds[MAX_NUM_OF_BUTTONS][BTN_TYPE_LONG]; // Commands split once on load and save, indexed by button and type - 1
+const char *const btnTypeName[BTN_TYPE_LONG + 1] = {"", "single", "double", "multi", "long"};
+
 void btnSetup();
 
-String btnSplitMqttCmd(String data, bool command);
-void btnSingleClick(void *btnIndex);
-void btnDoubleClick(void *btnIndex);
-void btnMultiClick(void *btnIndex);
-void btnLongPressStart(void *btnIndex);
+void btnEvent(uint8_t index, uint8_t type);
 void btnLoop();
 
-String btnGetCmdTypeId(int index, int type);
+const char *btnGetCmdTypeId(int index, int type);
 String btnGetConfigId(int index, int type);
-String btnGetMqttCmd(int index, int type, bool defaultIfEmpty);
-String btnGetDefaultMqttCmd(int index, int type);
-String btnGetBtnHtmlMqttCmd(int index, int type);
+char *btnGetConfigCmd(int index, int type);
+void btnCmdsParse();
+void btnSendHtmlMqttCmd(int index, int type);
 
 void btnConfigRead();
 void btnConfigSave();
+bool btnConfigUpdate(char *mqttCmd, int index, int type);
 
 void webHandleButtons();
 void webHandleSaveButtons();
+void webJsonButtons(JsonObject json);
 
 void btnSetup()
 {
   // Load button config if available
   btnConfigRead();
+  btnCmdsParse();
 
   // Attach button handlers
   for (int btnIndex = 0; btnIndex < NUM_OF_BUTTONS_USED; btnIndex++)
   {
-    btnArray[btnIndex] = new OneButton(btnPins[btnIndex], false, false);
+    btnTopic[btnIndex] = espNode->mqttInternNodeTopic(btnName[btnIndex]);
 
-    btnArray[btnIndex]->attachClick(btnSingleClick, &btnId[btnIndex]);
-    btnArray[btnIndex]->attachDoubleClick(btnDoubleClick, &btnId[btnIndex]);
-    btnArray[btnIndex]->attachMultiClick(btnMultiClick, &btnId[btnIndex]);
+#ifndef BTN_TIMER_SAMPLING
+    btnArray[btnIndex] = new OneButton(btnPins[btnIndex], false, false);
 
-    btnArray[btnIndex]->attachLongPressStart(btnLongPressStart, &btnId[btnIndex]);
+    btnArray[btnIndex]->attachClick([](void *btnIndex)
+                                    { btnEvent(*(int *)btnIndex, BTN_TYPE_SINGLE); },
+                                    &btnId[btnIndex]);
+    btnArray[btnIndex]->attachDoubleClick([](void *btnIndex)
+                                          { btnEvent(*(int *)btnIndex, BTN_TYPE_DOUBLE); },
+                                          &btnId[btnIndex]);
+    btnArray[btnIndex]->attachMultiClick([](void *btnIndex)
+                                         { btnEvent(*(int *)btnIndex, BTN_TYPE_MULTI); },
+                                         &btnId[btnIndex]);
+
+    btnArray[btnIndex]->attachLongPressStart([](void *btnIndex)
+                                             { btnEvent(*(int *)btnIndex, BTN_TYPE_LONG); },
+                                             &btnId[btnIndex]);
+#endif
 
     espNode->debugPrintln(String(F("** BTN: Initialized - ")) + btnName[btnIndex] + String(F("|")) + btnPins[btnIndex]);
   }
@@ -105,123 +136,63 @@ void btnSetup()
   espNode->webRegisterHandler("/buttons", webHandleButtons);
   espNode->webAddButtonHandler("/buttons", "Buttons");
   espNode->webRegisterHandler("/saveButtons", webHandleSaveButtons);
+  espNode->webRegisterJsonProvider("buttons", webJsonButtons);
+
+  // Register button task, ticked on every pass to keep click timing tight
+  espNode->taskAdd("btn", btnLoop, 0, 5, TASK_PRIO_HIGH);
 
   delay(1000); // wait for pins to set down
+
+#ifdef BTN_TIMER_SAMPLING
+  // Started after the pins settled, the timer samples all buttons in parallel from here on
+  btnSampler.begin(btnPins, NUM_OF_BUTTONS_USED, btnEvent);
+#endif
 }
 
-String btnSplitMqttCmd(String data, bool command)
+void btnEvent(uint8_t index, uint8_t type)
 {
-  int delimiter = data.indexOf(BTN_CMD_SEPERATOR);
+  espNode->debugLog(DEBUG_LEVEL_INFO, PSTR("BTN: Button %u %s click."), index, btnTypeName[type]);
 
-  if (delimiter > 0)
+  const char *mqttCmd = btnGetConfigCmd(index, type);
+  const BtnCmd &cmd = btnCmds[index][type - 1];
+  const char *topic = btnTopic[index];
+  const char *payload = btnGetCmdTypeId(index, type);
+  char topicBuffer[MQTT_TOPIC_SIZE];
+
+  if (mqttCmd[0] != '\0')
   {
-    if (!command)
+    if (cmd.payloadOffset == 0)
     {
-      return data.substring(0, delimiter);
+      espNode->debugLog(DEBUG_LEVEL_WARN, PSTR("** BTN: No MQTT[Topic|Cmd] for %sclick defined [%s]"), btnTypeName[type], mqttCmd);
+      topic = nullptr;
     }
     else
     {
-      return data.substring(delimiter + 1);
+      // The topic ends at the separator, terminated in a copy on the stack
+      memcpy(topicBuffer, mqttCmd, cmd.topicLen);
+      topicBuffer[cmd.topicLen] = '\0';
+      topic = topicBuffer;
+      payload = mqttCmd + cmd.payloadOffset;
     }
   }
 
-  return "";
-}
-
-void btnSingleClick(void *btnIndex)
-{
-  espNode->debugPrintln(String(F("BTN: Button ")) + *(int *)btnIndex + String(F(" single click.")));
-
-  int index = *(int *)btnIndex;
-  String mqttCmd = btnGetMqttCmd(index, BTN_TYPE_SINGLE, true);
-
-  String topic = btnSplitMqttCmd(mqttCmd, false);
-  String cmd = btnSplitMqttCmd(mqttCmd, true);
-
-  if (!topic.isEmpty() && !cmd.isEmpty())
-  {
-    espNode->mqttSend(topic, cmd);
-    espNode->debugPrintln(String(F("** BTN: Send MQTT[Topic|Cmd] ")) + topic + String(F("|")) + cmd);
-  }
-  else
-  {
-    espNode->debugPrintln(String(F("** BTN: No MQTT[Topic|Cmd] for singleclick defined [")) + mqttCmd + String(F("]")));
-  }
-
-  btnArray[index]->reset();
-}
-
-void btnDoubleClick(void *btnIndex)
-{
-  espNode->debugPrintln(String(F("BTN: Button ")) + *(int *)btnIndex + String(F(" double click.")));
-
-  int index = *(int *)btnIndex;
-  String mqttCmd = btnGetMqttCmd(index, BTN_TYPE_DOUBLE, true);
-
-  String topic = btnSplitMqttCmd(mqttCmd, false);
-  String cmd = btnSplitMqttCmd(mqttCmd, true);
-
-  if (!topic.isEmpty() && !cmd.isEmpty())
-  {
-    espNode->mqttSend(topic, cmd);
-    espNode->debugPrintln(String(F("** BTN: Send MQTT[Topic|Cmd] ")) + topic + String(F("|")) + cmd);
-  }
-  else
-  {
-    espNode->debugPrintln(String(F("** BTN: No MQTT[Topic|Cmd] for doubleclick defined [")) + mqttCmd + String(F("]")));
-  }
-
-  btnArray[index]->reset();
-}
-
-void btnMultiClick(void *btnIndex)
-{
-  espNode->debugPrintln(String(F("BTN: Button ")) + *(int *)btnIndex + String(F(" multi click.")));
-
-  int index = *(int *)btnIndex;
-  String mqttCmd = btnGetMqttCmd(index, BTN_TYPE_MULTI, true);
-
-  String topic = btnSplitMqttCmd(mqttCmd, false);
-  String cmd = btnSplitMqttCmd(mqttCmd, true);
-
-  if (!topic.isEmpty() && !cmd.isEmpty())
-  {
-    espNode->mqttSend(topic, cmd);
-    espNode->debugPrintln(String(F("** BTN: Send MQTT[Topic|Cmd] ")) + topic + String(F("|")) + cmd);
-  }
-  else
-  {
-    espNode->debugPrintln(String(F("** BTN: No MQTT[Topic|Cmd] for multiclick defined [")) + mqttCmd + String(F("]")));
-  }
-
-  btnArray[index]->reset();
-}
-
-void btnLongPressStart(void *btnIndex)
-{
-  espNode->debugPrintln(String(F("BTN: Button ")) + *(int *)btnIndex + String(F(" long click.")));
-
-  int index = *(int *)btnIndex;
-  String mqttCmd = btnGetMqttCmd(index, BTN_TYPE_LONG, true);
-
-  String topic = btnSplitMqttCmd(mqttCmd, false);
-  String cmd = btnSplitMqttCmd(mqttCmd, true);
-
-  if (!topic.isEmpty() && !cmd.isEmpty())
+  if (topic != nullptr)
   {
-    espNode->mqttSend(topic, cmd);
-    espNode->debugPrintln(String(F("** BTN: Send MQTT[Topic|Cmd] ")) + topic + String(F("|")) + cmd);
-  }
-  else
-  {
-    espNode->debugPrintln(String(F("** BTN: No MQTT[Topic|Cmd] for longclick defined [")) + mqttCmd + String(F("]")));
+    espNode->mqttSendEvent(topic, payload);
+    espNode->debugLog(DEBUG_LEVEL_INFO, PSTR("** BTN: Send MQTT[Topic|Cmd] %s|%s"), topic, payload);
   }
 
+#ifndef BTN_TIMER_SAMPLING
   btnArray[index]->reset();
+#endif
 }
 
 void btnLoop()
 {
+#ifdef BTN_TIMER_SAMPLING
+  // Edges were recorded by the timer, only the classification is left to the loop
+  btnSampler.loop();
+#else
 #ifdef ESP8266
   if (btnPins[btnCurrentIndex] == A0)
   {
@@ -245,9 +216,10 @@ void btnLoop()
   {
     btnCurrentIndex = 0;
   }
+#endif
 }
 
-String btnGetCmdTypeId(int index, int type)
+const char *btnGetCmdTypeId(int index, int type)
 {
   switch (type)
   {
@@ -261,7 +233,7 @@ String btnGetCmdTypeId(int index, int type)
     return BTN_CMD_LO;
   }
 
-  return String(F("CmdTypeUnknown"));
+  return "CmdTypeUnknown";
 }
 
 String btnGetConfigId(int index, int type)
@@ -272,139 +244,135 @@ String btnGetConfigId(int index, int type)
   return configId;
 }
 
-String btnGetMqttCmd(int index, int type, bool defaultIfEmpty)
+char *btnGetConfigCmd(int index, int type)
 {
-  String mqttCmd = "";
-
   switch (type)
   {
   case BTN_TYPE_SINGLE:
-    mqttCmd = btnMqttCmdSingle[index];
-    break;
+    return btnConfig.mqttCmdSingle[index];
   case BTN_TYPE_DOUBLE:
-    mqttCmd = btnMqttCmdDouble[index];
-    break;
+    return btnConfig.mqttCmdDouble[index];
   case BTN_TYPE_MULTI:
-    mqttCmd = btnMqttCmdMulti[index];
-    break;
+    return btnConfig.mqttCmdMulti[index];
   case BTN_TYPE_LONG:
-    mqttCmd = btnMqttCmdLong[index];
-    break;
-  }
-
-  if (defaultIfEmpty && mqttCmd.isEmpty())
-  {
-    mqttCmd = btnGetDefaultMqttCmd(index, type);
+    return btnConfig.mqttCmdLong[index];
   }
 
-  return mqttCmd;
+  return nullptr;
 }
 
-String btnGetDefaultMqttCmd(int index, int type)
+void btnCmdsParse()
 {
-  String mqttCmd = espNode->mqttGetNodeTopic(btnName[index]);
-  mqttCmd += BTN_CMD_SEPERATOR + btnGetCmdTypeId(index, type);
+  // Empty commands fall back to the default, a command without topic or payload is not sent
+  for (int index = 0; index < MAX_NUM_OF_BUTTONS; index++)
+  {
+    for (int type = BTN_TYPE_SINGLE; type <= BTN_TYPE_LONG; type++)
+    {
+      const char *mqttCmd = btnGetConfigCmd(index, type);
+      const char *separator = strchr(mqttCmd, BTN_CMD_SEPERATOR[0]);
+      BtnCmd &cmd = btnCmds[index][type - 1];
 
-  return mqttCmd;
+      cmd.topicLen = 0;
+      cmd.payloadOffset = 0;
+      if (separator != nullptr && separator > mqttCmd && separator[1] != '\0')
+      {
+        cmd.topicLen = separator - mqttCmd;
+        cmd.payloadOffset = cmd.topicLen + 1;
+      }
+    }
+  }
 }
 
-String btnGetBtnHtmlMqttCmd(int index, int type)
+void btnSendHtmlMqttCmd(int index, int type)
 {
-  String btnConfigId = btnGetConfigId(index, type);
-
-  String htmlMsg = HTML_BUTTONS_CMD_MQTT;
-  htmlMsg.replace(String(F("{btnCfgId}")), btnConfigId);
-  htmlMsg.replace(String(F("{btnDefaultCmd}")), btnGetDefaultMqttCmd(index, type));
-  htmlMsg.replace(String(F("{btnCmd}")), btnGetMqttCmd(index, type, false));
-
-  return htmlMsg;
+  // Streamed into the node's send buffer, nothing of the input field is built on the heap
+  espNode->webSendTemplate(HTML_BUTTONS_CMD_MQTT, [index, type](const char *key, Print &out)
+                           {
+                             if (strcmp_P(key, PSTR("btnCfgId")) == 0)
+                             {
+                               out.print(btnName[index]);
+                               out.print(btnGetCmdTypeId(index, type));
+                             }
+                             else if (strcmp_P(key, PSTR("btnDefaultCmd")) == 0)
+                             {
+                               out.print(btnTopic[index]);
+                               out.print(BTN_CMD_SEPERATOR);
+                               out.print(btnGetCmdTypeId(index, type));
+                             }
+                             else if (strcmp_P(key, PSTR("btnCmd")) == 0)
+                             {
+                               out.print(btnGetConfigCmd(index, type));
+                             }
+                             else
+                             {
+                               return false;
+                             }
+                             return true; });
 }
 
 void btnConfigRead()
 {
-  // Read saved multiConfig.json from SPIFFS
-  espNode->debugPrintln(F("SPIFFS: Reading button config - /buttonConfig.json."));
+  // Read saved button config record from SPIFFS
+  espNode->debugPrintln(F("SPIFFS: Reading button config."));
 
-  File configFile = espNode->configOpenFile("/buttonConfig.json", "r");
-  if (configFile)
+  if (!espNode->configRecordLoad(BTN_CONFIG_RECORD, BTN_CONFIG_VERSION, &btnConfig, sizeof(btnConfig)))
   {
-    size_t configFileSize = configFile.size(); // Allocate a buffer to store contents of the file.
-    std::unique_ptr<char[]> buf(new char[configFileSize]);
-    configFile.readBytes(buf.get(), configFileSize);
-
-    DynamicJsonDocument configJson(CONFIG_SIZE);
-    DeserializationError jsonError = deserializeJson(configJson, buf.get());
-
-    if (jsonError)
-    { // Couldn't parse the saved config
-      bool removedJson = SPIFFS.remove("/buttonConfig.json");
-
-      espNode->debugPrintln(String(F("SPIFFS: [ERROR] Failed to parse /buttonConfig.json: ")) + String(jsonError.c_str()));
+    // The record is read in place, don't keep a partial read
+    memset(&btnConfig, 0, sizeof(btnConfig));
+  }
 
-      if (removedJson)
-      {
-        espNode->debugPrintln(String(F("SPIFFS: Removed corrupt file /buttonConfig.json")));
-      }
-      else
-      {
-        espNode->debugPrintln(String(F("SPIFFS: [ERROR] Corrupt file /buttonConfig.json could not be removed")));
-      }
-    }
-    else
+  // Migrate or import buttonConfig.json, one button at a time to keep the document small
+  for (int index = 0; index < MAX_NUM_OF_BUTTONS; index++)
+  {
+    StaticJsonDocument<BTN_CONFIG_FILTER_SIZE> filter;
+    filter[btnGetConfigId(index, BTN_TYPE_SINGLE)] = true;
+    filter[btnGetConfigId(index, BTN_TYPE_DOUBLE)] = true;
+    filter[btnGetConfigId(index, BTN_TYPE_MULTI)] = true;
+    filter[btnGetConfigId(index, BTN_TYPE_LONG)] = true;
+
+    StaticJsonDocument<BTN_CONFIG_DOC_SIZE> configJson;
+    bool loaded = (index == 0) ? espNode->configImport("/buttonConfig.json", configJson, &filter)
+                               : espNode->configLoad("/buttonConfig.json", configJson, &filter);
+    if (!loaded)
     {
-      // Read Button configuration
-      for (int index = 0; index < MAX_NUM_OF_BUTTONS; index++)
-      {
-        strcpy(btnMqttCmdSingle[index], configJson[btnGetConfigId(index, BTN_TYPE_SINGLE)]);
-        strcpy(btnMqttCmdDouble[index], configJson[btnGetConfigId(index, BTN_TYPE_DOUBLE)]);
-        strcpy(btnMqttCmdMulti[index], configJson[btnGetConfigId(index, BTN_TYPE_MULTI)]);
-        strcpy(btnMqttCmdLong[index], configJson[btnGetConfigId(index, BTN_TYPE_LONG)]);
-      }
-
-      // Print read JSON configuration
-      String configJsonStr;
-      serializeJson(configJson, configJsonStr);
-
-      espNode->debugPrintln(String(F("SPIFFS: parsed json:")) + configJsonStr);
+      // Nothing to import, or a corrupt file the other buttons won't do better with
+      return;
     }
+
+    // Read Button configuration
+    snprintf(btnConfig.mqttCmdSingle[index], sizeof(btnConfig.mqttCmdSingle[index]), "%s", configJson[btnGetConfigId(index, BTN_TYPE_SINGLE)] | "");
+    snprintf(btnConfig.mqttCmdDouble[index], sizeof(btnConfig.mqttCmdDouble[index]), "%s", configJson[btnGetConfigId(index, BTN_TYPE_DOUBLE)] | "");
+    snprintf(btnConfig.mqttCmdMulti[index], sizeof(btnConfig.mqttCmdMulti[index]), "%s", configJson[btnGetConfigId(index, BTN_TYPE_MULTI)] | "");
+    snprintf(btnConfig.mqttCmdLong[index], sizeof(btnConfig.mqttCmdLong[index]), "%s", configJson[btnGetConfigId(index, BTN_TYPE_LONG)] | "");
   }
-  else
+
+  if (espNode->configRecordSave(BTN_CONFIG_RECORD, BTN_CONFIG_VERSION, &btnConfig, sizeof(btnConfig)))
   {
-    espNode->debugPrintln(F("SPIFFS: [ERROR] File not found /buttonConfig.json"));
+    espNode->configImportDone("/buttonConfig.json");
   }
 }
 
 void btnConfigSave()
-{ // Save the parameters to config.json
+{ // Save the parameters to the button config record
   espNode->debugPrintln(F("SPIFFS: Saving button config"));
-  DynamicJsonDocument jsonConfigValues(CONFIG_SIZE);
 
-  // Save button configuration
-  for (int index = 0; index < MAX_NUM_OF_BUTTONS; index++)
-  {
-    jsonConfigValues[btnGetConfigId(index, BTN_TYPE_SINGLE)] = btnMqttCmdSingle[index];
-    jsonConfigValues[btnGetConfigId(index, BTN_TYPE_DOUBLE)] = btnMqttCmdDouble[index];
-    jsonConfigValues[btnGetConfigId(index, BTN_TYPE_MULTI)] = btnMqttCmdMulti[index];
-    jsonConfigValues[btnGetConfigId(index, BTN_TYPE_LONG)] = btnMqttCmdLong[index];
-  }
+  espNode->configRecordSave(BTN_CONFIG_RECORD, BTN_CONFIG_VERSION, &btnConfig, sizeof(btnConfig));
+}
 
-  File configFile = espNode->configOpenFile("/buttonConfig.json", "w");
-  if (!configFile)
-  {
-    espNode->debugPrintln(F("SPIFFS: Failed to open config file for writing"));
-  }
-  else
-  {
-    serializeJson(jsonConfigValues, configFile);
-    configFile.close();
+void webJsonButtons(JsonObject json)
+{
+  // Commands are referenced from the config, an empty command is disabled
+  JsonArray buttons = json.createNestedArray("buttons");
 
-    // Print saved JSON configuration
-    String configJsonStr;
-    serializeJson(jsonConfigValues, configJsonStr);
-    espNode->debugPrintln(String(F("SPIFFS: saved json:")) + configJsonStr);
+  for (int btnIndex = 0; btnIndex < NUM_OF_BUTTONS_USED; btnIndex++)
+  {
+    JsonObject button = buttons.createNestedObject();
+    button["name"] = btnName[btnIndex];
+    button[BTN_CMD_1X] = (const char *)btnConfig.mqttCmdSingle[btnIndex];
+    button[BTN_CMD_2X] = (const char *)btnConfig.mqttCmdDouble[btnIndex];
+    button[BTN_CMD_MU] = (const char *)btnConfig.mqttCmdMulti[btnIndex];
+    button[BTN_CMD_LO] = (const char *)btnConfig.mqttCmdLong[btnIndex];
   }
-
-  delay(500);
 }
 
 void webHandleButtons()
@@ -414,23 +382,29 @@ void webHandleButtons()
   espNode->webStartHttpMsg(String(F("Buttons")), 200);
   espNode->webSendHttpContent(HTML_BUTTONS_FORM_START);
 
-  String configButtonId;
   for (int index = 0; index < NUM_OF_BUTTONS_USED; index++)
   {
     // Prepare and send a html part for each button
-    espNode->webSendHttpContent(HTML_BUTTONS_SECTION_START, String(F("{buttonName}")), btnName[index]);
+    espNode->webSendTemplate(HTML_BUTTONS_SECTION_START, [index](const char *key, Print &out)
+                             {
+                               if (strcmp_P(key, PSTR("buttonName")) != 0)
+                               {
+                                 return false;
+                               }
+                               out.print(btnName[index]);
+                               return true; });
 
     espNode->webSendHttpContent(HTML_BUTTONS_CMD_1X);
-    espNode->webSendHttpContent(btnGetBtnHtmlMqttCmd(index, BTN_TYPE_SINGLE));
+    btnSendHtmlMqttCmd(index, BTN_TYPE_SINGLE);
 
     espNode->webSendHttpContent(HTML_BUTTONS_CMD_2X);
-    espNode->webSendHttpContent(btnGetBtnHtmlMqttCmd(index, BTN_TYPE_DOUBLE));
+    btnSendHtmlMqttCmd(index, BTN_TYPE_DOUBLE);
 
     espNode->webSendHttpContent(HTML_BUTTONS_CMD_MULTI);
-    espNode->webSendHttpContent(btnGetBtnHtmlMqttCmd(index, BTN_TYPE_MULTI));
+    btnSendHtmlMqttCmd(index, BTN_TYPE_MULTI);
 
     espNode->webSendHttpContent(HTML_BUTTONS_CMD_LONG);
-    espNode->webSendHttpContent(btnGetBtnHtmlMqttCmd(index, BTN_TYPE_LONG));
+    btnSendHtmlMqttCmd(index, BTN_TYPE_LONG);
   }
 
   espNode->webSendHttpContent(HTML_BUTTONS_FORM_END);
@@ -444,25 +418,13 @@ void webHandleSaveButtons()
   espNode->debugPrintln(String(F("HTTP: WebHandleSaveButtons called.")));
 
   // check if button settings have changed
-  String data = "";
+  bool changed = false;
   for (int index = 0; index < NUM_OF_BUTTONS_USED; index++)
   {
-
-    data = espNode->webGetArg(btnGetConfigId(index, BTN_TYPE_SINGLE));
-    data.trim();
-    strcpy(btnMqttCmdSingle[index], data.c_str());
-
-    data = espNode->webGetArg(btnGetConfigId(index, BTN_TYPE_DOUBLE));
-    data.trim();
-    strcpy(btnMqttCmdDouble[index], data.c_str());
-
-    data = espNode->webGetArg(btnGetConfigId(index, BTN_TYPE_MULTI));
-    data.trim();
-    strcpy(btnMqttCmdMulti[index], data.c_str());
-
-    data = espNode->webGetArg(btnGetConfigId(index, BTN_TYPE_LONG));
-    data.trim();
-    strcpy(btnMqttCmdLong[index], data.c_str());
+    changed |= btnConfigUpdate(btnConfig.mqttCmdSingle[index], index, BTN_TYPE_SINGLE);
+    changed |= btnConfigUpdate(btnConfig.mqttCmdDouble[index], index, BTN_TYPE_DOUBLE);
+    changed |= btnConfigUpdate(btnConfig.mqttCmdMulti[index], index, BTN_TYPE_MULTI);
+    changed |= btnConfigUpdate(btnConfig.mqttCmdLong[index], index, BTN_TYPE_LONG);
   }
 
   // Config updated, notify user and trigger write of configurations
@@ -471,7 +433,26 @@ void webHandleSaveButtons()
   espNode->webSendHttpContent(HTML_SAVESETTINGS_SAVE_NORESTART, HTML_REPLACE_REDIRURL, String(F("/buttons")));
   espNode->webEndHttpMsg();
 
-  btnConfigSave();
+  // Written by the node after a quiet period, further changes are merged into the same write
+  if (changed)
+  {
+    btnCmdsParse();
+    espNode->configSetDirty(btnConfigSave);
+  }
+}
+
+bool btnConfigUpdate(char *mqttCmd, int index, int type)
+{
+  String data = espNode->webGetArg(btnGetConfigId(index, type));
+  data.trim();
+
+  if (data.equals(mqttCmd))
+  {
+    return false;
+  }
+
+  snprintf(mqttCmd, sizeof(btnConfig.mqttCmdSingle[index]), "%s", data.c_str());
+  return true;
 }
 
 void setup()
@@ -485,6 +466,4 @@ void setup()
 void loop()
 {
   espNode->loop();
-
-  btnLoop();
 }
\ No newline at end of file
@@ -0,0 +1,743 @@
+/**
+ * Arduino.cpp
+ *
+ * Host shim of the Arduino core for the native (Linux) build of EspNode.
+ * <p>
+ * Also owns main(): runs setup() once and loop() until ESPNODE_NATIVE_LOOPS
+ * passes are done or ESPNODE_NATIVE_RUN_MS ms have passed (endless if both are
+ * unset) and prints loop latency and heap churn. Test builds of the test/
+ * folder (PIO_UNIT_TESTING) bring their own main() instead.
+ * <p>
+ * ESPNODE_NATIVE_PINS drives input pins over time, a comma separated list of
+ * "ms:pin=value" steps applied once millis() passed ms, e.g. a click on D1
+ * with "1500:5=1,1600:5=0".
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "Arduino.h"
+
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+NativeStats nativeStats = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static volatile int nativePins[NATIVE_PIN_CNT] = {0}; // Shared with the timer thread
+volatile uint32_t nativeGpioIn = 0;                   // GPIO 0-16 levels, kept with nativePins
+static const std::chrono::steady_clock::time_point nativeStart = std::chrono::steady_clock::now();
+
+//***** Heap accounting - every allocation carries its size in front *****//
+static const size_t NATIVE_ALLOC_HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+  uint8_t *raw = (uint8_t *)malloc(size + NATIVE_ALLOC_HEADER);
+  if (raw == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+
+  *(size_t *)raw = size;
+
+  nativeStats.allocCount++;
+  nativeStats.allocBytes += size;
+  nativeStats.heapInUse += size;
+  nativeStats.heapPeak = std::max(nativeStats.heapPeak, nativeStats.heapInUse);
+
+  return raw + NATIVE_ALLOC_HEADER;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  if (ptr == nullptr)
+  {
+    return;
+  }
+
+  uint8_t *raw = (uint8_t *)ptr - NATIVE_ALLOC_HEADER;
+
+  nativeStats.freeCount++;
+  nativeStats.heapInUse -= *(size_t *)raw;
+
+  free(raw);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+//***** String *****//
+static std::string nativeNumberToString(unsigned long long value, bool negative, unsigned char base)
+{
+  if (base < 2 || base > 36)
+  {
+    base = 10;
+  }
+
+  char buf[72];
+  char *p = &buf[sizeof(buf) - 1];
+  *p = '\0';
+
+  do
+  {
+    unsigned digit = value % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    value /= base;
+  } while (value > 0);
+
+  if (negative)
+  {
+    *--p = '-';
+  }
+
+  return std::string(p);
+}
+
+static std::string nativeSignedToString(long long value, unsigned char base)
+{
+  if (base == 10 && value < 0)
+  {
+    return nativeNumberToString(0ULL - (unsigned long long)value, true, base);
+  }
+
+  // Arduino prints negative values in other bases as two's complement
+  return nativeNumberToString((unsigned long long)(unsigned long)value, false, base);
+}
+
+String::String(unsigned char value, unsigned char base) : _buffer(nativeNumberToString(value, false, base)) {}
+String::String(int value, unsigned char base) : _buffer(nativeSignedToString(value, base)) {}
+String::String(unsigned int value, unsigned char base) : _buffer(nativeNumberToString(value, false, base)) {}
+String::String(long value, unsigned char base) : _buffer(nativeSignedToString(value, base)) {}
+String::String(unsigned long value, unsigned char base) : _buffer(nativeNumberToString(value, false, base)) {}
+String::String(long long value, unsigned char base) : _buffer(nativeSignedToString(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : _buffer(nativeNumberToString(value, false, base)) {}
+
+String::String(float value, unsigned char decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned char decimalPlaces)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  _buffer = buf;
+}
+
+bool String::concat(const String &str)
+{
+  _buffer += str._buffer;
+  return true;
+}
+
+bool String::concat(const char *cstr)
+{
+  if (cstr != nullptr)
+  {
+    _buffer += cstr;
+  }
+  return cstr != nullptr;
+}
+
+bool String::concat(const char *cstr, unsigned int length)
+{
+  if (cstr != nullptr)
+  {
+    _buffer.append(cstr, length);
+  }
+  return cstr != nullptr;
+}
+
+bool String::concat(char c)
+{
+  _buffer += c;
+  return true;
+}
+
+String &String::operator+=(const String &rhs)
+{
+  concat(rhs);
+  return *this;
+}
+
+String &String::operator+=(const char *cstr)
+{
+  concat(cstr);
+  return *this;
+}
+
+String &String::operator+=(const __FlashStringHelper *pstr)
+{
+  concat(reinterpret_cast<const char *>(pstr));
+  return *this;
+}
+
+String &String::operator+=(char c)
+{
+  concat(c);
+  return *this;
+}
+
+String &String::operator+=(int value)
+{
+  concat(String(value));
+  return *this;
+}
+
+String &String::operator+=(unsigned int value)
+{
+  concat(String(value));
+  return *this;
+}
+
+String &String::operator+=(long value)
+{
+  concat(String(value));
+  return *this;
+}
+
+String &String::operator+=(unsigned long value)
+{
+  concat(String(value));
+  return *this;
+}
+
+bool String::equalsIgnoreCase(const String &str) const
+{
+  return (_buffer.length() == str._buffer.length()) && (strcasecmp(_buffer.c_str(), str._buffer.c_str()) == 0);
+}
+
+bool String::startsWith(const String &prefix) const
+{
+  return _buffer.compare(0, prefix._buffer.length(), prefix._buffer) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+  return (_buffer.length() >= suffix._buffer.length()) &&
+         (_buffer.compare(_buffer.length() - suffix._buffer.length(), suffix._buffer.length(), suffix._buffer) == 0);
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const
+{
+  size_t pos = _buffer.find(c, fromIndex);
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const
+{
+  size_t pos = _buffer.find(str._buffer, fromIndex);
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char c) const
+{
+  size_t pos = _buffer.rfind(c);
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int beginIndex) const
+{
+  return substring(beginIndex, length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+  if (beginIndex > endIndex)
+  {
+    std::swap(beginIndex, endIndex);
+  }
+  if (beginIndex >= _buffer.length())
+  {
+    return String();
+  }
+
+  endIndex = std::min(endIndex, length());
+  return String(_buffer.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::replace(const String &find, const String &replace)
+{
+  if (find._buffer.empty())
+  {
+    return;
+  }
+
+  size_t pos = 0;
+  while ((pos = _buffer.find(find._buffer, pos)) != std::string::npos)
+  {
+    _buffer.replace(pos, find._buffer.length(), replace._buffer);
+    pos += replace._buffer.length();
+  }
+}
+
+void String::replace(char find, char replace)
+{
+  std::replace(_buffer.begin(), _buffer.end(), find, replace);
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+  if (index < _buffer.length())
+  {
+    _buffer.erase(index, count);
+  }
+}
+
+void String::toLowerCase()
+{
+  std::transform(_buffer.begin(), _buffer.end(), _buffer.begin(), ::tolower);
+}
+
+void String::toUpperCase()
+{
+  std::transform(_buffer.begin(), _buffer.end(), _buffer.begin(), ::toupper);
+}
+
+void String::trim()
+{
+  size_t begin = _buffer.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos)
+  {
+    _buffer.clear();
+    return;
+  }
+
+  size_t end = _buffer.find_last_not_of(" \t\r\n");
+  _buffer = _buffer.substr(begin, end - begin + 1);
+}
+
+void String::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const
+{
+  getBytes((unsigned char *)buf, bufsize, index);
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const
+{
+  if (bufsize == 0 || buf == nullptr)
+  {
+    return;
+  }
+  if (index >= _buffer.length())
+  {
+    buf[0] = '\0';
+    return;
+  }
+
+  size_t n = std::min((size_t)bufsize - 1, _buffer.length() - index);
+  memcpy(buf, _buffer.c_str() + index, n);
+  buf[n] = '\0';
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+String operator+(const String &lhs, const char *rhs)
+{
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+String operator+(const char *lhs, const String &rhs)
+{
+  String result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+String operator+(const String &lhs, const __FlashStringHelper *rhs)
+{
+  return lhs + reinterpret_cast<const char *>(rhs);
+}
+
+String operator+(const __FlashStringHelper *lhs, const String &rhs)
+{
+  return reinterpret_cast<const char *>(lhs) + rhs;
+}
+
+String operator+(const String &lhs, char rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, int rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, unsigned int rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, long rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, unsigned long rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, float rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, double rhs) { return lhs + String(rhs); }
+
+//***** Print / Stream *****//
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+  {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  if (len < 0)
+  {
+    return 0;
+  }
+  return write(buf, std::min((size_t)len, sizeof(buf) - 1));
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = read();
+    if (c < 0)
+    {
+      break;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String Stream::readString()
+{
+  String result;
+  int c;
+  while ((c = read()) >= 0)
+  {
+    result.concat((char)c);
+  }
+  return result;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return _enabled ? fwrite(&c, 1, 1, stdout) : 0;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  return _enabled ? fwrite(buffer, 1, size, stdout) : 0;
+}
+
+void HardwareSerial::flush()
+{
+  fflush(stdout);
+}
+
+//***** Timing, GPIO and helpers *****//
+unsigned long millis()
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - nativeStart).count();
+}
+
+unsigned long micros()
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - nativeStart).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield()
+{
+  std::this_thread::yield();
+}
+
+static void (*nativeIsr[NATIVE_PIN_CNT])(void) = {nullptr};
+static int nativeIsrMode[NATIVE_PIN_CNT] = {0};
+
+static void nativeWritePin(uint8_t pin, int value)
+{
+  if (pin >= NATIVE_PIN_CNT)
+  {
+    return;
+  }
+
+  bool rising = !nativePins[pin] && value;
+  bool falling = nativePins[pin] && !value;
+  nativePins[pin] = value;
+  if (pin <= 16)
+  {
+    nativeGpioIn = value ? (nativeGpioIn | (1UL << pin)) : (nativeGpioIn & ~(1UL << pin));
+  }
+
+  // Run on the writing thread, like an interrupt preempting loop()
+  void (*isr)(void) = nativeIsr[pin];
+  if (isr != nullptr && ((rising && (nativeIsrMode[pin] & RISING)) || (falling && (nativeIsrMode[pin] & FALLING))))
+  {
+    isr();
+  }
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+  if (interruptNum < NATIVE_PIN_CNT)
+  {
+    nativeIsrMode[interruptNum] = mode;
+    nativeIsr[interruptNum] = userFunc;
+  }
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+  if (interruptNum < NATIVE_PIN_CNT)
+  {
+    nativeIsr[interruptNum] = nullptr;
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (mode == INPUT_PULLUP)
+  {
+    nativeWritePin(pin, HIGH);
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  nativeWritePin(pin, value ? HIGH : LOW);
+}
+
+int digitalRead(uint8_t pin)
+{
+  return (pin < NATIVE_PIN_CNT) ? (nativePins[pin] ? HIGH : LOW) : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+  return (pin < NATIVE_PIN_CNT) ? nativePins[pin] : 0;
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+  nativeWritePin(pin, value);
+}
+
+void nativeSetPin(uint8_t pin, int value)
+{
+  nativeWritePin(pin, value);
+}
+
+//***** Hardware timer (ESP8266 timer1) *****//
+static std::atomic<timercallback> nativeTimerCallback{nullptr};
+static std::atomic<uint32_t> nativeTimerMicros{0};
+static std::atomic<bool> nativeTimerRunning{false};
+static uint8_t nativeTimerDivider = TIM_DIV16;
+
+static void nativeTimerThread()
+{
+  auto next = std::chrono::steady_clock::now();
+  while (nativeTimerRunning)
+  {
+    next += std::chrono::microseconds(std::max(nativeTimerMicros.load(), (uint32_t)1));
+    std::this_thread::sleep_until(next);
+
+    timercallback callback = nativeTimerCallback;
+    if (callback != nullptr && nativeTimerRunning)
+    {
+      callback();
+    }
+  }
+}
+
+void timer1_attachInterrupt(timercallback userFunc)
+{
+  nativeTimerCallback = userFunc;
+}
+
+void timer1_detachInterrupt()
+{
+  nativeTimerCallback = nullptr;
+}
+
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload)
+{
+  nativeTimerDivider = divider;
+}
+
+void timer1_disable()
+{
+  nativeTimerRunning = false;
+}
+
+void timer1_write(uint32_t ticks)
+{
+  // 80 MHz divided by 1, 16 or 256
+  uint32_t ticksPerMicro = (nativeTimerDivider == TIM_DIV1) ? 80 : (nativeTimerDivider == TIM_DIV16) ? 5 : 0;
+  nativeTimerMicros = (ticksPerMicro > 0) ? ticks / ticksPerMicro : ticks * 16 / 5;
+
+  // Only one timer thread, it runs until the process ends
+  if (!nativeTimerRunning.exchange(true))
+  {
+    std::thread(nativeTimerThread).detach();
+  }
+}
+
+long random(long howbig)
+{
+  return (howbig <= 0) ? 0 : (rand() % howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+  return (howsmall >= howbig) ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed)
+{
+  srand((unsigned int)seed);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+  if (in_max == in_min)
+  {
+    return out_min;
+  }
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+//***** ESP *****//
+void EspClass::restart()
+{
+  printf("\nNATIVE: ESP.restart() requested - exiting.\n");
+  exit(0);
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+  // Report the d1_mini budget minus what the process currently holds
+  const long heapSize = 48 * 1024;
+  return (uint32_t)std::max(0L, heapSize - nativeStats.heapInUse);
+}
+
+uint32_t EspClass::getCycleCount()
+{
+  // 80 MHz equivalent cycle counter
+  return (uint32_t)(micros() * 80UL);
+}
+
+//***** main *****//
+// A PlatformIO test brings its own main() and drives setup()/loop() itself
+#ifndef PIO_UNIT_TESTING
+static void nativeDrivePins()
+{
+  static const char *script = getenv("ESPNODE_NATIVE_PINS");
+  if (script == nullptr || *script == '\0')
+  {
+    return;
+  }
+
+  unsigned long ms;
+  int pin;
+  int value;
+  int length;
+  while (sscanf(script, "%lu:%d=%d%n", &ms, &pin, &value, &length) == 3 && millis() >= ms)
+  {
+    nativeSetPin((uint8_t)pin, value);
+    script += length;
+    script += (*script == ',') ? 1 : 0;
+  }
+}
+
+static void nativePrintStats()
+{
+  unsigned long loops = std::max(1UL, nativeStats.loops);
+
+  printf("\nNATIVE: loops=%lu avgLoop=%luus maxLoop=%luus allocs=%lu (%.2f/loop) allocBytes=%lu frees=%lu heapInUse=%ld heapPeak=%ld mqttPublishes=%lu mqttBytes=%lu mqttReceived=%lu httpRequests=%lu httpWrites=%lu httpBytes=%lu\n",
+         nativeStats.loops,
+         nativeStats.loopMicrosTotal / loops,
+         nativeStats.loopMicrosMax,
+         nativeStats.allocCount,
+         (double)nativeStats.allocCount / loops,
+         nativeStats.allocBytes,
+         nativeStats.freeCount,
+         nativeStats.heapInUse,
+         nativeStats.heapPeak,
+         nativeStats.mqttPublishes,
+         nativeStats.mqttBytes,
+         nativeStats.mqttReceived,
+         nativeStats.httpRequests,
+         nativeStats.httpWrites,
+         nativeStats.httpBytes);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+  const char *loopsEnv = getenv("ESPNODE_NATIVE_LOOPS");
+  unsigned long maxLoops = (loopsEnv != nullptr) ? strtoul(loopsEnv, nullptr, 10) : 0;
+  const char *runEnv = getenv("ESPNODE_NATIVE_RUN_MS");
+  unsigned long runMillis = (runEnv != nullptr) ? strtoul(runEnv, nullptr, 10) : 0;
+
+  setup();
+
+  // Only count what loop() does, not the one-time setup
+  unsigned long setupAllocs = nativeStats.allocCount;
+  unsigned long setupBytes = nativeStats.allocBytes;
+  unsigned long setupFrees = nativeStats.freeCount;
+  printf("NATIVE: setup done - allocs=%lu allocBytes=%lu frees=%lu heapInUse=%ld heapPeak=%ld\n", setupAllocs, setupBytes, setupFrees, nativeStats.heapInUse, nativeStats.heapPeak);
+  nativeStats.allocCount = 0;
+  nativeStats.allocBytes = 0;
+  nativeStats.freeCount = 0;
+
+  while ((maxLoops == 0 || nativeStats.loops < maxLoops) && (runMillis == 0 || millis() < runMillis))
+  {
+    nativeDrivePins();
+
+    unsigned long start = micros();
+    loop();
+    unsigned long passed = micros() - start;
+
+    nativeStats.loops++;
+    nativeStats.loopMicrosTotal += passed;
+    nativeStats.loopMicrosMax = std::max(nativeStats.loopMicrosMax, passed);
+  }
+
+  timer1_disable();
+  nativePrintStats();
+  return 0;
+}
+
+#endif
@@ -0,0 +1,343 @@
+/**
+ * Arduino.h
+ *
+ * Host shim of the Arduino core for the native (Linux) build of EspNode.
+ * <p>
+ * Provides String, Print/Stream, Serial, timing, GPIO and ESP helpers, so the
+ * node library can be run and measured as a plain process.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <functional>
+#include <memory>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// ESP8266 (d1_mini) pin names
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define A0 17
+
+#define NATIVE_PIN_CNT 40
+
+//***** PROGMEM - flash strings are plain RAM on the host *****//
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+class __FlashStringHelper;
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper *>(pstr_pointer))
+#define F(string_literal) (FPSTR(string_literal))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+using std::max;
+using std::min;
+
+//***** String *****//
+class String
+{
+public:
+  String() {}
+  String(const char *cstr) : _buffer(cstr ? cstr : "") {}
+  String(const char *cstr, size_t length) : _buffer(cstr, length) {}
+  String(const std::string &str) : _buffer(str) {}
+  String(const __FlashStringHelper *pstr) : _buffer(pstr ? reinterpret_cast<const char *>(pstr) : "") {}
+  explicit String(char c) : _buffer(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  unsigned int length() const { return _buffer.length(); }
+  bool isEmpty() const { return _buffer.empty(); }
+  const char *c_str() const { return _buffer.c_str(); }
+  bool reserve(unsigned int size)
+  {
+    _buffer.reserve(size);
+    return true;
+  }
+
+  bool concat(const String &str);
+  bool concat(const char *cstr);
+  bool concat(const char *cstr, unsigned int length);
+  bool concat(char c);
+
+  String &operator+=(const String &rhs);
+  String &operator+=(const char *cstr);
+  String &operator+=(const __FlashStringHelper *pstr);
+  String &operator+=(char c);
+  String &operator+=(int value);
+  String &operator+=(unsigned int value);
+  String &operator+=(long value);
+  String &operator+=(unsigned long value);
+
+  bool equals(const String &str) const { return _buffer == str._buffer; }
+  bool equals(const char *cstr) const { return _buffer == (cstr ? cstr : ""); }
+  bool equalsIgnoreCase(const String &str) const;
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &rhs) const { return _buffer < rhs._buffer; }
+
+  bool startsWith(const String &prefix) const;
+  bool endsWith(const String &suffix) const;
+
+  char charAt(unsigned int index) const { return index < _buffer.length() ? _buffer[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index) { return _buffer[index]; }
+
+  int indexOf(char c, unsigned int fromIndex = 0) const;
+  int indexOf(const String &str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char c) const;
+
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(const String &find, const String &replace);
+  void replace(char find, char replace);
+  void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const { return atol(_buffer.c_str()); }
+  float toFloat() const { return (float)atof(_buffer.c_str()); }
+  void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+  void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+
+private:
+  std::string _buffer;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, const __FlashStringHelper *rhs);
+String operator+(const __FlashStringHelper *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+String operator+(const String &lhs, int rhs);
+String operator+(const String &lhs, unsigned int rhs);
+String operator+(const String &lhs, long rhs);
+String operator+(const String &lhs, unsigned long rhs);
+String operator+(const String &lhs, float rhs);
+String operator+(const String &lhs, double rhs);
+
+//***** Print / Stream *****//
+class Print
+{
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  size_t print(const String &str) { return write(str.c_str(), str.length()); }
+  size_t print(const char *str) { return write(str); }
+  size_t print(const __FlashStringHelper *pstr) { return write(reinterpret_cast<const char *>(pstr)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned int value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(unsigned long value, int base = DEC) { return print(String(value, (unsigned char)base)); }
+  size_t print(double value, int decimalPlaces = 2) { return print(String(value, (unsigned char)decimalPlaces)); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &value)
+  {
+    size_t n = print(value);
+    return n + println();
+  }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  virtual size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+  String readString();
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+//***** Serial *****//
+class HardwareSerial : public Stream
+{
+public:
+  using Print::write;
+
+  void begin(unsigned long baud) { _enabled = true; }
+  void end() { _enabled = false; }
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  void flush() override;
+
+  int available() override { return 0; }
+  int availableForWrite() { return _enabled ? 128 : 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+  operator bool() const { return _enabled; }
+
+private:
+  bool _enabled = false;
+};
+
+extern HardwareSerial Serial;
+
+//***** Timing, GPIO and helpers *****//
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+// Host only: drive an input pin from a test harness, edges run attached interrupts
+void nativeSetPin(uint8_t pin, int value);
+
+// GPIO input registers of the ESP8266, packed from the pin levels
+extern volatile uint32_t nativeGpioIn;
+#define GPI (nativeGpioIn & 0xffff)
+#define GP16I ((nativeGpioIn >> 16) & 0x01)
+
+//***** Hardware timer (ESP8266 timer1) *****//
+#define IRAM_ATTR
+#define TIM_DIV1 0
+#define TIM_DIV16 1
+#define TIM_DIV256 3
+#define TIM_EDGE 0
+#define TIM_LEVEL 1
+#define TIM_SINGLE 0
+#define TIM_LOOP 1
+
+typedef void (*timercallback)(void);
+
+// Host only: the interrupt runs on its own thread, preempting loop() like on the device
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_detachInterrupt();
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_disable();
+void timer1_write(uint32_t ticks);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+//***** ESP *****//
+class EspClass
+{
+public:
+  void restart();
+  uint8_t getCpuFreqMHz() { return 80; }
+  uint32_t getSketchSize() { return 0; }
+  uint32_t getFreeSketchSpace() { return 0; }
+  uint32_t getFreeHeap();
+  uint32_t getChipId() { return 0x00c0ffee; }
+  uint32_t getCycleCount();
+};
+
+extern EspClass ESP;
+
+//***** Native run statistics *****//
+struct NativeStats
+{
+  unsigned long loops;           // Number of loop() passes
+  unsigned long loopMicrosTotal; // Accumulated loop() time
+  unsigned long loopMicrosMax;   // Slowest loop() pass
+  unsigned long allocCount;      // Heap allocations
+  unsigned long allocBytes;      // Heap bytes allocated
+  unsigned long freeCount;       // Heap releases
+  long heapInUse;                // Currently allocated heap bytes
+  long heapPeak;                 // Peak allocated heap bytes
+  unsigned long mqttPublishes;   // Messages handed to the MQTT stand-in
+  unsigned long mqttBytes;       // Topic and payload bytes handed to the MQTT stand-in
+  unsigned long mqttReceived;    // Messages delivered by the MQTT stand-in
+  unsigned long httpRequests;    // Requests served by the web server stand-in
+  unsigned long httpWrites;      // Socket writes issued for responses
+  unsigned long httpBytes;       // Response bytes written
+};
+
+extern NativeStats nativeStats;
+
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,14 @@
+/**
+ * EEPROM.cpp
+ *
+ * Host shim of the ESP EEPROM emulation, kept in RAM only.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
@@ -0,0 +1,40 @@
+/**
+ * EEPROM.h
+ *
+ * Host shim of the ESP EEPROM emulation, kept in RAM only.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <Arduino.h>
+
+class EEPROMClass
+{
+public:
+  void begin(size_t size) { _size = (size <= sizeof(_data)) ? size : sizeof(_data); }
+  uint8_t read(int address) { return (address >= 0 && (size_t)address < _size) ? _data[address] : 0; }
+  void write(int address, uint8_t value)
+  {
+    if (address >= 0 && (size_t)address < _size)
+    {
+      _data[address] = value;
+    }
+  }
+  bool commit() { return true; }
+  void end() {}
+  uint16_t length() { return (uint16_t)_size; }
+
+private:
+  uint8_t _data[4096] = {0};
+  size_t _size = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
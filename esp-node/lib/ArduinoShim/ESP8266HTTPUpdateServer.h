@@ -0,0 +1,33 @@
+/**
+ * ESP8266HTTPUpdateServer.h
+ *
+ * Host shim of the HTTP firmware update server - registers the upload route
+ * and refuses every update.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef ESP8266HTTPUpdateServer_h
+#define ESP8266HTTPUpdateServer_h
+
+#include <ESP8266WebServer.h>
+
+class ESP8266HTTPUpdateServer
+{
+public:
+  void setup(ESP8266WebServer *server, const String &path = String(F("/update")))
+  {
+    setup(server, path, String(), String());
+  }
+
+  void setup(ESP8266WebServer *server, const String &path, const String &username, const String &password)
+  {
+    server->on(path, HTTP_POST, [server]()
+               { server->send(500, "text/plain", String(F("Update not supported on native"))); });
+  }
+};
+
+#endif
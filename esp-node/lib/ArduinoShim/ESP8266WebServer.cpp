@@ -0,0 +1,248 @@
+/**
+ * ESP8266WebServer.cpp
+ *
+ * Host shim of the ESP8266 web server with a request stand-in.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "ESP8266WebServer.h"
+
+void ESP8266WebServer::begin()
+{
+  _started = true;
+  _currentClient.nativeSetWeb(true);
+
+  const char *requests = getenv("ESPNODE_NATIVE_HTTP");
+  if (requests == nullptr)
+  {
+    return;
+  }
+
+  std::string list = requests;
+  size_t start = 0;
+  while (start <= list.length())
+  {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos)
+    {
+      end = list.length();
+    }
+    if (end > start)
+    {
+      _requests.push_back(list.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+}
+
+void ESP8266WebServer::handleClient()
+{
+  if (!_started || _requests.empty())
+  {
+    return;
+  }
+
+  if (_requestIndex >= _requests.size())
+  {
+    if (getenv("ESPNODE_NATIVE_HTTP_REPEAT") == nullptr)
+    {
+      return;
+    }
+    _requestIndex = 0;
+  }
+
+  _parseRequest(_requests[_requestIndex++]);
+  _contentLength = CONTENT_LENGTH_NOT_SET;
+  _pendingHeaders = String();
+  _pendingEtag = String();
+  nativeStats.httpRequests++;
+
+  std::vector<String> pathArgs;
+  for (RequestHandler &handler : _handlers)
+  {
+    if (handler.uri.canHandle(_currentUri, pathArgs) && (handler.method == HTTP_ANY || handler.method == _currentMethod))
+    {
+      handler.handler();
+      return;
+    }
+  }
+
+  if (_notFoundHandler)
+  {
+    _notFoundHandler();
+  }
+  else
+  {
+    send(404, "text/plain", String(F("Not found")));
+  }
+}
+
+void ESP8266WebServer::on(const Uri &uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler)
+{
+  _handlers.push_back({uri, method, handler});
+}
+
+bool ESP8266WebServer::authenticate(const char *username, const char *password)
+{
+  // The stand-in client always sends valid credentials
+  return true;
+}
+
+void ESP8266WebServer::requestAuthentication()
+{
+  send(401);
+}
+
+String ESP8266WebServer::arg(const String &name) const
+{
+  for (const auto &arg : _currentArgs)
+  {
+    if (arg.first == name)
+    {
+      return arg.second;
+    }
+  }
+  return String();
+}
+
+String ESP8266WebServer::arg(int i) const
+{
+  return (i >= 0 && (size_t)i < _currentArgs.size()) ? _currentArgs[i].second : String();
+}
+
+String ESP8266WebServer::argName(int i) const
+{
+  return (i >= 0 && (size_t)i < _currentArgs.size()) ? _currentArgs[i].first : String();
+}
+
+bool ESP8266WebServer::hasArg(const String &name) const
+{
+  for (const auto &arg : _currentArgs)
+  {
+    if (arg.first == name)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+String ESP8266WebServer::header(const String &name) const
+{
+  if (name == "If-None-Match" && getenv("ESPNODE_NATIVE_HTTP_CACHE") != nullptr)
+  {
+    auto etag = _etags.find(_currentUri.c_str());
+    if (etag != _etags.end())
+    {
+      return String(etag->second.c_str());
+    }
+  }
+  return String();
+}
+
+void ESP8266WebServer::sendHeader(const String &name, const String &value, bool first)
+{
+  // Held back until send(), the headers follow the status line like on the device
+  _pendingHeaders += name + F(": ") + value + F("\r\n");
+
+  if (name == "ETag")
+  {
+    _pendingEtag = value;
+  }
+}
+
+void ESP8266WebServer::send(int code, const char *contentType, const String &content)
+{
+  // Built in the head string, so no content type is cut
+  String head(F("HTTP/1.1 "));
+  head += String(code);
+  head += F("\r\nContent-Type: ");
+  head += contentType ? contentType : "text/html";
+  head += F("\r\n");
+  head += _pendingHeaders;
+  head += F("\r\n");
+  _pendingHeaders = String();
+  _write(head.c_str(), head.length());
+
+  // The client caches what it received, not what the handler looked at
+  if (_pendingEtag.length() > 0)
+  {
+    _etags[_currentUri.c_str()] = _pendingEtag.c_str();
+    _pendingEtag = String();
+  }
+
+  if (content.length() > 0)
+  {
+    sendContent(content);
+  }
+}
+
+void ESP8266WebServer::send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength)
+{
+  send(code, contentType, String());
+  sendContent(content, contentLength);
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t contentLength)
+{
+  if (_contentLength == CONTENT_LENGTH_UNKNOWN)
+  {
+    // Chunked transfer, header and trailer go out with the same write
+    char chunkHeader[16];
+    int length = snprintf(chunkHeader, sizeof(chunkHeader), "%zx\r\n", contentLength);
+    _write(chunkHeader, (size_t)length);
+    nativeStats.httpWrites--;
+  }
+
+  _write(content, contentLength);
+}
+
+void ESP8266WebServer::_parseRequest(const std::string &request)
+{
+  _currentArgs.clear();
+  _currentMethod = HTTP_GET;
+
+  size_t query = request.find('?');
+  _currentUri = String(request.substr(0, query).c_str());
+
+  if (query == std::string::npos)
+  {
+    return;
+  }
+
+  _currentMethod = HTTP_POST;
+
+  std::string args = request.substr(query + 1);
+  size_t start = 0;
+  while (start < args.length())
+  {
+    size_t end = args.find('&', start);
+    if (end == std::string::npos)
+    {
+      end = args.length();
+    }
+
+    std::string pair = args.substr(start, end - start);
+    size_t equals = pair.find('=');
+    String name(pair.substr(0, equals).c_str());
+    String value((equals == std::string::npos) ? "" : pair.substr(equals + 1).c_str());
+    _currentArgs.emplace_back(name, value);
+
+    start = end + 1;
+  }
+}
+
+void ESP8266WebServer::_write(const char *data, size_t length)
+{
+  nativeStats.httpWrites++;
+  nativeStats.httpBytes += length;
+
+  if (getenv("ESPNODE_NATIVE_HTTP_LOG") != nullptr)
+  {
+    fwrite(data, 1, length, stdout);
+  }
+}
@@ -0,0 +1,117 @@
+/**
+ * ESP8266WebServer.h
+ *
+ * Host shim of the ESP8266 web server with a request stand-in.
+ * <p>
+ * ESPNODE_NATIVE_HTTP holds a comma separated list of request URIs (optionally
+ * with "?name=value&..." arguments), served one per handleClient() call. With
+ * ESPNODE_NATIVE_HTTP_REPEAT set the list is served over and over. Responses
+ * are counted and written to stdout when ESPNODE_NATIVE_HTTP_LOG is set. With
+ * ESPNODE_NATIVE_HTTP_CACHE set the stand-in client keeps the last ETag of each
+ * URI and sends it back as If-None-Match, like a browser revalidating its cache.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef ESP8266WebServer_h
+#define ESP8266WebServer_h
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <Uri.h>
+
+#include <map>
+#include <vector>
+
+enum HTTPMethod
+{
+  HTTP_ANY,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+  HTTP_PATCH,
+  HTTP_DELETE,
+  HTTP_OPTIONS
+};
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+class ESP8266WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  ESP8266WebServer(int port = 80) : _port(port) {}
+
+  void begin();
+  void handleClient();
+  void close() {}
+  void stop() {}
+
+  void on(const Uri &uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+  void on(const Uri &uri, HTTPMethod method, THandlerFunction handler) { on(uri, method, handler, nullptr); }
+  void on(const Uri &uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler);
+  void onNotFound(THandlerFunction handler) { _notFoundHandler = handler; }
+
+  bool authenticate(const char *username, const char *password);
+  void requestAuthentication();
+
+  String uri() const { return _currentUri; }
+  HTTPMethod method() const { return _currentMethod; }
+  WiFiClient &client() { return _currentClient; }
+
+  String arg(const String &name) const;
+  String arg(int i) const;
+  String argName(int i) const;
+  int args() const { return (int)_currentArgs.size(); }
+  bool hasArg(const String &name) const;
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount) {}
+  String header(const String &name) const;
+  bool hasHeader(const String &name) const { return header(name).length() > 0; }
+
+  void setContentLength(size_t contentLength) { _contentLength = contentLength; }
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void send(int code, const char *contentType = nullptr, const String &content = String());
+  void send(int code, const String &contentType, const String &content) { send(code, contentType.c_str(), content); }
+  void send_P(int code, PGM_P contentType, PGM_P content) { send(code, contentType, String(content)); }
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength);
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char *content, size_t contentLength);
+  void sendContent_P(PGM_P content) { sendContent(content, strlen(content)); }
+  void sendContent_P(PGM_P content, size_t contentLength) { sendContent(content, contentLength); }
+
+private:
+  struct RequestHandler
+  {
+    Uri uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  };
+
+  int _port;
+  bool _started = false;
+  std::vector<RequestHandler> _handlers;
+  THandlerFunction _notFoundHandler;
+
+  std::vector<std::string> _requests;
+  size_t _requestIndex = 0;
+
+  String _currentUri;
+  HTTPMethod _currentMethod = HTTP_GET;
+  std::vector<std::pair<String, String>> _currentArgs;
+  WiFiClient _currentClient;
+  size_t _contentLength = CONTENT_LENGTH_NOT_SET;
+  String _pendingHeaders;
+  String _pendingEtag;
+  std::map<std::string, std::string> _etags;
+
+  void _parseRequest(const std::string &request);
+  void _write(const char *data, size_t length);
+};
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * ESP8266WiFi.cpp
+ *
+ * Host shim of the ESP WiFi API.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "ESP8266WiFi.h"
+
+ESP8266WiFiClass WiFi;
+
+String IPAddress::toString() const
+{
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _octets[0], _octets[1], _octets[2], _octets[3]);
+  return String(buf);
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size)
+{
+  if (_web && _connected)
+  {
+    nativeStats.httpWrites++;
+    nativeStats.httpBytes += size;
+
+    if (getenv("ESPNODE_NATIVE_HTTP_LOG") != nullptr)
+    {
+      fwrite(buffer, 1, size, stdout);
+    }
+  }
+
+  return size;
+}
+
+wl_status_t ESP8266WiFiClass::begin(const char *ssid, const char *passphrase)
+{
+  if (ssid != nullptr)
+  {
+    _ssid = ssid;
+  }
+  _started = true;
+
+  const char *down = getenv("ESPNODE_NATIVE_WIFI_DOWN");
+  if (down != nullptr && sscanf(down, "%lu-%lu", &_downFromMillis, &_downUntilMillis) != 2)
+  {
+    _linkUp = false;
+  }
+
+  return status();
+}
+
+bool ESP8266WiFiClass::reconnect()
+{
+  _started = true;
+  return true;
+}
+
+bool ESP8266WiFiClass::disconnect(bool wifioff)
+{
+  _started = false;
+  return true;
+}
+
+wl_status_t ESP8266WiFiClass::status()
+{
+  unsigned long now = millis();
+  bool inDownWindow = (now >= _downFromMillis) && (now < _downUntilMillis);
+
+  return (_started && _linkUp && !inDownWindow) ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress ESP8266WiFiClass::localIP()
+{
+  return (status() == WL_CONNECTED) ? IPAddress(127, 0, 0, 1) : IPAddress();
+}
+
+uint8_t *ESP8266WiFiClass::macAddress(uint8_t *mac)
+{
+  const uint8_t nativeMac[6] = {0x02, 0x00, 0x00, 0xc0, 0xff, 0xee};
+  memcpy(mac, nativeMac, sizeof(nativeMac));
+  return mac;
+}
+
+String ESP8266WiFiClass::macAddress()
+{
+  return String(F("02:00:00:C0:FF:EE"));
+}
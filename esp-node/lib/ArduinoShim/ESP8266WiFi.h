@@ -0,0 +1,130 @@
+/**
+ * ESP8266WiFi.h
+ *
+ * Host shim of the ESP WiFi API.
+ * <p>
+ * The station is connected from begin() on, unless ESPNODE_NATIVE_WIFI_DOWN is
+ * set or nativeSetConnected(false) is called by a test harness. A value of
+ * "from-to" (ms since start) only drops the link within that window.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include <Arduino.h>
+
+typedef enum
+{
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} WiFiMode_t;
+
+class IPAddress
+{
+public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _octets{a, b, c, d} {}
+
+  uint8_t operator[](int index) const { return _octets[index]; }
+  bool operator==(const IPAddress &rhs) const { return memcmp(_octets, rhs._octets, sizeof(_octets)) == 0; }
+  String toString() const;
+  operator uint32_t() const { return (uint32_t)_octets[0] | ((uint32_t)_octets[1] << 8) | ((uint32_t)_octets[2] << 16) | ((uint32_t)_octets[3] << 24); }
+
+private:
+  uint8_t _octets[4];
+};
+
+class Client : public Stream
+{
+public:
+  virtual int connect(const char *host, uint16_t port) = 0;
+  virtual uint8_t connected() = 0;
+  virtual void stop() = 0;
+};
+
+class WiFiClient : public Client
+{
+public:
+  using Print::write;
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+  int connect(const char *host, uint16_t port) override
+  {
+    _connected = true;
+    return 1;
+  }
+  uint8_t connected() override { return _connected; }
+  void stop() override { _connected = false; }
+  void setNoDelay(bool noDelay) {}
+
+  // Clients handed out by the web server stand-in are connected, they count and log what is written to them
+  void nativeSetWeb(bool web)
+  {
+    _web = web;
+    _connected = web;
+  }
+
+  IPAddress remoteIP() const { return IPAddress(127, 0, 0, 1); }
+
+  operator bool() { return _connected; }
+
+private:
+  bool _connected = false;
+  bool _web = false;
+};
+
+class ESP8266WiFiClass
+{
+public:
+  wl_status_t begin(const char *ssid = nullptr, const char *passphrase = nullptr);
+  bool reconnect();
+  bool disconnect(bool wifioff = false);
+  bool mode(WiFiMode_t mode) { return true; }
+  bool setAutoReconnect(bool autoReconnect) { return true; }
+  bool hostname(const char *name) { return true; }
+
+  wl_status_t status();
+  IPAddress localIP();
+  String SSID() const { return String(_ssid.c_str()); }
+  int32_t RSSI() { return (status() == WL_CONNECTED) ? -55 : 0; }
+  uint8_t *macAddress(uint8_t *mac);
+  String macAddress();
+
+  // Host only: simulate link loss and recovery from a test harness
+  void nativeSetConnected(bool connected) { _linkUp = connected; }
+
+private:
+  bool _started = false;
+  bool _linkUp = true;
+  unsigned long _downFromMillis = 0;
+  unsigned long _downUntilMillis = 0;
+  std::string _ssid = "native";
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * FS.cpp
+ *
+ * Host shim of the ESP file system API, backed by a directory on the host.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "FS.h"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+fs::FS SPIFFS;
+
+File::File(FILE *file, const char *path) : _file(file, fclose), _path(path)
+{
+}
+
+size_t File::write(uint8_t c)
+{
+  return _file ? fwrite(&c, 1, 1, _file.get()) : 0;
+}
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+  return _file ? fwrite(buffer, 1, size, _file.get()) : 0;
+}
+
+void File::flush()
+{
+  if (_file)
+  {
+    fflush(_file.get());
+    fsync(fileno(_file.get()));
+  }
+}
+
+int File::available()
+{
+  return _file ? (int)(size() - position()) : 0;
+}
+
+int File::read()
+{
+  return _file ? fgetc(_file.get()) : -1;
+}
+
+int File::peek()
+{
+  if (!_file)
+  {
+    return -1;
+  }
+
+  int c = fgetc(_file.get());
+  if (c >= 0)
+  {
+    ungetc(c, _file.get());
+  }
+  return c;
+}
+
+size_t File::readBytes(char *buffer, size_t length)
+{
+  return _file ? fread(buffer, 1, length, _file.get()) : 0;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  return _file && (fseek(_file.get(), (long)pos, (mode == SeekSet) ? SEEK_SET : (mode == SeekCur) ? SEEK_CUR : SEEK_END) == 0);
+}
+
+size_t File::position() const
+{
+  return _file ? (size_t)ftell(_file.get()) : 0;
+}
+
+size_t File::size() const
+{
+  if (!_file)
+  {
+    return 0;
+  }
+
+  struct stat st;
+  fflush(_file.get());
+  return (fstat(fileno(_file.get()), &st) == 0) ? (size_t)st.st_size : 0;
+}
+
+void File::close()
+{
+  _file.reset();
+}
+
+namespace fs
+{
+  std::string FS::_hostPath(const char *path)
+  {
+    const char *root = getenv("ESPNODE_NATIVE_FS");
+    std::string hostPath = (root != nullptr) ? root : "./.spiffs";
+
+    if (path[0] != '/')
+    {
+      hostPath += '/';
+    }
+    return hostPath + path;
+  }
+
+  bool FS::begin(bool formatOnFail)
+  {
+    std::string root = _hostPath("");
+    mkdir(root.c_str(), 0755);
+
+    struct stat st;
+    return (stat(root.c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+  }
+
+  bool FS::format()
+  {
+    std::string root = _hostPath("");
+    DIR *dir = opendir(root.c_str());
+    if (dir == nullptr)
+    {
+      return false;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+      if (entry->d_name[0] != '.')
+      {
+        unlink((root + "/" + entry->d_name).c_str());
+      }
+    }
+    closedir(dir);
+    return true;
+  }
+
+  File FS::open(const char *path, const char *mode)
+  {
+    // Arduino modes map to stdio modes, always binary
+    std::string stdioMode = mode;
+    stdioMode += 'b';
+
+    FILE *file = fopen(_hostPath(path).c_str(), stdioMode.c_str());
+    return (file != nullptr) ? File(file, path) : File();
+  }
+
+  bool FS::exists(const char *path)
+  {
+    struct stat st;
+    return stat(_hostPath(path).c_str(), &st) == 0;
+  }
+
+  bool FS::remove(const char *path)
+  {
+    return unlink(_hostPath(path).c_str()) == 0;
+  }
+
+  bool FS::rename(const char *pathFrom, const char *pathTo)
+  {
+    return ::rename(_hostPath(pathFrom).c_str(), _hostPath(pathTo).c_str()) == 0;
+  }
+}
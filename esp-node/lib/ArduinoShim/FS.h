@@ -0,0 +1,83 @@
+/**
+ * FS.h
+ *
+ * Host shim of the ESP file system API, backed by a directory on the host.
+ * <p>
+ * The directory is taken from ESPNODE_NATIVE_FS and defaults to ./.spiffs.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef FS_h
+#define FS_h
+
+#include <Arduino.h>
+
+enum SeekMode
+{
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+class File : public Stream
+{
+public:
+  File() {}
+  File(FILE *file, const char *path);
+
+  using Print::write;
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  void flush() override;
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char *buffer, size_t length) override;
+  size_t read(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  const char *name() const { return _path.c_str(); }
+  void close();
+
+  operator bool() const { return _file != nullptr; }
+
+private:
+  std::shared_ptr<FILE> _file;
+  std::string _path;
+};
+
+namespace fs
+{
+  class FS
+  {
+  public:
+    bool begin(bool formatOnFail = false);
+    void end() {}
+    bool format();
+
+    File open(const char *path, const char *mode = "r");
+    File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *pathFrom, const char *pathTo);
+
+  private:
+    std::string _hostPath(const char *path);
+  };
+}
+
+using fs::FS;
+
+extern fs::FS SPIFFS;
+
+#endif
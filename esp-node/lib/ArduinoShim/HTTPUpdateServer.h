@@ -0,0 +1,19 @@
+/**
+ * HTTPUpdateServer.h
+ *
+ * Host shim of the ESP32 HTTP firmware update server header.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef HTTPUpdateServer_h
+#define HTTPUpdateServer_h
+
+#include <ESP8266HTTPUpdateServer.h>
+
+typedef ESP8266HTTPUpdateServer HTTPUpdateServer;
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * MQTTClient.cpp
+ *
+ * Host shim of the 256dpi MQTT client with an in-process broker stand-in.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "MQTTClient.h"
+
+void MQTTClient::begin(const char hostname[], int port, Client &client)
+{
+  _netClient = &client;
+  _loadInjected();
+}
+
+bool MQTTClient::connect(const char clientId[], const char username[], const char password[], bool skip)
+{
+  if (WiFi.status() != WL_CONNECTED || getenv("ESPNODE_NATIVE_MQTT_DOWN") != nullptr)
+  {
+    _connected = false;
+    _returnCode = LWMQTT_SERVER_UNAVAILABLE;
+    return false;
+  }
+
+  _connected = true;
+  _returnCode = LWMQTT_CONNECTION_ACCEPTED;
+  return true;
+}
+
+bool MQTTClient::disconnect()
+{
+  _connected = false;
+  return true;
+}
+
+bool MQTTClient::publish(const char topic[], const char payload[], int length, bool retained, int qos)
+{
+  if (!connected())
+  {
+    return false;
+  }
+
+  size_t topicLength = strlen(topic);
+  if ((int)(topicLength + length) > _bufSize)
+  {
+    return false;
+  }
+
+  nativeStats.mqttPublishes++;
+  nativeStats.mqttBytes += topicLength + length;
+
+  if (getenv("ESPNODE_NATIVE_MQTT_LOG") != nullptr)
+  {
+    printf("MQTT> %s %.*s\n", topic, length, payload);
+  }
+
+  if (_matches(topic))
+  {
+    _inbox.emplace_back(std::string(topic), std::string(payload, length));
+  }
+
+  return true;
+}
+
+bool MQTTClient::subscribe(const char topic[], int qos)
+{
+  if (!connected())
+  {
+    return false;
+  }
+
+  _subscriptions.emplace_back(topic);
+  return true;
+}
+
+bool MQTTClient::unsubscribe(const char topic[])
+{
+  for (auto it = _subscriptions.begin(); it != _subscriptions.end(); ++it)
+  {
+    if (*it == topic)
+    {
+      _subscriptions.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MQTTClient::loop()
+{
+  if (!connected())
+  {
+    return false;
+  }
+
+  // Deliver one message per pass, as a real broker would trickle them in
+  if (!_inbox.empty() && _callback)
+  {
+    String topic(_inbox.front().first.c_str());
+    String payload(_inbox.front().second.c_str());
+    _inbox.pop_front();
+
+    nativeStats.mqttReceived++;
+    _callback(topic, payload);
+  }
+
+  return true;
+}
+
+bool MQTTClient::connected()
+{
+  if (_connected && WiFi.status() != WL_CONNECTED)
+  {
+    _connected = false;
+  }
+  return _connected;
+}
+
+bool MQTTClient::_matches(const char *topic)
+{
+  for (const std::string &filter : _subscriptions)
+  {
+    size_t wildcard = filter.find('#');
+    if (wildcard == std::string::npos)
+    {
+      if (filter == topic)
+      {
+        return true;
+      }
+    }
+    else if (strncmp(filter.c_str(), topic, wildcard) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MQTTClient::_loadInjected()
+{
+  const char *path = getenv("ESPNODE_NATIVE_MQTT_INJECT");
+  if (path == nullptr)
+  {
+    return;
+  }
+
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    printf("NATIVE: MQTT inject file '%s' not found.\n", path);
+    return;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof(line), file) != nullptr)
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+
+    char *separator = strchr(line, ' ');
+    if (line[0] == '\0' || line[0] == '#' || separator == nullptr)
+    {
+      continue;
+    }
+
+    *separator = '\0';
+    _inbox.emplace_back(std::string(line), std::string(separator + 1));
+  }
+  fclose(file);
+}
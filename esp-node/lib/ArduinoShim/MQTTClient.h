@@ -0,0 +1,88 @@
+/**
+ * MQTTClient.h
+ *
+ * Host shim of the 256dpi MQTT client with an in-process broker stand-in.
+ * <p>
+ * Publishes are counted (and echoed with ESPNODE_NATIVE_MQTT_LOG set) and
+ * delivered back to matching subscriptions. Lines "topic payload" from the
+ * file in ESPNODE_NATIVE_MQTT_INJECT are delivered one per loop() after connect.
+ * ESPNODE_NATIVE_MQTT_DOWN makes every connect attempt fail.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef MQTTClient_h
+#define MQTTClient_h
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#include <deque>
+#include <vector>
+
+class MQTTClient;
+
+typedef void (*MQTTClientCallbackSimple)(String &topic, String &payload);
+typedef std::function<void(String &topic, String &payload)> MQTTClientCallbackSimpleFunction;
+
+typedef enum
+{
+  LWMQTT_CONNECTION_ACCEPTED = 0,
+  LWMQTT_UNACCEPTABLE_PROTOCOL = 1,
+  LWMQTT_IDENTIFIER_REJECTED = 2,
+  LWMQTT_SERVER_UNAVAILABLE = 3,
+  LWMQTT_BAD_USERNAME_OR_PASSWORD = 4,
+  LWMQTT_NOT_AUTHORIZED = 5,
+  LWMQTT_UNKNOWN_RETURN_CODE = 6
+} lwmqtt_return_code_t;
+
+class MQTTClient
+{
+public:
+  explicit MQTTClient(int bufSize = 128) : _bufSize(bufSize) {}
+
+  void begin(const char hostname[], int port, Client &client);
+  void begin(const char hostname[], Client &client) { begin(hostname, 1883, client); }
+
+  void onMessage(MQTTClientCallbackSimple callback) { _callback = callback; }
+  void onMessage(MQTTClientCallbackSimpleFunction callback) { _callback = callback; }
+
+  void setOptions(int keepAlive, bool cleanSession, int timeout) {}
+  void setWill(const char topic[], const char payload[], bool retained = false, int qos = 0) {}
+
+  bool connect(const char clientId[], bool skip = false) { return connect(clientId, nullptr, nullptr, skip); }
+  bool connect(const char clientId[], const char username[], const char password[], bool skip = false);
+  bool disconnect();
+
+  bool publish(const String &topic, const String &payload) { return publish(topic.c_str(), payload.c_str(), (int)payload.length()); }
+  bool publish(const char topic[], const String &payload) { return publish(topic, payload.c_str(), (int)payload.length()); }
+  bool publish(const char topic[], const char payload[]) { return publish(topic, payload, (int)strlen(payload)); }
+  bool publish(const char topic[], const char payload[], int length) { return publish(topic, payload, length, false, 0); }
+  bool publish(const char topic[], const char payload[], int length, bool retained, int qos);
+
+  bool subscribe(const String &topic) { return subscribe(topic.c_str()); }
+  bool subscribe(const char topic[], int qos = 0);
+  bool unsubscribe(const String &topic) { return unsubscribe(topic.c_str()); }
+  bool unsubscribe(const char topic[]);
+
+  bool loop();
+  bool connected();
+  lwmqtt_return_code_t returnCode() { return _returnCode; }
+
+private:
+  int _bufSize;
+  Client *_netClient = nullptr;
+  bool _connected = false;
+  lwmqtt_return_code_t _returnCode = LWMQTT_CONNECTION_ACCEPTED;
+  MQTTClientCallbackSimpleFunction _callback;
+  std::vector<std::string> _subscriptions;
+  std::deque<std::pair<std::string, std::string>> _inbox;
+
+  bool _matches(const char *topic);
+  void _loadInjected();
+};
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * Uri.h
+ *
+ * Host shim of the web server route pattern, matches the exact path only.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef Uri_h
+#define Uri_h
+
+#include <Arduino.h>
+
+#include <vector>
+
+class Uri
+{
+public:
+  Uri(const char *uri) : _uri(uri) {}
+  Uri(const String &uri) : _uri(uri) {}
+  Uri(const __FlashStringHelper *uri) : _uri(uri) {}
+  virtual ~Uri() {}
+
+  virtual Uri *clone() const { return new Uri(_uri); }
+  virtual bool canHandle(const String &requestUri, std::vector<String> &pathArgs) { return _uri == requestUri; }
+  const String &str() const { return _uri; }
+
+protected:
+  String _uri;
+};
+
+#endif
@@ -0,0 +1,19 @@
+/**
+ * WebServer.h
+ *
+ * Host shim of the ESP32 web server header, same API as the ESP8266 one.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef WebServer_h
+#define WebServer_h
+
+#include <ESP8266WebServer.h>
+
+typedef ESP8266WebServer WebServer;
+
+#endif
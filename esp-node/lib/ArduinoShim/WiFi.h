@@ -0,0 +1,17 @@
+/**
+ * WiFi.h
+ *
+ * Host shim of the ESP32 WiFi header, same API as the ESP8266 one.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef WiFi_h
+#define WiFi_h
+
+#include <ESP8266WiFi.h>
+
+#endif
@@ -0,0 +1,41 @@
+/**
+ * WiFiManager.h
+ *
+ * Host shim of WiFiManager - connects straight away, no captive portal.
+ * <p>
+ * The page strings are shared with the real library, so the web pages render
+ * the same on the host.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef WiFiManager_h
+#define WiFiManager_h
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ESP8266WiFi.h>
+#include <strings_en.h>
+
+class WiFiManager
+{
+public:
+  bool autoConnect(const char *apName = nullptr, const char *apPassword = nullptr)
+  {
+    WiFi.begin();
+    return WiFi.status() == WL_CONNECTED;
+  }
+
+  void resetSettings()
+  {
+    WiFi.disconnect();
+  }
+
+  void setConfigPortalTimeout(unsigned long seconds) {}
+  void setConnectTimeout(unsigned long seconds) {}
+};
+
+#endif
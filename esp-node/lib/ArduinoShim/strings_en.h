@@ -0,0 +1,20 @@
+/**
+ * strings_en.h
+ *
+ * Host shim forwarding to the page strings of the real WiFiManager library,
+ * which is left out of the native build.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef EspNodeShim_strings_en_h
+#define EspNodeShim_strings_en_h
+
+// No radio on the host, the country presets are of no use
+#define WM_NOCOUNTRY
+#include "../WiFiManager/strings_en.h"
+
+#endif
@@ -0,0 +1,176 @@
+/**
+ * EspNodeAsyncWeb.h
+ *
+ * Optional asynchronous web backend of EspNode, built with -D ESPNODE_WEB_ASYNC.
+ * <p>
+ * Requests are accepted and parsed by ESPAsyncWebServer outside the loop and
+ * queued, a bounded number at a time. The web task runs one queued request per
+ * pass through the same ESP8266WebServer style API the synchronous backend
+ * offers, so webRegisterHandler() and all page handlers work unchanged. The
+ * rendered response is handed back to the TCP stack, which sends it at the
+ * client's pace. Firmware uploads are written to flash chunk by chunk as they
+ * arrive.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef EspNodeAsyncWeb_h
+#define EspNodeAsyncWeb_h
+
+#ifdef ESPNODE_WEB_ASYNC
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <Uri.h>
+
+#ifndef CONTENT_LENGTH_UNKNOWN
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#endif
+#ifndef CONTENT_LENGTH_NOT_SET
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+#endif
+
+const static int WEB_ASYNC_CONN_CNT = 4;    // Max number of open requests, queued or sending, more are answered with 503
+const static int WEB_ASYNC_ROUTE_CNT = 24;  // Max number of registered routes
+const static int WEB_ASYNC_HEADER_CNT = 4;  // Max number of headers set before the response is started
+
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)> EspNodeAsyncUploadHandler;
+
+class EspNodeAsyncWebServer;
+
+class EspNodeAsyncHandler : public AsyncWebHandler
+{
+public:
+  EspNodeAsyncHandler(EspNodeAsyncWebServer *server);
+
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) override;
+  bool isRequestHandlerTrivial() override;
+
+private:
+  EspNodeAsyncWebServer *_server; // Server queueing the requests
+};
+
+class EspNodeAsyncClient
+{
+public:
+  IPAddress remoteIP() const;
+
+private:
+  friend class EspNodeAsyncWebServer;
+
+  IPAddress _remoteIP; // Address of the client of the current request, kept when it disconnects
+};
+
+class EspNodeAsyncWebServer
+{
+  friend class EspNodeAsyncHandler;
+
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  EspNodeAsyncWebServer(int port);
+  ~EspNodeAsyncWebServer();
+
+  void begin();
+  void handleClient();
+
+  void on(const Uri &uri, THandlerFunction handler);
+  void on(const Uri &uri, WebRequestMethodComposite method, THandlerFunction handler);
+  void onUpload(const Uri &uri, EspNodeAsyncUploadHandler handler);
+  void onNotFound(THandlerFunction handler);
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+  void onEvents(const String &path, const String &username, const String &password, size_t maxClients);
+  void sendEvent(const char *event, const char *data);
+  size_t eventClientCnt();
+
+  bool authenticate(const char *username, const char *password);
+  void requestAuthentication();
+
+  String uri();
+  WebRequestMethodComposite method();
+  EspNodeAsyncClient &client();
+  String arg(const String &name);
+  String arg(int i);
+  String argName(int i);
+  int args();
+  bool hasArg(const String &name);
+  String header(const String &name);
+
+  void setContentLength(size_t contentLength);
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void send(int code, const char *contentType = nullptr, const String &content = String());
+  void send(int code, const String &contentType, const String &content);
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength);
+  void sendContent(const String &content);
+  void sendContent(const char *content, size_t contentLength);
+
+private:
+  struct Route
+  {
+    Uri *uri;                          // Pattern of the route, cloned on registration
+    WebRequestMethodComposite method;  // Methods handled by the route
+    THandlerFunction handler;          // Page handler, run by the loop
+    EspNodeAsyncUploadHandler upload;  // Upload handler, run by the TCP stack as the data arrives
+  };
+
+  AsyncWebServer _server;
+  Route _routes[WEB_ASYNC_ROUTE_CNT];
+  int _routeCnt = 0;
+  THandlerFunction _notFoundHandler = nullptr;
+  AsyncEventSource *_events = nullptr; // Event streams, served by the TCP stack without the queue
+
+  AsyncWebServerRequest *_queue[WEB_ASYNC_CONN_CNT]; // Parsed requests waiting for the loop, cleared when their client disconnects
+  uint8_t _queueHead = 0;
+  uint8_t _queueCnt = 0;
+  uint8_t _connCnt = 0; // Number of accepted requests, until their client disconnects
+#ifdef ESP32
+  SemaphoreHandle_t _lock; // Guards the queue and the current request against the async_tcp task
+#endif
+
+  AsyncWebServerRequest *_current = nullptr;     // Request run by the loop, cleared when its client disconnects
+  EspNodeAsyncClient _currentClient;
+  AsyncWebServerResponse *_response = nullptr;   // Response of the current request, sent once its handler returns
+  AsyncResponseStream *_responseStream = nullptr; // Same response, if it takes content
+  bool _responded = false;                       // Flag indicating the current request got its response
+  size_t _contentLength = CONTENT_LENGTH_NOT_SET;
+  String _headerNames[WEB_ASYNC_HEADER_CNT];
+  String _headerValues[WEB_ASYNC_HEADER_CNT];
+  uint8_t _headerCnt = 0;
+
+  void _lockQueue();
+  void _unlockQueue();
+  void _accept(AsyncWebServerRequest *request);
+  void _forget(AsyncWebServerRequest *request);
+  void _upload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final);
+  Route *_findRoute(AsyncWebServerRequest *request, bool upload);
+  void _startResponse(AsyncWebServerResponse *response, AsyncResponseStream *stream);
+  void _respond();
+};
+
+class EspNodeAsyncUpdateServer
+{
+public:
+  void setup(EspNodeAsyncWebServer *server, const String &path);
+  void setup(EspNodeAsyncWebServer *server, const String &path, const String &username, const String &password);
+  void handle();
+
+private:
+  EspNodeAsyncWebServer *_server;
+  String _username;
+  String _password;
+  bool _authenticated = false;     // Flag indicating the running upload passed the credential check
+  String _error;                   // Error of the running upload, empty if fine
+  unsigned long _restartMillis = 0; // Timestamp of the answered successful update, the node restarts shortly after
+
+  void _upload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final);
+  void _setError();
+};
+
+#endif
+
+#endif
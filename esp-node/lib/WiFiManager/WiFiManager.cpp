@@ -638,6 +638,10 @@ void WiFiManager::setupHTTPServer(){
   
   /* Setup httpd callbacks, web pages: root, wifi config pages, SO captive portal detectors and not found. */
 
+  // keep the etag revalidation header of the static assets
+  const char *headerKeys[] = {"If-None-Match"};
+  server->collectHeaders(headerKeys, 1);
+
   // G macro workaround for Uri() bug https://github.com/esp8266/Arduino/issues/7102
   server->on(WM_G(R_root),       std::bind(&WiFiManager::handleRoot, this));
   server->on(WM_G(R_wifi),       std::bind(&WiFiManager::handleWifi, this, true));
@@ -651,6 +655,8 @@ void WiFiManager::setupHTTPServer(){
   server->on(WM_G(R_close),      std::bind(&WiFiManager::handleClose, this));
   server->on(WM_G(R_erase),      std::bind(&WiFiManager::handleErase, this, false));
   server->on(WM_G(R_status),     std::bind(&WiFiManager::handleWiFiStatus, this));
+  server->on(WM_G(R_static_style),  std::bind(&WiFiManager::handleStatic, this, HTTP_STATIC_STYLE_GZ, sizeof(HTTP_STATIC_STYLE_GZ), HTTP_HEAD_CT_CSS, HTTP_STATIC_STYLE_ETAG));
+  server->on(WM_G(R_static_script), std::bind(&WiFiManager::handleStatic, this, HTTP_STATIC_SCRIPT_GZ, sizeof(HTTP_STATIC_SCRIPT_GZ), HTTP_HEAD_CT_JS, HTTP_STATIC_SCRIPT_ETAG));
   server->onNotFound (std::bind(&WiFiManager::handleNotFound, this));
   
   server->on(WM_G(R_update), std::bind(&WiFiManager::handleUpdate, this));
@@ -1273,8 +1279,7 @@ String WiFiManager::getHTTPHead(String title){
   String page;
   page += FPSTR(HTTP_HEAD_START);
   page.replace(FPSTR(T_v), title);
-  page += FPSTR(HTTP_SCRIPT);
-  page += FPSTR(HTTP_STYLE);
+  page += FPSTR(HTTP_HEAD_STATIC); // script and style are linked, served gzipped from /static/*
   page += _customHeadElement;
 
   if(_bodyClass != ""){
@@ -1320,6 +1325,25 @@ void WiFiManager::handleRequest() {
   }
 }
 
+/**
+ * HTTPD CALLBACK static assets, pre-gzipped in flash and cached by the browser for good
+ */
+void WiFiManager::handleStatic(const uint8_t *content, size_t size, PGM_P contentType, PGM_P etag) {
+  #ifdef WM_DEBUG_LEVEL
+  DEBUG_WM(DEBUG_VERBOSE,F("<- HTTP Static"),server->uri());
+  #endif
+  server->sendHeader(F("Cache-Control"), FPSTR(HTTP_HEAD_CACHE_IMMUTABLE)); // @HTTPHEAD send cache
+  server->sendHeader(F("ETag"), FPSTR(etag));
+
+  if(strcmp_P(server->header(F("If-None-Match")).c_str(), etag) == 0){
+    server->send(304);
+    return;
+  }
+
+  server->sendHeader(F("Content-Encoding"), F("gzip"));
+  server->send_P(200, contentType, (PGM_P)content, size);
+}
+
 /** 
  * HTTPD CALLBACK root or redirect to captive portal
  */
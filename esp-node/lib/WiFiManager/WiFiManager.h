@@ -609,6 +609,7 @@ class WiFiManager
     // webserver handlers
     void          HTTPSend(String content);
     void          handleRoot();
+    void          handleStatic(const uint8_t *content, size_t size, PGM_P contentType, PGM_P etag);
     void          handleWifi(boolean scan);
     void          handleWifiSave();
     void          handleInfo();
@@ -10,7 +10,7 @@ EspNode* espNode;
 
 void setup()
 {
-  espNode = new EspNode(fwName, fwVersion);
+  espNode = new EspNode(nodeName, fwName, fwVersion);
   espNode->setup();
 }
 
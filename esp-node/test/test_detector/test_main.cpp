@@ -0,0 +1,146 @@
+/**
+ * test_main.cpp
+ *
+ * Native test of EspNodeDetector::evaluate().
+ * <p>
+ * evaluate() gets the value and the time stamp from the test, so thresholds,
+ * hysteresis band and hold time are checked without a clock or a broker. Run
+ * with "pio test -e native".
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include <Arduino.h>
+#include <EspNodeDetector.h>
+#include <unity.h>
+
+const static unsigned long TEST_HOLD = 1000; // Hold time of the detectors under test in ms
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_detects_at_threshold()
+{
+  EspNodeDetector<uint32_t, 50> detector(500, TEST_HOLD);
+
+  TEST_ASSERT_FALSE(detector.evaluate(499, 0));
+  TEST_ASSERT_FALSE(detector.detected());
+  TEST_ASSERT_EQUAL_STRING(DETECTOR_PAYLOAD_NONE, detector.payload());
+
+  TEST_ASSERT_TRUE(detector.evaluate(500, 10));
+  TEST_ASSERT_TRUE(detector.detected());
+  TEST_ASSERT_EQUAL_STRING(DETECTOR_PAYLOAD_DETECTED, detector.payload());
+
+  // Staying above the threshold is no change
+  TEST_ASSERT_FALSE(detector.evaluate(800, 20));
+}
+
+void test_hysteresis_band_keeps_detection()
+{
+  EspNodeDetector<uint32_t, 50> detector(500, TEST_HOLD);
+  detector.evaluate(500, 0);
+
+  // Inside the band the detection is refreshed, the hold time never runs out
+  TEST_ASSERT_FALSE(detector.evaluate(450, 500));
+  TEST_ASSERT_FALSE(detector.evaluate(450, 1400));
+  TEST_ASSERT_FALSE(detector.evaluate(450, 2300));
+  TEST_ASSERT_TRUE(detector.detected());
+}
+
+void test_releases_below_hysteresis_band()
+{
+  EspNodeDetector<uint32_t, 50> detector(500, TEST_HOLD);
+  detector.evaluate(500, 0);
+
+  TEST_ASSERT_FALSE(detector.evaluate(449, 100));
+  TEST_ASSERT_TRUE(detector.detected());
+  TEST_ASSERT_TRUE(detector.evaluate(449, TEST_HOLD));
+  TEST_ASSERT_FALSE(detector.detected());
+
+  // Released, the band is gone and the full threshold applies again
+  TEST_ASSERT_FALSE(detector.evaluate(450, TEST_HOLD + 10));
+  TEST_ASSERT_TRUE(detector.evaluate(500, TEST_HOLD + 20));
+}
+
+void test_hold_time_suppresses_release()
+{
+  EspNodeDetector<uint32_t, 50> detector(500, TEST_HOLD);
+  detector.evaluate(600, 0);
+
+  // The hold time counts from the last value above the released threshold
+  TEST_ASSERT_FALSE(detector.evaluate(600, 500));
+  TEST_ASSERT_FALSE(detector.evaluate(0, 600));
+  TEST_ASSERT_FALSE(detector.evaluate(0, 500 + TEST_HOLD - 1));
+  TEST_ASSERT_TRUE(detector.detected());
+
+  TEST_ASSERT_TRUE(detector.evaluate(0, 500 + TEST_HOLD));
+  TEST_ASSERT_FALSE(detector.detected());
+  TEST_ASSERT_FALSE(detector.evaluate(0, 500 + 2 * TEST_HOLD));
+}
+
+void test_hold_time_across_millis_wrap()
+{
+  EspNodeDetector<uint32_t, 50> detector(500, TEST_HOLD);
+  unsigned long start = (unsigned long)-100;
+  detector.evaluate(600, start);
+
+  TEST_ASSERT_FALSE(detector.evaluate(0, start + TEST_HOLD - 1));
+  TEST_ASSERT_TRUE(detector.evaluate(0, start + TEST_HOLD));
+}
+
+void test_int16_detector()
+{
+  EspNodeDetector<int16_t, 1> detector(3, TEST_HOLD);
+
+  TEST_ASSERT_FALSE(detector.evaluate(-5, 0));
+  TEST_ASSERT_FALSE(detector.evaluate(2, 10));
+  TEST_ASSERT_TRUE(detector.evaluate(3, 20));
+
+  // 2 is inside the band of 1, 1 is below it
+  TEST_ASSERT_FALSE(detector.evaluate(2, 30 + TEST_HOLD));
+  TEST_ASSERT_FALSE(detector.evaluate(1, 40 + TEST_HOLD));
+  TEST_ASSERT_TRUE(detector.evaluate(1, 30 + 2 * TEST_HOLD));
+  TEST_ASSERT_FALSE(detector.detected());
+}
+
+void test_threshold_within_hysteresis_releases()
+{
+  // A threshold not above the band would never release, the band is skipped then
+  EspNodeDetector<int16_t, 1> detector(1, TEST_HOLD);
+
+  TEST_ASSERT_TRUE(detector.evaluate(1, 0));
+  TEST_ASSERT_FALSE(detector.evaluate(0, 10));
+  TEST_ASSERT_TRUE(detector.evaluate(0, 10 + TEST_HOLD));
+}
+
+void test_set_threshold_and_hold()
+{
+  EspNodeDetector<uint32_t, 50> detector(500, TEST_HOLD);
+  detector.setThreshold(200);
+  detector.setHoldMillis(0);
+
+  TEST_ASSERT_TRUE(detector.evaluate(200, 0));
+  TEST_ASSERT_TRUE(detector.evaluate(149, 1));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_detects_at_threshold);
+  RUN_TEST(test_hysteresis_band_keeps_detection);
+  RUN_TEST(test_releases_below_hysteresis_band);
+  RUN_TEST(test_hold_time_suppresses_release);
+  RUN_TEST(test_hold_time_across_millis_wrap);
+  RUN_TEST(test_int16_detector);
+  RUN_TEST(test_threshold_within_hysteresis_releases);
+  RUN_TEST(test_set_threshold_and_hold);
+  return UNITY_END();
+}
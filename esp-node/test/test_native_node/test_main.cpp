@@ -0,0 +1,129 @@
+/**
+ * test_main.cpp
+ *
+ * Native test of EspNode::setup()/loop() against the host shim.
+ * <p>
+ * Runs one node in the process, as on the device. The SPIFFS root lives in
+ * .pio, so every run starts without a stored configuration. The in-process
+ * MQTT stand-in delivers messages published to a subscribed topic back to the
+ * node, which is used to check the command dispatch and the delivery of long
+ * payloads. Run with "pio test -e native".
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include <Arduino.h>
+#include <EspNode.h>
+#include <unity.h>
+
+const static unsigned long TEST_TIMEOUT = 2000;       // Max. time the node gets to reach a state in ms
+const static unsigned long TEST_STEADY_LOOPS = 10000; // loop() passes of the steady state check
+
+char fwName[16] = "test_fw";
+char fwVersion[8] = "47.11";
+char nodeName[32] = "test_node";
+
+EspNode *espNode;
+
+String testPayload;
+int testCmdCnt = 0;
+
+// Runs loop() until the condition holds or the timeout passed, returns the condition
+bool testLoopUntil(std::function<bool(void)> condition)
+{
+  unsigned long start = millis();
+  while (!condition() && millis() - start < TEST_TIMEOUT)
+  {
+    espNode->loop();
+  }
+  return condition();
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_setup_connects_and_publishes_availability()
+{
+  TEST_ASSERT_TRUE(espNode->wifiIsConnected());
+
+  unsigned long publishes = nativeStats.mqttPublishes;
+  TEST_ASSERT_TRUE(testLoopUntil([publishes]()
+                                 { return nativeStats.mqttPublishes > publishes; }));
+}
+
+void test_loop_dispatches_node_command()
+{
+  const char *cmdTopic = espNode->mqttOnCommand("test", [](String &payload)
+                                                {
+                                                  testPayload = payload;
+                                                  testCmdCnt++;
+                                                });
+  TEST_ASSERT_NOT_NULL(cmdTopic);
+  TEST_ASSERT_EQUAL_STRING(espNode->mqttGetNodeCmdTopic("test").c_str(), cmdTopic);
+
+  // The stand-in delivers the node's own publish on its subscribed command topic
+  TEST_ASSERT_TRUE(espNode->mqttSend(cmdTopic, "on"));
+  TEST_ASSERT_TRUE(testLoopUntil([]()
+                                 { return testCmdCnt > 0; }));
+  TEST_ASSERT_EQUAL(1, testCmdCnt);
+  TEST_ASSERT_EQUAL_STRING("on", testPayload.c_str());
+}
+
+void test_loop_sends_long_payloads()
+{
+  const char *cmdTopic = espNode->mqttInternNodeCmdTopic("test");
+
+  // Up to the size of a button command fits the queue, larger payloads bypass it
+  size_t lengths[] = {MQTT_QUEUE_PAYLOAD_SIZE - 1, MQTT_QUEUE_PAYLOAD_SIZE, 1000};
+  for (size_t length : lengths)
+  {
+    String payload;
+    for (size_t i = 0; i < length; i++)
+    {
+      payload += (char)('a' + i % 26);
+    }
+
+    int cmdCnt = testCmdCnt;
+    TEST_ASSERT_TRUE(espNode->mqttSendEvent(cmdTopic, payload.c_str()));
+    TEST_ASSERT_TRUE(testLoopUntil([cmdCnt]()
+                                   { return testCmdCnt > cmdCnt; }));
+    TEST_ASSERT_EQUAL_STRING(payload.c_str(), testPayload.c_str());
+  }
+}
+
+void test_loop_keeps_heap_steady()
+{
+  // Let the connect time tasks settle before measuring
+  testLoopUntil([]()
+                { return false; });
+
+  long heapInUse = nativeStats.heapInUse;
+  for (unsigned long pass = 0; pass < TEST_STEADY_LOOPS; pass++)
+  {
+    espNode->loop();
+  }
+  TEST_ASSERT_EQUAL(heapInUse, nativeStats.heapInUse);
+}
+
+int main(int argc, char **argv)
+{
+  setenv("ESPNODE_NATIVE_FS", ".pio/test_spiffs", 1);
+
+  espNode = new EspNode(nodeName, fwName, fwVersion);
+  espNode->setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_setup_connects_and_publishes_availability);
+  RUN_TEST(test_loop_dispatches_node_command);
+  RUN_TEST(test_loop_sends_long_payloads);
+  RUN_TEST(test_loop_keeps_heap_steady);
+  return UNITY_END();
+}
@@ -0,0 +1,162 @@
+/**
+ * test_main.cpp
+ *
+ * Native test of EspNodeTelemetry::evaluate().
+ * <p>
+ * evaluate() gets the value and the time stamp from the test, so deadband,
+ * min. interval and heartbeat are checked without a clock or a broker. Run
+ * with "pio test -e native".
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include <Arduino.h>
+#include <EspNodeTelemetry.h>
+#include <unity.h>
+
+const static unsigned long TEST_MIN_INTERVAL = 5000; // Min. interval of the publishers under test in ms
+const static unsigned long TEST_HEARTBEAT = 60000;   // Heartbeat of the publishers under test in ms
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_first_value_publishes()
+{
+  EspNodeTelemetry telemetry(2, 0, TEST_MIN_INTERVAL, TEST_HEARTBEAT);
+
+  TEST_ASSERT_TRUE(telemetry.evaluate(50, 0));
+  TEST_ASSERT_EQUAL_FLOAT(50, telemetry.published());
+}
+
+void test_absolute_deadband()
+{
+  EspNodeTelemetry telemetry(2, 0, 0, 0);
+  telemetry.evaluate(50, 0);
+
+  // The band is exclusive and measured from the published value, not the last one
+  TEST_ASSERT_FALSE(telemetry.evaluate(52, 1));
+  TEST_ASSERT_FALSE(telemetry.evaluate(48, 2));
+  TEST_ASSERT_TRUE(telemetry.evaluate(47.5, 3));
+  TEST_ASSERT_EQUAL_FLOAT(47.5, telemetry.published());
+  TEST_ASSERT_TRUE(telemetry.evaluate(50, 4));
+}
+
+void test_relative_deadband()
+{
+  EspNodeTelemetry telemetry(0, 0.1, 0, 0);
+  telemetry.evaluate(100, 0);
+
+  TEST_ASSERT_FALSE(telemetry.evaluate(109, 1));
+  TEST_ASSERT_FALSE(telemetry.evaluate(91, 2));
+  TEST_ASSERT_TRUE(telemetry.evaluate(111, 3));
+
+  // The band follows the published value, 10% of 111
+  TEST_ASSERT_FALSE(telemetry.evaluate(122, 4));
+  TEST_ASSERT_TRUE(telemetry.evaluate(122.2, 5));
+}
+
+void test_larger_deadband_applies()
+{
+  // Absolute 5 against 10%: near 0 the absolute band is the larger one, at 100 the relative one
+  EspNodeTelemetry telemetry(5, 0.1, 0, 0);
+
+  telemetry.evaluate(10, 0);
+  TEST_ASSERT_FALSE(telemetry.evaluate(15, 1));
+  TEST_ASSERT_TRUE(telemetry.evaluate(15.5, 2));
+
+  telemetry.evaluate(100, 3);
+  TEST_ASSERT_FALSE(telemetry.evaluate(106, 4));
+  TEST_ASSERT_FALSE(telemetry.evaluate(90, 5));
+  TEST_ASSERT_TRUE(telemetry.evaluate(111, 6));
+
+  // Negative values use the magnitude of the published value
+  telemetry.evaluate(-100, 7);
+  TEST_ASSERT_FALSE(telemetry.evaluate(-91, 8));
+  TEST_ASSERT_TRUE(telemetry.evaluate(-89, 9));
+}
+
+void test_min_interval_holds_back_change()
+{
+  EspNodeTelemetry telemetry(2, 0, TEST_MIN_INTERVAL, TEST_HEARTBEAT);
+  telemetry.evaluate(50, 0);
+
+  TEST_ASSERT_FALSE(telemetry.evaluate(60, 1000));
+  TEST_ASSERT_FALSE(telemetry.evaluate(60, TEST_MIN_INTERVAL - 1));
+  TEST_ASSERT_EQUAL_FLOAT(60, telemetry.value());
+  TEST_ASSERT_EQUAL_FLOAT(50, telemetry.published());
+
+  // Published with the first value once the interval is over
+  TEST_ASSERT_TRUE(telemetry.evaluate(60, TEST_MIN_INTERVAL));
+  TEST_ASSERT_EQUAL_FLOAT(60, telemetry.published());
+}
+
+void test_min_interval_drops_settled_change()
+{
+  EspNodeTelemetry telemetry(2, 0, TEST_MIN_INTERVAL, TEST_HEARTBEAT);
+  telemetry.evaluate(50, 0);
+
+  // A spike within the interval that settled back is not published
+  TEST_ASSERT_FALSE(telemetry.evaluate(60, 1000));
+  TEST_ASSERT_FALSE(telemetry.evaluate(51, TEST_MIN_INTERVAL));
+  TEST_ASSERT_EQUAL_FLOAT(50, telemetry.published());
+}
+
+void test_heartbeat_republishes()
+{
+  EspNodeTelemetry telemetry(2, 0, TEST_MIN_INTERVAL, TEST_HEARTBEAT);
+  telemetry.evaluate(50, 0);
+
+  TEST_ASSERT_FALSE(telemetry.evaluate(51, TEST_HEARTBEAT - 1));
+  TEST_ASSERT_TRUE(telemetry.evaluate(51, TEST_HEARTBEAT));
+  TEST_ASSERT_EQUAL_FLOAT(51, telemetry.published());
+
+  // The heartbeat restarts with each publish
+  TEST_ASSERT_FALSE(telemetry.evaluate(51, 2 * TEST_HEARTBEAT - 1));
+  TEST_ASSERT_TRUE(telemetry.evaluate(51, 2 * TEST_HEARTBEAT));
+}
+
+void test_without_heartbeat()
+{
+  EspNodeTelemetry telemetry(2, 0, TEST_MIN_INTERVAL, 0);
+  telemetry.evaluate(50, 0);
+
+  TEST_ASSERT_FALSE(telemetry.evaluate(50, 100 * TEST_HEARTBEAT));
+}
+
+void test_millis_wrap()
+{
+  EspNodeTelemetry telemetry(2, 0, TEST_MIN_INTERVAL, TEST_HEARTBEAT);
+  unsigned long start = (unsigned long)-1000;
+  telemetry.evaluate(50, start);
+
+  // The interval and the heartbeat run across the wrap of millis()
+  TEST_ASSERT_FALSE(telemetry.evaluate(60, start + TEST_MIN_INTERVAL - 1));
+  TEST_ASSERT_TRUE(telemetry.evaluate(60, start + TEST_MIN_INTERVAL));
+
+  start += TEST_MIN_INTERVAL;
+  TEST_ASSERT_FALSE(telemetry.evaluate(60, start + TEST_HEARTBEAT - 1));
+  TEST_ASSERT_TRUE(telemetry.evaluate(60, start + TEST_HEARTBEAT));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_first_value_publishes);
+  RUN_TEST(test_absolute_deadband);
+  RUN_TEST(test_relative_deadband);
+  RUN_TEST(test_larger_deadband_applies);
+  RUN_TEST(test_min_interval_holds_back_change);
+  RUN_TEST(test_min_interval_drops_settled_change);
+  RUN_TEST(test_heartbeat_republishes);
+  RUN_TEST(test_without_heartbeat);
+  RUN_TEST(test_millis_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,137 @@
+/**
+ * MqPpmBench.cpp
+ *
+ * Accuracy check and benchmark of the MQ PPM table, built by env:native_bench.
+ * <p>
+ * Calibrates the MQ2 model of the node at a few clean air ADC values, so R0
+ * covers sensors from sensitive to dull. For each R0 the table is compared
+ * with MQUnifiedsensor::readSensor() over the whole positive ADC range:
+ * relative error from BENCH_REL_MIN_PPM to BENCH_MAX_PPM, absolute error
+ * below, where the integer result rounds. Then both paths are timed over the ADC range with
+ * ESP.getCycleCount(). On the host the shim derives the cycles from micros()
+ * and the FPU makes pow() cheap, the cycles of the ESP8266 come from a run
+ * of env:d1_mini_bench on the board. Run with ESPNODE_NATIVE_LOOPS=1.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include <Arduino.h>
+#include <MQUnifiedsensor.h>
+#include "MqPpmTable.h"
+
+// Same sensor setup as multiSetup() in main.cpp
+#define BENCH_MQ_VOLTAGE 5
+#define BENCH_MQ_RES 16
+#define BENCH_MQ_A 30000000
+#define BENCH_MQ_B (-8.308)
+#define BENCH_MQ_RATIO_CLEANAIR (9.83)
+
+const static int BENCH_ADC_MAX = 32767;      // Highest single ended value of the ADS1115
+const static int BENCH_PASSES = 32768;       // Calls per timing, one sweep of the ADC range stays below the watchdog of the ESP8266
+const static int BENCH_REL_MIN_PPM = 100;    // PPM from which the relative error is checked, below the integer rounding dominates
+const float BENCH_MAX_PPM = 1000000;         // PPM up to which the table is checked, far beyond the MQ2's range of 10000 ppm
+const float BENCH_MAX_REL_ERROR = 0.01;      // Accepted relative error, 1%
+const float BENCH_MAX_ABS_ERROR = 1.0;       // Accepted absolute error below BENCH_REL_MIN_PPM
+
+const int16_t benchCleanAirAdc[] = {1000, 4000, 12000, 24000};
+
+MQUnifiedsensor benchSensor("ESP8266", BENCH_MQ_VOLTAGE, BENCH_MQ_RES, -1, "MQ2/ADS1115");
+MqPpmTable benchTable;
+
+volatile uint32_t benchSink = 0; // Keeps the timed calls from being optimized away
+
+bool benchAccuracy(int16_t cleanAirAdc)
+{
+  benchSensor.setADC(cleanAirAdc);
+  benchSensor.setR0(benchSensor.calibrate(BENCH_MQ_RATIO_CLEANAIR));
+  benchTable.begin(BENCH_MQ_A, BENCH_MQ_B, benchSensor.getR0(), benchSensor.getRL(), BENCH_MQ_RES);
+
+  float maxRelError = 0;
+  float maxAbsError = 0;
+  int16_t maxRelAdc = 0;
+  for (int adc = 1; adc <= BENCH_ADC_MAX; adc++)
+  {
+    if ((adc & 0x3ff) == 0)
+    {
+      yield();
+    }
+
+    benchSensor.setADC(adc);
+    float expected = benchSensor.readSensor();
+    float actual = benchTable.ppm(adc);
+
+    // Towards MQ_PPM_LOG2_MAX the table bends into its cap
+    if (expected > BENCH_MAX_PPM)
+    {
+      continue;
+    }
+
+    if (expected >= BENCH_REL_MIN_PPM)
+    {
+      float relError = fabsf(actual - expected) / expected;
+      if (relError > maxRelError)
+      {
+        maxRelError = relError;
+        maxRelAdc = adc;
+      }
+    }
+    else
+    {
+      maxAbsError = max(maxAbsError, fabsf(actual - expected));
+    }
+  }
+
+  bool passed = (maxRelError <= BENCH_MAX_REL_ERROR && maxAbsError <= BENCH_MAX_ABS_ERROR);
+  Serial.printf("BENCH: cleanAirAdc=%d R0=%.3f maxRelError=%.4f%% (adc %d) maxAbsError=%.3fppm %s\n",
+                cleanAirAdc, benchSensor.getR0(), maxRelError * 100, maxRelAdc, maxAbsError,
+                passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+void benchTiming()
+{
+  uint32_t start = ESP.getCycleCount();
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    benchSensor.setADC(pass & BENCH_ADC_MAX);
+    benchSink += (uint32_t)benchSensor.readSensor();
+  }
+  uint32_t floatCycles = ESP.getCycleCount() - start;
+  yield();
+
+  start = ESP.getCycleCount();
+  for (int pass = 0; pass < BENCH_PASSES; pass++)
+  {
+    benchSink += benchTable.ppm(pass & BENCH_ADC_MAX);
+  }
+  uint32_t tableCycles = ESP.getCycleCount() - start;
+
+  Serial.printf("BENCH: readSensor=%.1fcycles/call table=%.1fcycles/call tableSize=%uB\n",
+                (float)floatCycles / BENCH_PASSES, (float)tableCycles / BENCH_PASSES, (unsigned)sizeof(benchTable));
+}
+
+void setup()
+{
+  Serial.begin(115200);
+
+  benchSensor.setRegressionMethod(1);
+  benchSensor.setA(BENCH_MQ_A);
+  benchSensor.setB(BENCH_MQ_B);
+  benchSensor.init();
+
+  bool passed = true;
+  for (int16_t cleanAirAdc : benchCleanAirAdc)
+  {
+    passed &= benchAccuracy(cleanAirAdc);
+  }
+  benchTiming();
+
+  Serial.printf("BENCH: %s\n", passed ? "PASS" : "FAIL");
+}
+
+void loop()
+{
+}
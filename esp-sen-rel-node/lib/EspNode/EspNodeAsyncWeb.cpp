@@ -0,0 +1,557 @@
+/**
+ * EspNodeAsyncWeb.cpp
+ *
+ * Optional asynchronous web backend of EspNode, built with -D ESPNODE_WEB_ASYNC.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifdef ESPNODE_WEB_ASYNC
+
+#include "EspNodeAsyncWeb.h"
+
+#include <StreamString.h>
+#ifdef ESP8266
+#include <Updater.h>
+#elif ESP32
+#include <Update.h>
+#endif
+
+const char HTML_ASYNC_UPDATE_FORM[] PROGMEM = "<html><body><form method='POST' action='' enctype='multipart/form-data'><input type='file' accept='.bin,.bin.gz' name='firmware'><input type='submit' value='Update Firmware'></form></body></html>";
+const char HTML_ASYNC_UPDATE_SUCCESS[] PROGMEM = "<META http-equiv=\"refresh\" content=\"15;URL=/\">Update Success! Rebooting...";
+const unsigned long WEB_ASYNC_UPDATE_RESTART_DELAY = 1000; // Time given to the update response before the restart in ms
+
+EspNodeAsyncHandler::EspNodeAsyncHandler(EspNodeAsyncWebServer *server) : _server(server)
+{
+}
+
+bool EspNodeAsyncHandler::canHandle(AsyncWebServerRequest *request)
+{
+  // Keep every header, handlers read them later from the loop
+  request->addInterestingHeader(String(F("ANY")));
+  return true;
+}
+
+void EspNodeAsyncHandler::handleRequest(AsyncWebServerRequest *request)
+{
+  _server->_accept(request);
+}
+
+void EspNodeAsyncHandler::handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)
+{
+  _server->_upload(request, filename, index, data, len, final);
+}
+
+bool EspNodeAsyncHandler::isRequestHandlerTrivial()
+{
+  // Have the body parsed, forms post their values
+  return false;
+}
+
+IPAddress EspNodeAsyncClient::remoteIP() const
+{
+  return _remoteIP;
+}
+
+EspNodeAsyncWebServer::EspNodeAsyncWebServer(int port) : _server(port)
+{
+#ifdef ESP32
+  _lock = xSemaphoreCreateMutex();
+#endif
+}
+
+EspNodeAsyncWebServer::~EspNodeAsyncWebServer()
+{
+  for (int i = 0; i < _routeCnt; i++)
+  {
+    delete _routes[i].uri;
+  }
+}
+
+void EspNodeAsyncWebServer::begin()
+{
+  // One handler takes every request, the server deletes it
+  _server.addHandler(new EspNodeAsyncHandler(this));
+  _server.begin();
+}
+
+void EspNodeAsyncWebServer::handleClient()
+{
+  _lockQueue();
+
+  // Take the oldest request still connected, one per pass keeps the loop short
+  _current = nullptr;
+  while (_queueCnt > 0 && _current == nullptr)
+  {
+    _current = _queue[_queueHead];
+    _queueHead = (_queueHead + 1) % WEB_ASYNC_CONN_CNT;
+    _queueCnt--;
+  }
+
+  if (_current == nullptr)
+  {
+    _unlockQueue();
+    return;
+  }
+
+  _currentClient._remoteIP = _current->client()->remoteIP();
+  _response = nullptr;
+  _responseStream = nullptr;
+  _responded = false;
+  _contentLength = CONTENT_LENGTH_NOT_SET;
+  _headerCnt = 0;
+
+  Route *route = _findRoute(_current, false);
+  if (route != nullptr)
+  {
+    route->handler();
+  }
+  else if (_notFoundHandler)
+  {
+    _notFoundHandler();
+  }
+  else
+  {
+    send(404, "text/plain", String(F("Not found")));
+  }
+
+  // Hand the response to the TCP stack, a handler without one gets an error so the connection is closed
+  if (_current != nullptr && !_responded && _response == nullptr)
+  {
+    send(500);
+  }
+  _respond();
+  _current = nullptr;
+
+  _unlockQueue();
+}
+
+void EspNodeAsyncWebServer::on(const Uri &uri, THandlerFunction handler)
+{
+  on(uri, HTTP_ANY, handler);
+}
+
+void EspNodeAsyncWebServer::on(const Uri &uri, WebRequestMethodComposite method, THandlerFunction handler)
+{
+  if (_routeCnt >= WEB_ASYNC_ROUTE_CNT)
+  {
+    return;
+  }
+
+  _routes[_routeCnt++] = {uri.clone(), method, handler, nullptr};
+}
+
+void EspNodeAsyncWebServer::onUpload(const Uri &uri, EspNodeAsyncUploadHandler handler)
+{
+  if (_routeCnt >= WEB_ASYNC_ROUTE_CNT)
+  {
+    return;
+  }
+
+  _routes[_routeCnt++] = {uri.clone(), HTTP_POST, nullptr, handler};
+}
+
+void EspNodeAsyncWebServer::onNotFound(THandlerFunction handler)
+{
+  _notFoundHandler = handler;
+}
+
+void EspNodeAsyncWebServer::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+  // Nothing to do, all headers are kept
+}
+
+void EspNodeAsyncWebServer::onEvents(const String &path, const String &username, const String &password, size_t maxClients)
+{
+  _events = new AsyncEventSource(path);
+  if (password.length() > 0)
+  {
+    _events->setAuthentication(username.c_str(), password.c_str());
+  }
+
+  // Closed right away beyond the limit, the browser retries later
+  _events->onConnect([this, maxClients](AsyncEventSourceClient *client)
+                     {
+                       if (_events->count() > maxClients)
+                       {
+                         client->close();
+                       } });
+
+  // Ahead of the queueing handler, which takes every request
+  _server.addHandler(_events);
+}
+
+void EspNodeAsyncWebServer::sendEvent(const char *event, const char *data)
+{
+  if (_events != nullptr)
+  {
+    _events->send(data, event);
+  }
+}
+
+size_t EspNodeAsyncWebServer::eventClientCnt()
+{
+  return (_events != nullptr) ? _events->count() : 0;
+}
+
+bool EspNodeAsyncWebServer::authenticate(const char *username, const char *password)
+{
+  return (_current != nullptr) && _current->authenticate(username, password);
+}
+
+void EspNodeAsyncWebServer::requestAuthentication()
+{
+  if (_current == nullptr || _responded || _response != nullptr)
+  {
+    return;
+  }
+
+  // Basic auth like the synchronous server, the request answers right away
+  _current->requestAuthentication(nullptr, false);
+  _responded = true;
+}
+
+String EspNodeAsyncWebServer::uri()
+{
+  return (_current != nullptr) ? _current->url() : String();
+}
+
+WebRequestMethodComposite EspNodeAsyncWebServer::method()
+{
+  return (_current != nullptr) ? _current->method() : HTTP_GET;
+}
+
+EspNodeAsyncClient &EspNodeAsyncWebServer::client()
+{
+  return _currentClient;
+}
+
+String EspNodeAsyncWebServer::arg(const String &name)
+{
+  return (_current != nullptr) ? _current->arg(name) : String();
+}
+
+String EspNodeAsyncWebServer::arg(int i)
+{
+  return (_current != nullptr) ? _current->arg((size_t)i) : String();
+}
+
+String EspNodeAsyncWebServer::argName(int i)
+{
+  return (_current != nullptr) ? _current->argName((size_t)i) : String();
+}
+
+int EspNodeAsyncWebServer::args()
+{
+  return (_current != nullptr) ? (int)_current->args() : 0;
+}
+
+bool EspNodeAsyncWebServer::hasArg(const String &name)
+{
+  return (_current != nullptr) && _current->hasArg(name.c_str());
+}
+
+String EspNodeAsyncWebServer::header(const String &name)
+{
+  return (_current != nullptr) ? _current->header(name.c_str()) : String();
+}
+
+void EspNodeAsyncWebServer::setContentLength(size_t contentLength)
+{
+  _contentLength = contentLength;
+}
+
+void EspNodeAsyncWebServer::sendHeader(const String &name, const String &value, bool first)
+{
+  // Headers set before send() are held back until the response exists
+  if (_response != nullptr)
+  {
+    _response->addHeader(name, value);
+  }
+  else if (_headerCnt < WEB_ASYNC_HEADER_CNT)
+  {
+    _headerNames[_headerCnt] = name;
+    _headerValues[_headerCnt] = value;
+    _headerCnt++;
+  }
+}
+
+void EspNodeAsyncWebServer::send(int code, const char *contentType, const String &content)
+{
+  if (_current == nullptr || _responded || _response != nullptr)
+  {
+    return;
+  }
+
+  // The stream collects what the handler sends, the TCP stack drains it at the client's pace
+  AsyncResponseStream *stream = _current->beginResponseStream((contentType != nullptr) ? String(contentType) : String(F("text/html")));
+  stream->setCode(code);
+  _startResponse(stream, stream);
+
+  if (content.length() > 0)
+  {
+    stream->print(content);
+  }
+}
+
+void EspNodeAsyncWebServer::send(int code, const String &contentType, const String &content)
+{
+  send(code, contentType.c_str(), content);
+}
+
+void EspNodeAsyncWebServer::send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength)
+{
+  if (_current == nullptr || _responded || _response != nullptr)
+  {
+    return;
+  }
+
+  // Sent straight from flash, nothing is copied
+  _startResponse(_current->beginResponse_P(code, String(FPSTR(contentType)), (const uint8_t *)content, contentLength), nullptr);
+}
+
+void EspNodeAsyncWebServer::sendContent(const String &content)
+{
+  sendContent(content.c_str(), content.length());
+}
+
+void EspNodeAsyncWebServer::sendContent(const char *content, size_t contentLength)
+{
+  if (contentLength == 0)
+  {
+    // The empty chunk ends a chunked response, send it now in case the handler goes on with something slow
+    if (_contentLength == CONTENT_LENGTH_UNKNOWN)
+    {
+      _respond();
+    }
+    return;
+  }
+
+  if (_responseStream != nullptr)
+  {
+    _responseStream->write((const uint8_t *)content, contentLength);
+  }
+}
+
+void EspNodeAsyncWebServer::_lockQueue()
+{
+#ifdef ESP32
+  xSemaphoreTake(_lock, portMAX_DELAY);
+#endif
+}
+
+void EspNodeAsyncWebServer::_unlockQueue()
+{
+#ifdef ESP32
+  xSemaphoreGive(_lock);
+#endif
+}
+
+void EspNodeAsyncWebServer::_accept(AsyncWebServerRequest *request)
+{
+  _lockQueue();
+
+  if (_connCnt >= WEB_ASYNC_CONN_CNT)
+  {
+    _unlockQueue();
+    request->send(503);
+    return;
+  }
+
+  // The request is deleted with its client, drop it from the queue then
+  request->onDisconnect([this, request]()
+                        { this->_forget(request); });
+
+  _queue[(_queueHead + _queueCnt) % WEB_ASYNC_CONN_CNT] = request;
+  _queueCnt++;
+  _connCnt++;
+
+  _unlockQueue();
+}
+
+void EspNodeAsyncWebServer::_forget(AsyncWebServerRequest *request)
+{
+  _lockQueue();
+
+  for (int i = 0; i < _queueCnt; i++)
+  {
+    int index = (_queueHead + i) % WEB_ASYNC_CONN_CNT;
+    if (_queue[index] == request)
+    {
+      _queue[index] = nullptr;
+    }
+  }
+
+  if (_current == request)
+  {
+    _current = nullptr;
+  }
+
+  _connCnt--;
+
+  _unlockQueue();
+}
+
+void EspNodeAsyncWebServer::_upload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)
+{
+  Route *route = _findRoute(request, true);
+  if (route != nullptr)
+  {
+    route->upload(request, filename, index, data, len, final);
+  }
+}
+
+EspNodeAsyncWebServer::Route *EspNodeAsyncWebServer::_findRoute(AsyncWebServerRequest *request, bool upload)
+{
+  std::vector<String> pathArgs;
+
+  for (int i = 0; i < _routeCnt; i++)
+  {
+    Route &route = _routes[i];
+    if ((route.method & request->method()) && route.uri->canHandle(request->url(), pathArgs))
+    {
+      // Upload and page handler of one uri are registered separately
+      if (upload ? (route.upload != nullptr) : (route.handler != nullptr))
+      {
+        return &route;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+void EspNodeAsyncWebServer::_startResponse(AsyncWebServerResponse *response, AsyncResponseStream *stream)
+{
+  _response = response;
+  _responseStream = stream;
+
+  for (int i = 0; i < _headerCnt; i++)
+  {
+    _response->addHeader(_headerNames[i], _headerValues[i]);
+  }
+  _headerCnt = 0;
+}
+
+void EspNodeAsyncWebServer::_respond()
+{
+  if (_response == nullptr || _responded)
+  {
+    return;
+  }
+
+  if (_current != nullptr)
+  {
+    _current->send(_response);
+  }
+  else
+  {
+    // The client is gone, nobody takes the response
+    delete _response;
+  }
+
+  _response = nullptr;
+  _responseStream = nullptr;
+  _responded = true;
+}
+
+void EspNodeAsyncUpdateServer::setup(EspNodeAsyncWebServer *server, const String &path)
+{
+  setup(server, path, String(), String());
+}
+
+void EspNodeAsyncUpdateServer::setup(EspNodeAsyncWebServer *server, const String &path, const String &username, const String &password)
+{
+  _server = server;
+  _username = username;
+  _password = password;
+
+  // The firmware is written as it arrives, the loop only answers the finished upload
+  _server->onUpload(path, [this](AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)
+                    { this->_upload(request, filename, index, data, len, final); });
+
+  _server->on(path, HTTP_GET, [this]()
+              {
+                if (_username.length() > 0 && !_server->authenticate(_username.c_str(), _password.c_str()))
+                {
+                  return _server->requestAuthentication();
+                }
+                _server->send_P(200, PSTR("text/html"), HTML_ASYNC_UPDATE_FORM, strlen_P(HTML_ASYNC_UPDATE_FORM)); });
+
+  _server->on(path, HTTP_POST, [this]()
+              {
+                if (!_authenticated)
+                {
+                  return _server->requestAuthentication();
+                }
+
+                if (_error.length() > 0)
+                {
+                  _server->send(200, String(F("text/html")), String(F("Update error: ")) + _error);
+                  return;
+                }
+
+                _server->sendHeader(String(F("Connection")), String(F("close")));
+                _server->send_P(200, PSTR("text/html"), HTML_ASYNC_UPDATE_SUCCESS, strlen_P(HTML_ASYNC_UPDATE_SUCCESS));
+                _restartMillis = millis() | 1; });
+}
+
+void EspNodeAsyncUpdateServer::handle()
+{
+  // Restart from the loop once the success page had time to go out
+  if (_restartMillis != 0 && (millis() - _restartMillis) >= WEB_ASYNC_UPDATE_RESTART_DELAY)
+  {
+    ESP.restart();
+  }
+}
+
+void EspNodeAsyncUpdateServer::_upload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)
+{
+  if (index == 0)
+  {
+    _authenticated = (_username.length() == 0) || request->authenticate(_username.c_str(), _password.c_str());
+    if (!_authenticated)
+    {
+      return;
+    }
+
+    _error = String();
+#ifdef ESP8266
+    // Runs in the TCP callback, the updater must not yield
+    Update.runAsync(true);
+    uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    if (!Update.begin(maxSketchSpace, U_FLASH))
+#elif ESP32
+    if (!Update.begin(UPDATE_SIZE_UNKNOWN))
+#endif
+    {
+      _setError();
+    }
+  }
+
+  if (!_authenticated || _error.length() > 0)
+  {
+    return;
+  }
+
+  if (len > 0 && Update.write(data, len) != len)
+  {
+    _setError();
+  }
+  else if (final && !Update.end(true))
+  {
+    _setError();
+  }
+}
+
+void EspNodeAsyncUpdateServer::_setError()
+{
+  StreamString error;
+  Update.printError(error);
+  _error = error;
+}
+
+#endif
@@ -0,0 +1,28 @@
+/**
+ * EspNodePortal.cpp
+ *
+ * WiFi connection and config portal of EspNode, backed by WiFiManager.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "EspNodePortal.h"
+
+#include <WiFiManager.h>
+
+void espNodePortalConnect(const char *apName, unsigned long connectTimeout, unsigned long portalTimeout)
+{
+  WiFiManager wifiManager;
+  wifiManager.setConnectTimeout(connectTimeout);
+  wifiManager.setConfigPortalTimeout(portalTimeout);
+  wifiManager.autoConnect(apName);
+}
+
+void espNodePortalReset()
+{
+  WiFiManager wifiManager;
+  wifiManager.resetSettings();
+}
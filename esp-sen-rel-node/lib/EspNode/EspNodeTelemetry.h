@@ -0,0 +1,63 @@
+/**
+ * EspNodeTelemetry.h
+ *
+ * Deadband publisher of analog telemetry values for EspNode sensors.
+ * <p>
+ * A value is published when it moved away from the last published value by
+ * more than the deadband, the larger one of an absolute band and a band
+ * relative to the published value. Publishes are at least the min. interval
+ * apart, a change within it is published once the interval is over, if it
+ * still exceeds the deadband. Without a change the value is published again
+ * after the heartbeat interval, so consumers can tell a steady value from a
+ * lost node. Broker load then follows real changes instead of sensor noise.
+ * <p>
+ * evaluate() only works on the given value and time stamp, it neither reads
+ * the clock nor publishes, so it runs on the host as is.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef EspNodeTelemetry_h
+#define EspNodeTelemetry_h
+
+#include "EspNode.h"
+
+const static int TELEMETRY_PAYLOAD_SIZE = 16; // Max size of a formatted value, including termination
+
+class EspNodeTelemetry
+{
+public:
+  EspNodeTelemetry(float absDeadband, float relDeadband, unsigned long minIntervalMillis, unsigned long heartbeatMillis, uint8_t decimals = 0);
+
+  void begin(EspNode *node, const char *subTopic);
+
+  bool evaluate(float value, unsigned long now);
+  bool update(float value);
+  void publish();
+
+  float value() const { return _value; }
+  float published() const { return _published; }
+
+private:
+  float _absDeadband;               // Absolute change needed to publish
+  float _relDeadband;               // Change relative to the published value needed to publish
+  unsigned long _minIntervalMillis; // Min. time between two publishes
+  unsigned long _heartbeatMillis;   // Max. time without a publish, 0 publishes changes only
+  uint8_t _decimals;                // Decimals of the published payload
+
+  EspNode *_node = nullptr;
+  const char *_topic = nullptr;
+
+  bool _hasValue = false;           // A value was evaluated
+  bool _hasPublished = false;       // A value was published
+  float _value = 0;                 // Last evaluated value
+  float _published = 0;             // Last published value
+  unsigned long _publishMillis = 0; // Time stamp of the last publish
+
+  void _send();
+};
+
+#endif
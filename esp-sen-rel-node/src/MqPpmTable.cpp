@@ -0,0 +1,101 @@
+/**
+ * MqPpmTable.cpp
+ *
+ * Fixed-point, table driven PPM computation of the MQ gas sensor, see MqPpmTable.h.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "MqPpmTable.h"
+
+void MqPpmTable::begin(float a, float b, float r0, float rl, uint8_t adcResolution)
+{
+  // Same model as MQUnifiedsensor, the voltage resolution cancels out of Rs = RL * (Vres / V - 1)
+  float adcMax = (float)((1UL << adcResolution) - 1);
+  for (int index = 0; index < MQ_PPM_TABLE_SIZE; index++)
+  {
+    int32_t adc = _adcOf(index);
+    float rs = (adc > 0) ? rl * (adcMax / adc - 1) : 0;
+
+    float log2Ppm;
+    if (adc <= 0 || r0 <= 0)
+    {
+      // No voltage, no gas
+      log2Ppm = MQ_PPM_LOG2_MIN / 65536.0;
+    }
+    else if (rs <= 0)
+    {
+      // Full scale, pow() of a zero ratio
+      log2Ppm = MQ_PPM_LOG2_MAX / 65536.0;
+    }
+    else
+    {
+      log2Ppm = log2f(a) + b * log2f(rs / r0);
+    }
+
+    _log2Ppm[index] = constrain(lroundf(log2Ppm * 65536), MQ_PPM_LOG2_MIN, MQ_PPM_LOG2_MAX);
+  }
+
+  for (int index = 0; index <= (1 << MQ_PPM_EXP2_BITS); index++)
+  {
+    _exp2[index] = lroundf(exp2f((float)index / (1 << MQ_PPM_EXP2_BITS)) * 65536);
+  }
+
+  _ready = true;
+}
+
+uint32_t MqPpmTable::ppm(int16_t adc) const
+{
+  if (!_ready || adc <= 0)
+  {
+    return 0;
+  }
+
+  // The first octaves are tabled value by value, above them each entry covers 2^shift values
+  int32_t log2Ppm;
+  if (adc < MQ_PPM_STEPS)
+  {
+    log2Ppm = _log2Ppm[adc];
+  }
+  else
+  {
+    uint8_t shift = (31 - __builtin_clz(adc)) - MQ_PPM_STEP_BITS;
+    int index = MQ_PPM_STEPS * (shift + 1) + ((adc >> shift) & (MQ_PPM_STEPS - 1));
+    int32_t frac = adc & ((1 << shift) - 1);
+    log2Ppm = _log2Ppm[index] + (((_log2Ppm[index + 1] - _log2Ppm[index]) * frac) >> shift);
+  }
+
+  // Below 0.5 ppm the result rounds to 0
+  if (log2Ppm < -(1L << 16))
+  {
+    return 0;
+  }
+
+  // 2^x = 2^int(x) * 2^frac(x), the fraction is interpolated in the exp2 table
+  int8_t exponent = log2Ppm >> 16;
+  uint32_t fraction = log2Ppm & 0xffff;
+  uint8_t index = fraction >> (16 - MQ_PPM_EXP2_BITS);
+  uint32_t frac = fraction & ((1 << (16 - MQ_PPM_EXP2_BITS)) - 1);
+  uint32_t mantissa = _exp2[index] + (((_exp2[index + 1] - _exp2[index]) * frac) >> (16 - MQ_PPM_EXP2_BITS));
+
+  if (exponent >= 16)
+  {
+    return mantissa << (exponent - 16);
+  }
+  return (mantissa + (1UL << (15 - exponent))) >> (16 - exponent);
+}
+
+int32_t MqPpmTable::_adcOf(int index)
+{
+  if (index < MQ_PPM_STEPS)
+  {
+    return index;
+  }
+
+  // Entry i of an octave starts at (MQ_PPM_STEPS + i) << octave
+  int shift = index / MQ_PPM_STEPS - 1;
+  return (int32_t)(MQ_PPM_STEPS + index % MQ_PPM_STEPS) << shift;
+}
@@ -0,0 +1,49 @@
+/**
+ * MqPpmTable.h
+ *
+ * Fixed-point, table driven PPM computation of the MQ gas sensor of esp-sen-rel-node.
+ * <p>
+ * MQUnifiedsensor::readSensor() evaluates the power law a * (Rs/R0)^b with
+ * pow() on floats, which the ESP8266 has to emulate in software. With a
+ * calibrated R0 the PPM only depends on the ADC value, so begin() evaluates
+ * the same model once into a table of log2(PPM) over the ADC range, kept in
+ * Q16.16 fixed point. The table has MQ_PPM_STEPS entries per octave of the
+ * ADC value, the curve is steepest for small values, so every octave gets
+ * the same resolution. ppm() interpolates the table linearly and converts
+ * back with a fixed-point exp2, using integer operations only.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef MqPpmTable_h
+#define MqPpmTable_h
+
+#include <Arduino.h>
+
+const static int MQ_PPM_STEP_BITS = 4;                            // Table entries per octave of the ADC value as power of two
+const static int MQ_PPM_STEPS = (1 << MQ_PPM_STEP_BITS);          // Table entries per octave of the ADC value
+const static int MQ_PPM_ADC_BITS = 15;                            // Bits of the positive ADC range, ADS1115 single ended
+const static int MQ_PPM_TABLE_SIZE = MQ_PPM_STEPS * (MQ_PPM_ADC_BITS - MQ_PPM_STEP_BITS + 1) + 1; // Entries up to and including the end of the ADC range
+const static int MQ_PPM_EXP2_BITS = 4;                            // Segments of the exp2 table per octave as power of two
+const static int32_t MQ_PPM_LOG2_MIN = -(16L << 16);              // Lowest log2(PPM), anything below is 0 ppm
+const static int32_t MQ_PPM_LOG2_MAX = 30L << 16;                 // Highest log2(PPM), keeps the result in 32 bits
+
+class MqPpmTable
+{
+public:
+  void begin(float a, float b, float r0, float rl, uint8_t adcResolution);
+  uint32_t ppm(int16_t adc) const;
+  bool isReady() const { return _ready; }
+
+private:
+  int32_t _log2Ppm[MQ_PPM_TABLE_SIZE];          // log2(PPM) in Q16.16 at the ADC value of each entry
+  uint32_t _exp2[(1 << MQ_PPM_EXP2_BITS) + 1];  // 2^(i / segments) in Q16.16
+  bool _ready = false;
+
+  static int32_t _adcOf(int index);
+};
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * MultiAdcSampler.cpp
+ *
+ * Continuous, ALERT/RDY driven sampling of the ADS1115, see MultiAdcSampler.h.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#include "MultiAdcSampler.h"
+
+const uint16_t ADC_SAMPLER_MUX[ADC_SAMPLER_CHANNEL_CNT] = {ADS1X15_REG_CONFIG_MUX_SINGLE_0, ADS1X15_REG_CONFIG_MUX_SINGLE_1,
+                                                           ADS1X15_REG_CONFIG_MUX_SINGLE_2, ADS1X15_REG_CONFIG_MUX_SINGLE_3};
+
+MultiAdcSampler *MultiAdcSampler::_instance = nullptr;
+
+MultiAdcSampler::MultiAdcSampler(Adafruit_ADS1115 &adc, uint8_t i2cAddr) : _adc(adc), _i2cAddr(i2cAddr)
+{
+}
+
+void MultiAdcSampler::setChannel(uint8_t channel, unsigned long periodMillis, uint8_t window)
+{
+  if (channel >= ADC_SAMPLER_CHANNEL_CNT)
+  {
+    return;
+  }
+
+  // A changed rate starts a new window, the ring keeps the values taken so far
+  AdcChannel &adcChannel = _channels[channel];
+  adcChannel.periodMillis = periodMillis;
+  adcChannel.window = constrain(window, 1, ADC_SAMPLER_MAX_WINDOW);
+  adcChannel.windowCnt = 0;
+  adcChannel.windowSum = 0;
+  adcChannel.dueMillis = millis();
+
+  if (periodMillis > 0)
+  {
+    _channelMask |= (1 << channel);
+  }
+  else
+  {
+    _channelMask &= ~(1 << channel);
+  }
+}
+
+bool MultiAdcSampler::begin(uint8_t alertPin)
+{
+  if (_channelMask == 0)
+  {
+    return false;
+  }
+
+  // The interrupt has no context, only one sampler can run
+  _instance = this;
+  pinMode(alertPin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(alertPin), _onReady, FALLING);
+
+  // Also sets the thresholds that turn ALERT/RDY into a conversion ready signal
+  _selectMillis = millis();
+  _channel = _nextChannel(_selectMillis);
+  _adc.startADCReading(ADC_SAMPLER_MUX[_channel], true);
+  _ready = false;
+
+  return true;
+}
+
+void IRAM_ATTR MultiAdcSampler::_onReady()
+{
+  if (_instance != nullptr)
+  {
+    _instance->_ready = true;
+  }
+}
+
+uint8_t MultiAdcSampler::loop()
+{
+  if (_channelMask == 0)
+  {
+    return 0;
+  }
+
+  unsigned long now = millis();
+  if (!_ready)
+  {
+    if (now - _selectMillis < ADC_SAMPLER_RDY_TIMEOUT)
+    {
+      return 0;
+    }
+
+    // No RDY pulse in many conversion times, fall back to reading on the timeout
+    _polling = true;
+  }
+  else
+  {
+    _polling = false;
+  }
+
+  // Conversions of a channel that isn't due yet are skipped without touching the bus
+  uint8_t updated = 0;
+  AdcChannel &adcChannel = _channels[_channel];
+  if ((_channelMask & (1 << _channel)) && (long)(now - adcChannel.dueMillis) >= 0)
+  {
+    adcChannel.windowSum += _adc.getLastConversionResults();
+    adcChannel.windowCnt++;
+
+    // Keep the rate, but don't catch up on periods lost to a blocked loop
+    if (now - adcChannel.dueMillis >= adcChannel.periodMillis)
+    {
+      adcChannel.dueMillis = now;
+    }
+    adcChannel.dueMillis += adcChannel.periodMillis;
+
+    if (adcChannel.windowCnt >= adcChannel.window)
+    {
+      adcChannel.values[adcChannel.head] = adcChannel.windowSum / adcChannel.windowCnt;
+      adcChannel.head = (adcChannel.head + 1) & (ADC_SAMPLER_RING_SIZE - 1);
+      adcChannel.cnt = min(adcChannel.cnt + 1, ADC_SAMPLER_RING_SIZE);
+      adcChannel.windowCnt = 0;
+      adcChannel.windowSum = 0;
+      updated = (1 << _channel);
+    }
+  }
+
+  uint8_t next = _nextChannel(now);
+  if (next != _channel)
+  {
+    _select(next);
+  }
+
+  // A pulse seen before the switch belongs to the old channel
+  _ready = false;
+  _selectMillis = now;
+
+  return updated;
+}
+
+bool MultiAdcSampler::latest(uint8_t channel, int16_t &value)
+{
+  return samples(channel, &value, 1) == 1;
+}
+
+uint8_t MultiAdcSampler::samples(uint8_t channel, int16_t *values, uint8_t cnt)
+{
+  if (channel >= ADC_SAMPLER_CHANNEL_CNT)
+  {
+    return 0;
+  }
+
+  // Newest value first
+  AdcChannel &adcChannel = _channels[channel];
+  cnt = min(cnt, adcChannel.cnt);
+  for (uint8_t i = 0; i < cnt; i++)
+  {
+    values[i] = adcChannel.values[(adcChannel.head - 1 - i) & (ADC_SAMPLER_RING_SIZE - 1)];
+  }
+
+  return cnt;
+}
+
+uint8_t MultiAdcSampler::_nextChannel(unsigned long now)
+{
+  // The channel due first converts until it's due, ties go round robin after the current channel
+  uint8_t next = _channel;
+  unsigned long nextWait = (unsigned long)-1;
+  for (uint8_t i = 1; i <= ADC_SAMPLER_CHANNEL_CNT; i++)
+  {
+    uint8_t channel = (_channel + i) % ADC_SAMPLER_CHANNEL_CNT;
+    if (_channelMask & (1 << channel))
+    {
+      unsigned long wait = ((long)(_channels[channel].dueMillis - now) > 0) ? _channels[channel].dueMillis - now : 0;
+      if (wait < nextWait)
+      {
+        next = channel;
+        nextWait = wait;
+      }
+    }
+  }
+
+  return next;
+}
+
+void MultiAdcSampler::_select(uint8_t channel)
+{
+  // Only the config register is written, the thresholds set by startADCReading() stay
+  uint16_t config = ADS1X15_REG_CONFIG_CQUE_1CONV | ADS1X15_REG_CONFIG_CLAT_NONLAT | ADS1X15_REG_CONFIG_CPOL_ACTVLOW |
+                    ADS1X15_REG_CONFIG_CMODE_TRAD | ADS1X15_REG_CONFIG_MODE_CONTIN | ADS1X15_REG_CONFIG_OS_SINGLE |
+                    _adc.getGain() | _adc.getDataRate() | ADC_SAMPLER_MUX[channel];
+
+  Wire.beginTransmission(_i2cAddr);
+  Wire.write(ADS1X15_REG_POINTER_CONFIG);
+  Wire.write((uint8_t)(config >> 8));
+  Wire.write((uint8_t)(config & 0xff));
+  Wire.endTransmission();
+
+  _channel = channel;
+}
@@ -0,0 +1,82 @@
+/**
+ * MultiAdcSampler.h
+ *
+ * Continuous, ALERT/RDY driven sampling of the ADS1115 of esp-sen-rel-node.
+ * <p>
+ * The ADS1115 converts continuously and pulls ALERT/RDY low after each
+ * conversion. The interrupt only flags the finished conversion, as I2C can't
+ * be used from an interrupt. Each channel has its own sample period and
+ * averaging window. On a finished conversion of a due channel the sampler
+ * task reads the result and adds it to the channel's window, a full window is
+ * decimated to its average in the channel's ring buffer. The multiplexer is
+ * then switched to the channel due next with one write of the config
+ * register, which restarts the conversion. Conversions of channels not due
+ * are left unread, the bus is only used for samples that are kept. The
+ * sensor loops take their values from the rings and never wait for a
+ * conversion.
+ * <p>
+ * Without a RDY pulse for ADC_SAMPLER_RDY_TIMEOUT ms, e.g. with ALERT/RDY not
+ * wired, the conversion is read anyway, so the sampler degrades to polling.
+ *
+ * @author Creator patba
+ * @author patbah
+ * @version 1.0.0
+ * @license Apache License 2.0
+ */
+
+#ifndef MultiAdcSampler_h
+#define MultiAdcSampler_h
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_ADS1X15.h>
+
+const static int ADC_SAMPLER_CHANNEL_CNT = 4;          // Single ended inputs of the ADS1115
+const static int ADC_SAMPLER_RING_SIZE = 16;           // Samples kept per channel, must be a power of two
+const static int ADC_SAMPLER_MAX_WINDOW = 64;          // Max. samples averaged into one value
+const unsigned long ADC_SAMPLER_RDY_TIMEOUT = 100;     // Time without ALERT/RDY before a conversion is read anyway in ms
+
+class MultiAdcSampler
+{
+public:
+  MultiAdcSampler(Adafruit_ADS1115 &adc, uint8_t i2cAddr = 0x48);
+
+  void setChannel(uint8_t channel, unsigned long periodMillis, uint8_t window);
+  bool begin(uint8_t alertPin);
+  uint8_t loop();
+
+  bool latest(uint8_t channel, int16_t &value);
+  uint8_t samples(uint8_t channel, int16_t *values, uint8_t cnt);
+  bool isPolling() { return _polling; }
+
+private:
+  struct AdcChannel
+  {
+    unsigned long periodMillis; // Sample period, 0 if the channel is not sampled
+    unsigned long dueMillis;    // Timestamp the next sample gets due
+    uint8_t window;             // Samples averaged into one value of the ring
+    uint8_t windowCnt;          // Samples in the current window
+    int32_t windowSum;          // Sum of the samples in the current window
+    int16_t values[ADC_SAMPLER_RING_SIZE];
+    uint8_t head; // Next slot to write
+    uint8_t cnt;  // Valid values, up to ADC_SAMPLER_RING_SIZE
+  };
+
+  Adafruit_ADS1115 &_adc;
+  uint8_t _i2cAddr;
+  uint8_t _channelMask = 0;
+  uint8_t _channel = 0;          // Channel of the running conversion
+  unsigned long _selectMillis = 0;
+  bool _polling = false;
+  AdcChannel _channels[ADC_SAMPLER_CHANNEL_CNT] = {};
+
+  volatile bool _ready = false; // Set by the ALERT/RDY interrupt
+
+  static MultiAdcSampler *_instance;
+  static void IRAM_ATTR _onReady();
+
+  uint8_t _nextChannel(unsigned long now);
+  void _select(uint8_t channel);
+};
+
+#endif
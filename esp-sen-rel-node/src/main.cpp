@@ -1,9 +1,13 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <EspNode.h>
+#include <EspNodeDetector.h>
+#include <EspNodeTelemetry.h>
 #include <Wire.h>
 #include <Adafruit_ADS1X15.h>
 #include <MQUnifiedsensor.h>
+#include "MultiAdcSampler.h"
+#include "MqPpmTable.h"
 
 //***** ESP Node *****//
 char nodeName[32] = "sen_rel";        // Nodes name - default value, may be overridden
@@ -13,74 +17,131 @@ char fwVersion[8] = "1.3";            // Version of the firmware
 EspNode *espNode;
 
 Adafruit_ADS1115 multiAdc;     // ADC definition
+MultiAdcSampler multiAdcSampler(multiAdc); // Continuous sampling of the ADC channels into ring buffers
 #define MULTI_ADC_LIGHT_PIN 0  // ADC pin where light sensor is connected
 #define MULTI_ADC_MQ_PIN 2     // ADC pin where MQ2 is connected
 #define MULTI_ADC_MOTION_PIN 1 // ADC pin where motion sensor is connected
 #define MULTI_ADC_VOLTAGE 5    // ADC voltage resolution
 #define MULTI_ADC_RES 16       // ADC resolution
+#define MULTI_ADC_ALERT_PIN D3 // ADC ALERT/RDY pin, signals each finished conversion
+#define MULTI_ADC_RATE RATE_ADS1115_64SPS // ADC data rate, shared by the channels in turn
+#define MULTI_ADC_I2C_CLOCK 400000        // I2C clock, keeps the per sample bus time short
 #define MULTI_RELAY_PIN_0 D5   // Relay pin 0
 #define MULTI_RELAY_PIN_1 D6   // Relay pin 1
 #define MULTI_RELAY_PIN_2 D7   // Relay pin 2
+#define MULTI_ADC_MIN_PERIOD 20    // Min. sample period of a channel in ms, a little above one conversion at MULTI_ADC_RATE
+#define MULTI_ADC_MAX_PERIOD 60000 // Max. sample period of a channel in ms
+#define MULTI_CONFIG_DOC_SIZE 256 // Size of the document an imported multi sensor configuration is streamed into
+#define MULTI_CONFIG_RECORD "multi"  // Record name of the multi sensor configuration
+#define MULTI_CONFIG_VERSION 2       // Schema version of the multi sensor configuration record
 
 
 #define MULTI_MQ_BOARD "ESP8266"        // Board definition
 #define MULTI_MQ_TYPE "MQ2/ADS1115"     // MQ-Type definition
 #define MULTI_MQ2_RATIO_CLEANAIR (9.83) // MQ2 clean air ratio
 #define MULTI_MQ2_WARMUP_SEC 20         // MQ warmup time in sec
+#define MULTI_MQ2_A 30000000            // MQ2 smoke curve, PPM = a * ratio^b
+#define MULTI_MQ2_B (-8.308)
+#define MULTI_MQ_SMOKE_HYSTERESIS 50    // Smoke level below the limit in ppm until smoke counts as gone
+#define MULTI_MOTION_THRESHOLD 3        // Motion sensor voltage indicating motion
+#define MULTI_MOTION_HYSTERESIS 1       // Motion sensor voltage below the threshold until motion counts as gone
+#define MULTI_LIGHT_DEADBAND 2          // Change of the light percentage needed to publish
+#define MULTI_LIGHT_MIN_INTERVAL 5000   // Min. time between two light publishes in ms
+#define MULTI_LIGHT_HEARTBEAT 300000    // Max. time without a light publish in ms
+
+struct MultiConfig
+{
+  int32_t mqSmokeLimit;
+  uint32_t mqSmokeHoldTime;
+  int32_t lightMinValue;
+  int32_t lightMaxValue;
+  uint32_t motionHoldTime;
+  // Version 2
+  uint32_t mqSamplePeriod;
+  uint8_t mqSampleWindow;
+  uint32_t lightSamplePeriod;
+  uint8_t lightSampleWindow;
+  uint32_t motionSamplePeriod;
+  uint8_t motionSampleWindow;
+} __attribute__((packed));
 
 bool multiAdcSensorInitialized = false; // Bool holding the initialization state of the adc
 
 MQUnifiedsensor multiMqSensor(MULTI_MQ_BOARD, MULTI_ADC_VOLTAGE, MULTI_ADC_RES, -1, MULTI_MQ_TYPE);
+MqPpmTable multiMqPpm;                   // Fixed-point PPM of the calibrated sensor, replaces readSensor() on each value
 unsigned long multiMqWarmupTimer = 0;    // Timestamp used to measure the warmup time
 bool multiMqWarmedUp = false;            // Flag indicating that warmup has been done
 bool multiMqCalibrated = false;          // Flag indicating that calibration has been done
 String multiMqSensorState = "Initial";   // String holding the current state of the MQ sensor
 int multiMqSmokeLimit = 500;             // Smoke limit in ppm - Default value, maybe overridden
-bool multiMqSmokePending = true;         // Flag indicating that a smoke message is pending, true to send initial state
-bool multiMqSmokeDetected = false;       // Flag indicating if smoke was detected, last read value
 unsigned int multiMqSmokeHoldTime = 30;  // Minimum hold time for smoke detection state (sec) - Default value, maybe overridden
-unsigned long multiMqSmokeHoldTimer = 0; // Timestamp used to measure the hold time
+unsigned long multiMqSamplePeriod = 250; // Sample period of the MQ sensor in ms - Default value, maybe overridden
+uint8_t multiMqSampleWindow = 4;         // Samples averaged into one MQ value, 1 per sec - Default value, maybe overridden
+int multiMqTask = -1;                    // Task evaluating each new MQ value
 
 int16_t multiLightVoltage = 0; // Long holding last read light voltage value
 long multiLightPercentage = 0; // Long holding last read light percentage value
 long multiLightMinValue = 4;   // Minimum voltage indicating 0% light - Default value, maybe overridden
 long multiLightMaxValue = 0;   // Maximum voltage indicating 100% light - Default value, maybe overridden
+unsigned long multiLightSamplePeriod = 1000; // Sample period of the light sensor in ms - Default value, maybe overridden
+uint8_t multiLightSampleWindow = 1;          // Samples averaged into one light value - Default value, maybe overridden
+int multiLightTask = -1;                     // Task evaluating each new light value
+EspNodeTelemetry multiLightTelemetry(MULTI_LIGHT_DEADBAND, 0, MULTI_LIGHT_MIN_INTERVAL, MULTI_LIGHT_HEARTBEAT); // Publishes the light percentage on real changes
 
-bool multiMotionPending = true;         // Flag indicating that a motion message is pending, true to send initial state
-bool multiMotionDetected = false;       // Flag indicating if smoke was detected, last read value
 unsigned int multiMotionHoldTime = 5;   // Minimum hold time for motion detection state (sec) - Default value, maybe overridden
-unsigned long multiMotionHoldTimer = 0; // Timestamp used to measure hold time
+unsigned long multiMotionSamplePeriod = 50; // Sample period of the motion sensor in ms - Default value, maybe overridden
+uint8_t multiMotionSampleWindow = 2;        // Samples averaged into one motion value, 10 per sec - Default value, maybe overridden
+int multiMotionTask = -1;                   // Task evaluating each new motion value
+
+// Detection state machines, threshold and hold time are set from the config by multiDetectorsConfigure()
+EspNodeDetector<uint32_t, MULTI_MQ_SMOKE_HYSTERESIS> multiSmokeDetector(500, 30000);
+EspNodeDetector<int16_t, MULTI_MOTION_HYSTERESIS> multiMotionDetector(MULTI_MOTION_THRESHOLD, 5000);
+
+const char *multiRelay0Topic;      // Interned topics, built once by the node
+const char *multiRelay1Topic;
+const char *multiRelay2Topic;
 
 const char HTML_MULTI_FORM_START[] PROGMEM = "<form method='POST' action='saveMulti'>";
 const char HTML_MULTI_ADC_STATUS[] PROGMEM = "<b>ADC Status</b><input id='multiAdcSensorInitialized' readonly name='multiAdcSensorInitialized' placeholder='unknown' value='{multiAdcSensorInitialized}'>";
 const char HTML_MULTI_MQ_STATUS[] PROGMEM = "<br/><br/><b>Smoke Sensor Status</b><input id='multiMqSensorState' readonly name='multiMqSensorState' placeholder='unknown' value='{multiMqSensorState}'>";
-const char HTML_MULTI_MQ_SMOKE_STATUS[] PROGMEM = "<br/><b>Smoke Status</b><input id='multiMqSmokeDetected' readonly name='multiMqSmokeDetected' placeholder='unknown' value='{multiMqSmokeDetected}'>";
+const char HTML_MULTI_MQ_SMOKE_STATUS[] PROGMEM = "<br/><b>Smoke Status</b><input id='multiMqSmokeDetected' data-ev='smoke' readonly name='multiMqSmokeDetected' placeholder='unknown' value='{multiMqSmokeDetected}'>";
 const char HTML_MULTI_MQ_SMOKE_LIMIT[] PROGMEM = "<br/><b>Smoke Limit (ppm)</b> <i><small>(required)</small></i><input id='multiMqSmokeLimit' required name='multiMqSmokeLimit' type='number' maxlength=5 placeholder='500' value='{multiMqSmokeLimit}'>";
 const char HTML_MULTI_MQ_HOLDTIME[] PROGMEM = "<br/><b>Smoke Hold Time (sec)</b> <i><small>(required)</small></i><input id='multiMqSmokeHoldTime' required name='multiMqSmokeHoldTime' type='number' maxlength=5 placeholder='30' value='{multiMqSmokeHoldTime}'>";
-const char HTML_MULTI_LIGHT_VAL[] PROGMEM = "<br/><br/><b>Light Sensor (v/%)</b><input id='multiLightSensorValue' readonly name='multiLightSensorValue' placeholder='unknown' value='{multiLightSensorValue}'>";
+const char HTML_MULTI_MQ_SAMPLE_PERIOD[] PROGMEM = "<br/><b>Smoke Sample Period (ms)</b> <i><small>(required)</small></i><input id='multiMqSamplePeriod' required name='multiMqSamplePeriod' type='number' min=20 max=60000 placeholder='250' value='{multiMqSamplePeriod}'>";
+const char HTML_MULTI_MQ_SAMPLE_WINDOW[] PROGMEM = "<br/><b>Smoke Samples Averaged</b> <i><small>(required)</small></i><input id='multiMqSampleWindow' required name='multiMqSampleWindow' type='number' min=1 max=64 placeholder='4' value='{multiMqSampleWindow}'>";
+const char HTML_MULTI_LIGHT_VAL[] PROGMEM = "<br/><br/><b>Light Sensor (v/%)</b> <i><small>live <span data-ev='light'>{multiLightPercentage}</span>%</small></i><input id='multiLightSensorValue' readonly name='multiLightSensorValue' placeholder='unknown' value='{multiLightSensorValue}'>";
 const char HTML_MULTI_LIGHT_MIN_VAL[] PROGMEM = "<br/><b>Light Sensor Min (v)</b><input id='multiLightMinValue' name='multiLightMinValue' type='number' maxlength=5 placeholder='4' value='{multiLightMinValue}'>";
 const char HTML_MULTI_LIGHT_MAX_VAL[] PROGMEM = "<br/><b>Light Sensor Max (v)</b><input id='multiLightMaxValue' name='multiLightMaxValue' type='number' maxlength=5 placeholder='0' value='{multiLightMaxValue}'>";
-const char HTML_MULTI_MOTION_VAL[] PROGMEM = "<br/><br/><b>Motion Sensor</b><input id='multiMotionDetected' readonly name='multiMotionDetected' placeholder='unknown' value='{multiMotionDetected}'>";
+const char HTML_MULTI_LIGHT_SAMPLE_PERIOD[] PROGMEM = "<br/><b>Light Sample Period (ms)</b> <i><small>(required)</small></i><input id='multiLightSamplePeriod' required name='multiLightSamplePeriod' type='number' min=20 max=60000 placeholder='1000' value='{multiLightSamplePeriod}'>";
+const char HTML_MULTI_LIGHT_SAMPLE_WINDOW[] PROGMEM = "<br/><b>Light Samples Averaged</b> <i><small>(required)</small></i><input id='multiLightSampleWindow' required name='multiLightSampleWindow' type='number' min=1 max=64 placeholder='1' value='{multiLightSampleWindow}'>";
+const char HTML_MULTI_MOTION_VAL[] PROGMEM = "<br/><br/><b>Motion Sensor</b><input id='multiMotionDetected' data-ev='motion' readonly name='multiMotionDetected' placeholder='unknown' value='{multiMotionDetected}'>";
 const char HTML_MULTI_MOTION_HOLDTIME[] PROGMEM = "<br/><b>Motion Hold Time (sec)</b> <i><small>(required)</small></i><input id='multiMotionHoldTime' required name='multiMotionHoldTime' type='number' maxlength=5 placeholder='5' value='{multiMotionHoldTime}'>";
-const char HTML_MULTI_RELAY_0_STATE[] PROGMEM = "<br/><br/><b>Relay 0</b><input id='multiRelayState0' readonly name='multiRelayState0' placeholder='unknown' value='{multiRelayState}'>";
-const char HTML_MULTI_RELAY_1_STATE[] PROGMEM = "<br/><b>Relay 1</b><input id='multiRelayState1' readonly name='multiRelayState1' placeholder='unknown' value='{multiRelayState}'>";
-const char HTML_MULTI_RELAY_2_STATE[] PROGMEM = "<br/><b>Relay 2</b><input id='multiRelayState2' readonly name='multiRelayState2' placeholder='unknown' value='{multiRelayState}'>";
+const char HTML_MULTI_MOTION_SAMPLE_PERIOD[] PROGMEM = "<br/><b>Motion Sample Period (ms)</b> <i><small>(required)</small></i><input id='multiMotionSamplePeriod' required name='multiMotionSamplePeriod' type='number' min=20 max=60000 placeholder='50' value='{multiMotionSamplePeriod}'>";
+const char HTML_MULTI_MOTION_SAMPLE_WINDOW[] PROGMEM = "<br/><b>Motion Samples Averaged</b> <i><small>(required)</small></i><input id='multiMotionSampleWindow' required name='multiMotionSampleWindow' type='number' min=1 max=64 placeholder='2' value='{multiMotionSampleWindow}'>";
+const char HTML_MULTI_RELAY_0_STATE[] PROGMEM = "<br/><br/><b>Relay 0</b><input id='multiRelayState0' data-ev='relay/0' readonly name='multiRelayState0' placeholder='unknown' value='{multiRelayState}'>";
+const char HTML_MULTI_RELAY_1_STATE[] PROGMEM = "<br/><b>Relay 1</b><input id='multiRelayState1' data-ev='relay/1' readonly name='multiRelayState1' placeholder='unknown' value='{multiRelayState}'>";
+const char HTML_MULTI_RELAY_2_STATE[] PROGMEM = "<br/><b>Relay 2</b><input id='multiRelayState2' data-ev='relay/2' readonly name='multiRelayState2' placeholder='unknown' value='{multiRelayState}'>";
 const char HTML_MULTI_BTN_SAVE_FORM_END[] PROGMEM = "<br/><br/><button type='submit'>Save</button></form>";
 const char HTML_MULTI_BTN_BACK[] PROGMEM = "<hr><a href='/'><button>Back</button></a>";
 
 void multiSetup();
-int16_t multiMqReadAdcRaw();
 bool multiMqCalibrate();
 void multiMqLoop();
 void multiLightLoop();
 void multiMotionLoop();
-void multiLoop();
+void multiAdcLoop();
+void multiAdcApplyRates();
+void multiDetectorsConfigure();
 void multiConfigRead();
 void multiConfigSave();
+void multiConfigToRecord(MultiConfig &record);
+bool multiConfigSaveRecord();
 void multiAvailable();
-void multiRcvCallback(String &topic, String &payload);
+void multiRelayCommand(uint8_t pin, String &payload);
+bool multiWebValues(const char *key, Print &out);
 void webHandleMultiSensor();
 void webHandleMultiSensorSave();
+void webJsonMultiSensor(JsonObject json);
 
 void multiConfigRead();
 void multiConfigSave();
@@ -93,7 +154,17 @@ void multiSetup()
   // Load configuration if available
   multiConfigRead();
 
+  multiRelay0Topic = espNode->mqttInternNodeTopic("relay/0");
+  multiRelay1Topic = espNode->mqttInternNodeTopic("relay/1");
+  multiRelay2Topic = espNode->mqttInternNodeTopic("relay/2");
+
+  multiLightTelemetry.begin(espNode, "light");
+  multiSmokeDetector.begin(espNode, "smoke");
+  multiMotionDetector.begin(espNode, "motion");
+  multiDetectorsConfigure();
+
   Wire.begin(D2, D1);
+  Wire.setClock(MULTI_ADC_I2C_CLOCK);
   multiAdcSensorInitialized = multiAdc.begin();
 
   if (!multiAdcSensorInitialized)
@@ -103,10 +174,15 @@ void multiSetup()
 
   if (multiAdcSensorInitialized)
   {
+    // Convert continuously, the sensor loops only pick up the latest samples
+    multiAdc.setDataRate(MULTI_ADC_RATE);
+    multiAdcApplyRates();
+    multiAdcSampler.begin(MULTI_ADC_ALERT_PIN);
+
     // Setup MQ2 sensor
     multiMqSensor.setRegressionMethod(1); // _PPM =  a*ratio^b
-    multiMqSensor.setA(30000000);         // Configure for smoke concentration
-    multiMqSensor.setB(-8.308);
+    multiMqSensor.setA(MULTI_MQ2_A);      // Configure for smoke concentration
+    multiMqSensor.setB(MULTI_MQ2_B);
     multiMqSensor.init();
 
     multiMqSensorState = String(F("Pending: Warming up..."));
@@ -131,18 +207,66 @@ void multiSetup()
   espNode->webRegisterHandler("/multi", webHandleMultiSensor);
   espNode->webAddButtonHandler("/multi", "Sensors & Relay");
   espNode->webRegisterHandler("/saveMulti", webHandleMultiSensorSave);
+  espNode->webRegisterJsonProvider("multi", webJsonMultiSensor);
 
-  // Register mqtt callback
+  // Register mqtt callback and commands
   espNode->mqttAvailableAddCallback(multiAvailable);
-  espNode->mqttRcvAddCallback(multiRcvCallback);
+  espNode->mqttOnCommand("relay/0", [](String &payload)
+                         { multiRelayCommand(MULTI_RELAY_PIN_0, payload); });
+  espNode->mqttOnCommand("relay/1", [](String &payload)
+                         { multiRelayCommand(MULTI_RELAY_PIN_1, payload); });
+  espNode->mqttOnCommand("relay/2", [](String &payload)
+                         { multiRelayCommand(MULTI_RELAY_PIN_2, payload); });
+
+  // Register sensor tasks, the ADC task only reads finished conversions and triggers a sensor on each new averaged value
+  espNode->taskAdd("adc", multiAdcLoop, 0, 20, TASK_PRIO_NORMAL);
+  multiMqTask = espNode->taskAdd("mq", multiMqLoop, TASK_EVENT, 500, TASK_PRIO_LOW);
+  multiLightTask = espNode->taskAdd("light", multiLightLoop, TASK_EVENT, 500, TASK_PRIO_LOW);
+  multiMotionTask = espNode->taskAdd("motion", multiMotionLoop, TASK_EVENT, 50, TASK_PRIO_NORMAL);
 
   delay(1000); // wait for pins to set down
 }
 
-int16_t multiMqReadAdcRaw()
+void multiAdcLoop()
+{
+  uint8_t updated = multiAdcSampler.loop();
+
+  if (updated & (1 << MULTI_ADC_MQ_PIN))
+  {
+    espNode->taskTrigger(multiMqTask);
+  }
+  if (updated & (1 << MULTI_ADC_LIGHT_PIN))
+  {
+    espNode->taskTrigger(multiLightTask);
+  }
+  if (updated & (1 << MULTI_ADC_MOTION_PIN))
+  {
+    espNode->taskTrigger(multiMotionTask);
+  }
+}
+
+void multiAdcApplyRates()
 {
-  return multiAdc.readADC_SingleEnded(MULTI_ADC_MQ_PIN);
+  // Limited here as well, the values may come from an imported or hand edited config
+  multiMqSamplePeriod = constrain(multiMqSamplePeriod, MULTI_ADC_MIN_PERIOD, MULTI_ADC_MAX_PERIOD);
+  multiMqSampleWindow = constrain(multiMqSampleWindow, 1, ADC_SAMPLER_MAX_WINDOW);
+  multiLightSamplePeriod = constrain(multiLightSamplePeriod, MULTI_ADC_MIN_PERIOD, MULTI_ADC_MAX_PERIOD);
+  multiLightSampleWindow = constrain(multiLightSampleWindow, 1, ADC_SAMPLER_MAX_WINDOW);
+  multiMotionSamplePeriod = constrain(multiMotionSamplePeriod, MULTI_ADC_MIN_PERIOD, MULTI_ADC_MAX_PERIOD);
+  multiMotionSampleWindow = constrain(multiMotionSampleWindow, 1, ADC_SAMPLER_MAX_WINDOW);
+
+  multiAdcSampler.setChannel(MULTI_ADC_MQ_PIN, multiMqSamplePeriod, multiMqSampleWindow);
+  multiAdcSampler.setChannel(MULTI_ADC_LIGHT_PIN, multiLightSamplePeriod, multiLightSampleWindow);
+  multiAdcSampler.setChannel(MULTI_ADC_MOTION_PIN, multiMotionSamplePeriod, multiMotionSampleWindow);
 }
+
+void multiDetectorsConfigure()
+{
+  multiSmokeDetector.setThreshold(max(multiMqSmokeLimit, 0));
+  multiSmokeDetector.setHoldMillis(multiMqSmokeHoldTime * 1000UL);
+  multiMotionDetector.setHoldMillis(multiMotionHoldTime * 1000UL);
+}
+
 bool multiMqWarmUp()
 {
   if (multiMqWarmedUp)
@@ -189,13 +313,21 @@ bool multiMqCalibrate()
   {
     espNode->debugPrintln("MULTI: MQ sensor calibrating please wait...");
 
+    // Averaged over the latest samples of the ring, taken continuously during warm up
+    int16_t samples[10];
+    uint8_t sampleCnt = multiAdcSampler.samples(MULTI_ADC_MQ_PIN, samples, 10);
+    if (sampleCnt == 0)
+    {
+      return false;
+    }
+
     float calcR0 = 0;
-    for (int i = 1; i <= 10; i++)
+    for (int i = 0; i < sampleCnt; i++)
     {
-      multiMqSensor.setADC(multiMqReadAdcRaw());
+      multiMqSensor.setADC(samples[i]);
       calcR0 += multiMqSensor.calibrate(MULTI_MQ2_RATIO_CLEANAIR);
     }
-    multiMqSensor.setR0(calcR0 / 10);
+    multiMqSensor.setR0(calcR0 / sampleCnt);
 
     if (isinf(calcR0))
     {
@@ -214,6 +346,9 @@ bool multiMqCalibrate()
       multiMqCalibrated = true;
       multiMqSensorState = String(F("Ready..."));
 
+      // The curve only depends on the ADC value from here on, evaluated once into the table
+      multiMqPpm.begin(MULTI_MQ2_A, MULTI_MQ2_B, multiMqSensor.getR0(), multiMqSensor.getRL(), MULTI_ADC_RES);
+
       espNode->debugPrintln("MULTI: MQ sensor calibrated.");
     }
   }
@@ -223,310 +358,283 @@ bool multiMqCalibrate()
 
 void multiMqLoop()
 {
-  // Send pending message if needed
-  if (multiMqSmokePending)
-  {
-    espNode->debugPrintln(String(F("MULTI: MQ sensor sending state ---> ")) + (multiMqSmokeDetected ? String(F("detected")) : String(F("none"))));
-
-    multiMqSmokePending = !espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("smoke"))), multiMqSmokeDetected ? String(F("detected")) : String(F("none")));
-  }
-
   // Return if warm up and calibration are not done yet
   if (!multiMqWarmUp() && !multiMqCalibrate())
   {
     return; // do not start reading if
   }
 
-  // Read current smoke state
-  multiMqSensor.setADC(multiMqReadAdcRaw());
-  float smokePPM = multiMqSensor.readSensor(); // Sensor will read PPM concentration using the model and a and b values setted before or in the setup
-  boolean smokeDetected = (smokePPM >= multiMqSmokeLimit);
-
-  // Smoke was detected, evaluate timer state
-  if (smokeDetected)
+  // A failed calibration leaves no curve, the error stays in multiMqSensorState instead of a made-up 0 ppm
+  if (!multiMqPpm.isReady())
   {
-    if (multiMqSmokeHoldTimer != 0)
-    {
-      // Timer was already set prior, so just set a new time value
-      multiMqSmokeHoldTimer = millis();
-    }
-    else
-    {
-      espNode->debugPrintln(String(F("MULTI: Smoke detected --> setting timer.")));
-
-      // Timer should be set for the first time
-      multiMqSmokeHoldTimer = millis();
-      // Set pending message, if timer is set for the first time and return from function
-      multiMqSmokePending = true;
-      multiMqSmokeDetected = smokeDetected;
-
-      return;
-    }
+    return;
   }
 
-  // Evaluate if hold time expired
-  unsigned long secondsPassed = 0;
-  if (multiMqSmokeHoldTimer != 0)
+  // Read current smoke state
+  int16_t mqRawValue;
+  if (!multiAdcSampler.latest(MULTI_ADC_MQ_PIN, mqRawValue))
   {
-    secondsPassed = (millis() - multiMqSmokeHoldTimer) / 1000;
+    return;
   }
+  uint32_t smokePPM = multiMqPpm.ppm(mqRawValue); // PPM concentration of the model with the a and b values set in the setup
 
-  if (secondsPassed >= multiMqSmokeHoldTime)
+  if (multiSmokeDetector.update(smokePPM))
   {
-    espNode->debugPrintln(String(F("MULTI: Smoke hold time expired --> setting pending message.")));
-
-    // Set pending message, if hold time expired
-    multiMqSmokePending = true;
-    multiMqSmokeDetected = smokeDetected;
-    // Reset timer for next detected smoke
-    multiMqSmokeHoldTimer = 0;
+    espNode->debugLog(DEBUG_LEVEL_INFO, PSTR("MULTI: Smoke state changed ---> %s at %u ppm."), multiSmokeDetector.payload(), (unsigned int)smokePPM);
   }
 }
 
 void multiLightLoop()
 {
-  int16_t lightRawValue = multiAdc.readADC_SingleEnded(MULTI_ADC_LIGHT_PIN);
+  int16_t lightRawValue;
+  if (!multiAdcSampler.latest(MULTI_ADC_LIGHT_PIN, lightRawValue))
+  {
+    return;
+  }
   multiLightVoltage = multiAdc.computeVolts(lightRawValue);
 
   long lightPercentage = map(multiLightVoltage, multiLightMinValue, multiLightMaxValue, 0, 100);
   lightPercentage = constrain(lightPercentage, 0, 100);
 
-  if (lightPercentage != multiLightPercentage)
-  {
-    espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("light"))), String(lightPercentage));
-  }
-
-  multiLightPercentage = lightPercentage; // Save result and send message if value changes
+  multiLightPercentage = lightPercentage; // Save result, published once it moved out of the deadband
+  multiLightTelemetry.update(lightPercentage);
 }
 
 void multiMotionLoop()
 {
-  // Send pending message if needed
-  if (multiMotionPending)
-  {
-    espNode->debugPrintln(String(F("MULTI: Motion sensor sending state ---> ")) + (multiMotionDetected ? String(F("detected")) : String(F("none"))));
-
-    multiMotionPending = !espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("motion"))), multiMotionDetected ? String(F("detected")) : String(F("none")));
-  }
-
   // Read current motion state
-  int16_t motionRawValue = multiAdc.readADC_SingleEnded(MULTI_ADC_MOTION_PIN);
-  int16_t motionVoltage = multiAdc.computeVolts(motionRawValue);
-
-  bool motionDetected = (motionVoltage >= 3);
-
-  // Motion was detected, evaluate timer state
-  if (motionDetected)
+  int16_t motionRawValue;
+  if (!multiAdcSampler.latest(MULTI_ADC_MOTION_PIN, motionRawValue))
   {
-    if (multiMotionHoldTimer != 0)
-    {
-      // Timer was already set prior, so just set a new time value
-      multiMotionHoldTimer = millis();
-    }
-    else
-    {
-      espNode->debugPrintln(String(F("MULTI: Motion detected --> setting timer.")));
-
-      // Timer should be set for the first time
-      multiMotionHoldTimer = millis();
-      // Set pending message, if timer is set for the first time and return from function
-      multiMotionPending = true;
-      multiMotionDetected = motionDetected;
-
-      return;
-    }
-  }
-
-  // Evaluate if hold time expired
-  unsigned long secondsPassed = 0;
-  if (multiMotionHoldTimer != 0)
-  {
-    secondsPassed = (millis() - multiMotionHoldTimer) / 1000;
+    return;
   }
+  int16_t motionVoltage = multiAdc.computeVolts(motionRawValue);
 
-  if (secondsPassed >= multiMotionHoldTime)
+  if (multiMotionDetector.update(motionVoltage))
   {
-    espNode->debugPrintln(String(F("MULTI: Motion hold time expired --> setting pending message.")));
-
-    // Set pending message, if hold time expired
-    multiMotionPending = true;
-    multiMotionDetected = motionDetected;
-    // Reset timer for next detected motion
-    multiMotionHoldTimer = 0;
+    espNode->debugLog(DEBUG_LEVEL_INFO, PSTR("MULTI: Motion state changed ---> %s."), multiMotionDetector.payload());
   }
 }
 
 void multiAvailable()
 {
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("light"))), String(multiLightPercentage));
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("smoke"))), multiMqSmokeDetected ? String(F("detected")) : String(F("none")));
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("motion"))), multiMotionDetected ? String(F("detected")) : String(F("none")));
+  multiLightTelemetry.publish();
+  multiSmokeDetector.publish();
+  multiMotionDetector.publish();
   
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("relay/0"))), espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_0)));
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("relay/1"))), espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_1)));
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("relay/2"))), espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_2)));
+  espNode->mqttSend(multiRelay0Topic, espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_0)));
+  espNode->mqttSend(multiRelay1Topic, espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_1)));
+  espNode->mqttSend(multiRelay2Topic, espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_2)));
 }
 
-void multiRcvCallback(String &topic, String &payload)
+void multiRelayCommand(uint8_t pin, String &payload)
 {
-  espNode->debugPrintln(String(F("MULTI: Message arrived on topic: '")) + topic + String(F("' with payload: '")) + payload + String(F("'.")));
-
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(String(F("relay/0")))))
-  {
-    if (payload.equals(espNode->mqttGetOnOffPayload(true))) {
-      digitalWrite(MULTI_RELAY_PIN_0, HIGH);
-    }
-
-    if (payload.equals(espNode->mqttGetOnOffPayload(false))) {
-      digitalWrite(MULTI_RELAY_PIN_0, LOW);
-    }
+  espNode->debugPrintln(String(F("MULTI: Relay command on pin ")) + String(pin) + String(F(" with payload: '")) + payload + String(F("'.")));
 
-    if (payload.equals(String(F("toogle")))) {
-      digitalWrite(MULTI_RELAY_PIN_0, !digitalRead(MULTI_RELAY_PIN_0));
-    }
+  if (payload.equals(espNode->mqttGetOnOffPayload(true))) {
+    digitalWrite(pin, HIGH);
+  }
 
-    multiAvailable();
+  if (payload.equals(espNode->mqttGetOnOffPayload(false))) {
+    digitalWrite(pin, LOW);
   }
 
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(String(F("relay/1")))))
-  {
-    if (payload.equals(espNode->mqttGetOnOffPayload(true))) {
-      digitalWrite(MULTI_RELAY_PIN_1, HIGH);
-    }
+  if (payload.equals(String(F("toogle")))) {
+    digitalWrite(pin, !digitalRead(pin));
+  }
 
-    if (payload.equals(espNode->mqttGetOnOffPayload(false))) {
-      digitalWrite(MULTI_RELAY_PIN_1, LOW);
-    }
+  multiAvailable();
+}
 
-    if (payload.equals(String(F("toogle")))) {
-      digitalWrite(MULTI_RELAY_PIN_1, !digitalRead(MULTI_RELAY_PIN_1));
-    }
+void multiConfigRead()
+{
+  // Read saved multi sensor config record from SPIFFS, a record of an older version keeps the defaults of new fields
+  MultiConfig record;
+  multiConfigToRecord(record);
 
-    multiAvailable();
+  if (espNode->configRecordLoad(MULTI_CONFIG_RECORD, MULTI_CONFIG_VERSION, &record, sizeof(record)))
+  {
+    multiMqSmokeLimit = record.mqSmokeLimit;
+    multiMqSmokeHoldTime = record.mqSmokeHoldTime;
+    multiLightMinValue = record.lightMinValue;
+    multiLightMaxValue = record.lightMaxValue;
+    multiMotionHoldTime = record.motionHoldTime;
+    multiMqSamplePeriod = record.mqSamplePeriod;
+    multiMqSampleWindow = record.mqSampleWindow;
+    multiLightSamplePeriod = record.lightSamplePeriod;
+    multiLightSampleWindow = record.lightSampleWindow;
+    multiMotionSamplePeriod = record.motionSamplePeriod;
+    multiMotionSampleWindow = record.motionSampleWindow;
   }
 
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(String(F("relay/2")))))
+  // Migrate or import multiConfig.json, its values override the record
+  StaticJsonDocument<MULTI_CONFIG_DOC_SIZE> configJson;
+
+  if (espNode->configImport("/multiConfig.json", configJson))
   {
-    if (payload.equals(espNode->mqttGetOnOffPayload(true))) {
-      digitalWrite(MULTI_RELAY_PIN_2, HIGH);
+    // Read Multi Sensor configuration
+    if (!configJson["multiMqSmokeLimit"].isNull())
+    {
+      multiMqSmokeLimit = configJson["multiMqSmokeLimit"];
     }
-
-    if (payload.equals(espNode->mqttGetOnOffPayload(false))) {
-      digitalWrite(MULTI_RELAY_PIN_2, LOW);
+    if (!configJson["multiMqSmokeHoldTime"].isNull())
+    {
+      multiMqSmokeHoldTime = configJson["multiMqSmokeHoldTime"];
     }
-
-    if (payload.equals(String(F("toogle")))) {
-      digitalWrite(MULTI_RELAY_PIN_2, !digitalRead(MULTI_RELAY_PIN_2));
+    if (!configJson["multiLightMinValue"].isNull())
+    {
+      multiLightMinValue = configJson["multiLightMinValue"];
+    }
+    if (!configJson["multiLightMaxValue"].isNull())
+    {
+      multiLightMaxValue = configJson["multiLightMaxValue"];
+    }
+    if (!configJson["multiMotionHoldTime"].isNull())
+    {
+      multiMotionHoldTime = configJson["multiMotionHoldTime"];
+    }
+    if (!configJson["multiMqSamplePeriod"].isNull())
+    {
+      multiMqSamplePeriod = configJson["multiMqSamplePeriod"];
+    }
+    if (!configJson["multiMqSampleWindow"].isNull())
+    {
+      multiMqSampleWindow = configJson["multiMqSampleWindow"];
+    }
+    if (!configJson["multiLightSamplePeriod"].isNull())
+    {
+      multiLightSamplePeriod = configJson["multiLightSamplePeriod"];
+    }
+    if (!configJson["multiLightSampleWindow"].isNull())
+    {
+      multiLightSampleWindow = configJson["multiLightSampleWindow"];
+    }
+    if (!configJson["multiMotionSamplePeriod"].isNull())
+    {
+      multiMotionSamplePeriod = configJson["multiMotionSamplePeriod"];
+    }
+    if (!configJson["multiMotionSampleWindow"].isNull())
+    {
+      multiMotionSampleWindow = configJson["multiMotionSampleWindow"];
     }
 
-    multiAvailable();
+    if (multiConfigSaveRecord())
+    {
+      espNode->configImportDone("/multiConfig.json");
+    }
   }
 }
 
-void multiLoop()
-{
-  multiMqLoop();
-  multiLightLoop();
-  multiMotionLoop();
+void multiConfigSave()
+{ // Save the parameters to the multi sensor config record
+  espNode->debugPrintln(F("SPIFFS: Saving multisensor config"));
+
+  multiConfigSaveRecord();
 }
 
-void multiConfigRead()
+void multiConfigToRecord(MultiConfig &record)
 {
-  // Read saved multiConfig.json from SPIFFS
-  espNode->debugPrintln(F("SPIFFS: mounting SPIFFS"));
-
-  File configFile = espNode->configOpenFile("/multiConfig.json", "r");
-  if (configFile)
-  {
-
-    size_t configFileSize = configFile.size(); // Allocate a buffer to store contents of the file.
-    std::unique_ptr<char[]> buf(new char[configFileSize]);
-    configFile.readBytes(buf.get(), configFileSize);
-
-    DynamicJsonDocument configJson(CONFIG_SIZE);
-    DeserializationError jsonError = deserializeJson(configJson, buf.get());
+  // Multi sensor configuration
+  record.mqSmokeLimit = multiMqSmokeLimit;
+  record.mqSmokeHoldTime = multiMqSmokeHoldTime;
+  record.lightMinValue = multiLightMinValue;
+  record.lightMaxValue = multiLightMaxValue;
+  record.motionHoldTime = multiMotionHoldTime;
+  record.mqSamplePeriod = multiMqSamplePeriod;
+  record.mqSampleWindow = multiMqSampleWindow;
+  record.lightSamplePeriod = multiLightSamplePeriod;
+  record.lightSampleWindow = multiLightSampleWindow;
+  record.motionSamplePeriod = multiMotionSamplePeriod;
+  record.motionSampleWindow = multiMotionSampleWindow;
+}
 
-    if (jsonError)
-    { // Couldn't parse the saved config
-      bool removedJson = SPIFFS.remove("/multiConfig.json");
+bool multiConfigSaveRecord()
+{
+  MultiConfig record;
+  multiConfigToRecord(record);
 
-      espNode->debugPrintln(String(F("SPIFFS: [ERROR] Failed to parse /multiConfig.json: ")) + String(jsonError.c_str()));
+  return espNode->configRecordSave(MULTI_CONFIG_RECORD, MULTI_CONFIG_VERSION, &record, sizeof(record));
+}
 
-      if (removedJson)
-      {
-        espNode->debugPrintln(String(F("SPIFFS: Removed corrupt file /multiConfig.json")));
-      }
-      else
-      {
-        espNode->debugPrintln(String(F("SPIFFS: [ERROR] Corrupt file /multiConfig.json could not be removed")));
-      }
-    }
-    else
-    {
-      // Read Multi Sensor configuration
-      if (!configJson["multiMqSmokeLimit"].isNull())
-      {
-        multiMqSmokeLimit = configJson["multiMqSmokeLimit"];
-      }
-      if (!configJson["multiMqSmokeHoldTime"].isNull())
-      {
-        multiMqSmokeHoldTime = configJson["multiMqSmokeHoldTime"];
-      }
-      if (!configJson["multiLightMinValue"].isNull())
-      {
-        multiLightMinValue = configJson["multiLightMinValue"];
-      }
-      if (!configJson["multiLightMaxValue"].isNull())
-      {
-        multiLightMaxValue = configJson["multiLightMaxValue"];
-      }
-      if (!configJson["multiMotionHoldTime"].isNull())
-      {
-        multiMotionHoldTime = configJson["multiMotionHoldTime"];
-      }
-
-      // Print read JSON configuration
-      String configJsonStr;
-      serializeJson(configJson, configJsonStr);
-
-      espNode->debugPrintln(String(F("SPIFFS: parsed json:")) + configJsonStr);
-    }
+bool multiWebValues(const char *key, Print &out)
+{
+  // Fills the placeholders of the multi sensor page, written straight into the node's send buffer
+  if (strcmp_P(key, PSTR("multiAdcSensorInitialized")) == 0)
+  {
+    out.print(multiAdcSensorInitialized ? F("ok") : F("error"));
   }
-  else
+  else if (strcmp_P(key, PSTR("multiMqSensorState")) == 0)
   {
-    espNode->debugPrintln(F("SPIFFS: [ERROR] File not found /multiConfig.json"));
+    out.print(multiMqSensorState);
   }
-}
-
-void multiConfigSave()
-{ // Save the parameters to config.json
-  espNode->debugPrintln(F("SPIFFS: Saving multisensor config"));
-  DynamicJsonDocument jsonConfigValues(CONFIG_SIZE);
-
-  // Save multi sensor configuration
-  jsonConfigValues["multiMqSmokeLimit"] = multiMqSmokeLimit;
-  jsonConfigValues["multiMqSmokeHoldTime"] = multiMqSmokeHoldTime;
-  jsonConfigValues["multiLightMinValue"] = multiLightMinValue;
-  jsonConfigValues["multiLightMaxValue"] = multiLightMaxValue;
-  jsonConfigValues["multiMotionHoldTime"] = multiMotionHoldTime;
-
-  File configFile = espNode->configOpenFile("/multiConfig.json", "w");
-  if (!configFile)
+  else if (strcmp_P(key, PSTR("multiMqSmokeDetected")) == 0)
+  {
+    out.print(multiSmokeDetector.payload());
+  }
+  else if (strcmp_P(key, PSTR("multiMqSmokeLimit")) == 0)
+  {
+    out.print(multiMqSmokeLimit);
+  }
+  else if (strcmp_P(key, PSTR("multiMqSmokeHoldTime")) == 0)
+  {
+    out.print(multiMqSmokeHoldTime);
+  }
+  else if (strcmp_P(key, PSTR("multiMqSamplePeriod")) == 0)
+  {
+    out.print(multiMqSamplePeriod);
+  }
+  else if (strcmp_P(key, PSTR("multiMqSampleWindow")) == 0)
+  {
+    out.print(multiMqSampleWindow);
+  }
+  else if (strcmp_P(key, PSTR("multiLightSensorValue")) == 0)
+  {
+    out.print(multiLightVoltage);
+    out.print(F("v / "));
+    out.print(multiLightPercentage);
+    out.print('%');
+  }
+  else if (strcmp_P(key, PSTR("multiLightPercentage")) == 0)
+  {
+    out.print(multiLightPercentage);
+  }
+  else if (strcmp_P(key, PSTR("multiLightMinValue")) == 0)
+  {
+    out.print(multiLightMinValue);
+  }
+  else if (strcmp_P(key, PSTR("multiLightMaxValue")) == 0)
+  {
+    out.print(multiLightMaxValue);
+  }
+  else if (strcmp_P(key, PSTR("multiLightSamplePeriod")) == 0)
+  {
+    out.print(multiLightSamplePeriod);
+  }
+  else if (strcmp_P(key, PSTR("multiLightSampleWindow")) == 0)
   {
-    espNode->debugPrintln(F("SPIFFS: Failed to open config file for writing"));
+    out.print(multiLightSampleWindow);
+  }
+  else if (strcmp_P(key, PSTR("multiMotionDetected")) == 0)
+  {
+    out.print(multiMotionDetector.payload());
+  }
+  else if (strcmp_P(key, PSTR("multiMotionHoldTime")) == 0)
+  {
+    out.print(multiMotionHoldTime);
+  }
+  else if (strcmp_P(key, PSTR("multiMotionSamplePeriod")) == 0)
+  {
+    out.print(multiMotionSamplePeriod);
+  }
+  else if (strcmp_P(key, PSTR("multiMotionSampleWindow")) == 0)
+  {
+    out.print(multiMotionSampleWindow);
   }
   else
   {
-    serializeJson(jsonConfigValues, configFile);
-    configFile.close();
-
-    // Print saved JSON configuration
-    String configJsonStr;
-    serializeJson(jsonConfigValues, configJsonStr);
-    espNode->debugPrintln(String(F("SPIFFS: saved json:")) + configJsonStr);
+    return false;
   }
-
-  delay(500);
+  return true;
 }
 
 void webHandleMultiSensor()
@@ -536,20 +644,25 @@ void webHandleMultiSensor()
   espNode->webStartHttpMsg(String(F("Multi Sensor Relay")), 200);
 
   espNode->webSendHttpContent(HTML_MULTI_FORM_START);
-  espNode->webSendHttpContent(HTML_MULTI_ADC_STATUS, String(F("{multiAdcSensorInitialized}")), (multiAdcSensorInitialized ? String(F("ok")) : String(F("error"))));
-  espNode->webSendHttpContent(HTML_MULTI_MQ_STATUS, String(F("{multiMqSensorState}")), multiMqSensorState);
-
-  espNode->webSendHttpContent(HTML_MULTI_MQ_SMOKE_STATUS, String(F("{multiMqSmokeDetected}")), (multiMqSmokeDetected ? String(F("detected")) : String(F("none"))));
-  espNode->webSendHttpContent(HTML_MULTI_MQ_SMOKE_LIMIT, String(F("{multiMqSmokeLimit}")), String(multiMqSmokeLimit));
-  espNode->webSendHttpContent(HTML_MULTI_MQ_HOLDTIME, String(F("{multiMqSmokeHoldTime}")), String(multiMqSmokeHoldTime));
-
-  String lightSensorValue = String(multiLightVoltage) + String(F("v / ")) + String(multiLightPercentage) + String(F("%"));
-  espNode->webSendHttpContent(HTML_MULTI_LIGHT_VAL, String(F("{multiLightSensorValue}")), lightSensorValue);
-  espNode->webSendHttpContent(HTML_MULTI_LIGHT_MIN_VAL, String(F("{multiLightMinValue}")), String(multiLightMinValue));
-  espNode->webSendHttpContent(HTML_MULTI_LIGHT_MAX_VAL, String(F("{multiLightMaxValue}")), String(multiLightMaxValue));
-
-  espNode->webSendHttpContent(HTML_MULTI_MOTION_VAL, String(F("{multiMotionDetected}")), (multiMotionDetected ? String(F("detected")) : String(F("none"))));
-  espNode->webSendHttpContent(HTML_MULTI_MOTION_HOLDTIME, String(F("{multiMotionHoldTime}")), String(multiMotionHoldTime));
+  espNode->webSendTemplate(HTML_MULTI_ADC_STATUS, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MQ_STATUS, multiWebValues);
+
+  espNode->webSendTemplate(HTML_MULTI_MQ_SMOKE_STATUS, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MQ_SMOKE_LIMIT, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MQ_HOLDTIME, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MQ_SAMPLE_PERIOD, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MQ_SAMPLE_WINDOW, multiWebValues);
+
+  espNode->webSendTemplate(HTML_MULTI_LIGHT_VAL, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_LIGHT_MIN_VAL, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_LIGHT_MAX_VAL, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_LIGHT_SAMPLE_PERIOD, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_LIGHT_SAMPLE_WINDOW, multiWebValues);
+
+  espNode->webSendTemplate(HTML_MULTI_MOTION_VAL, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MOTION_HOLDTIME, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MOTION_SAMPLE_PERIOD, multiWebValues);
+  espNode->webSendTemplate(HTML_MULTI_MOTION_SAMPLE_WINDOW, multiWebValues);
 
   espNode->webSendHttpContent(HTML_MULTI_RELAY_0_STATE,String(F("{multiRelayState}")), String(espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_0))));
   espNode->webSendHttpContent(HTML_MULTI_RELAY_1_STATE,String(F("{multiRelayState}")), String(espNode->mqttGetOnOffPayload(digitalRead(MULTI_RELAY_PIN_1))));
@@ -564,24 +677,70 @@ void webHandleMultiSensor()
   espNode->debugPrintln(String(F("HTTP: WebHandleMultiSensor page sent.")));
 }
 
+void webJsonMultiSensor(JsonObject json)
+{
+  // Same keys as the multi sensor page and its config
+  json["multiAdcSensorInitialized"] = multiAdcSensorInitialized;
+  json["multiMqSensorState"] = multiMqSensorState.c_str();
+  json["multiMqSmokeDetected"] = multiSmokeDetector.detected();
+  json["multiMqSmokeLimit"] = multiMqSmokeLimit;
+  json["multiMqSmokeHoldTime"] = multiMqSmokeHoldTime;
+  json["multiLightVoltage"] = multiLightVoltage;
+  json["multiLightPercentage"] = multiLightPercentage;
+  json["multiLightMinValue"] = multiLightMinValue;
+  json["multiLightMaxValue"] = multiLightMaxValue;
+  json["multiMotionDetected"] = multiMotionDetector.detected();
+  json["multiMotionHoldTime"] = multiMotionHoldTime;
+  json["multiMqSamplePeriod"] = multiMqSamplePeriod;
+  json["multiMqSampleWindow"] = multiMqSampleWindow;
+  json["multiLightSamplePeriod"] = multiLightSamplePeriod;
+  json["multiLightSampleWindow"] = multiLightSampleWindow;
+  json["multiMotionSamplePeriod"] = multiMotionSamplePeriod;
+  json["multiMotionSampleWindow"] = multiMotionSampleWindow;
+
+  JsonArray relays = json.createNestedArray("multiRelayState");
+  relays.add(digitalRead(MULTI_RELAY_PIN_0) == HIGH);
+  relays.add(digitalRead(MULTI_RELAY_PIN_1) == HIGH);
+  relays.add(digitalRead(MULTI_RELAY_PIN_2) == HIGH);
+}
+
 void webHandleMultiSensorSave()
 {
   espNode->debugPrintln(String(F("HTTP: webHandleMultiSensorSave called from client: ")));
   espNode->debugPrintln(String(F("HTTP: Checking for changed settings...")));
 
   // check if multi sensor settings have changed
+  MultiConfig previous;
+  multiConfigToRecord(previous);
+
   multiMqSmokeLimit = atoi(espNode->webGetArg(String(F("multiMqSmokeLimit"))).c_str());
   multiMqSmokeHoldTime = atoi(espNode->webGetArg(String(F("multiMqSmokeHoldTime"))).c_str());
   multiLightMinValue = atoi(espNode->webGetArg(String(F("multiLightMinValue"))).c_str());
   multiLightMaxValue = atoi(espNode->webGetArg(String(F("multiLightMaxValue"))).c_str());
   multiMotionHoldTime = atoi(espNode->webGetArg(String(F("multiMotionHoldTime"))).c_str());
+  multiMqSamplePeriod = atoi(espNode->webGetArg(String(F("multiMqSamplePeriod"))).c_str());
+  multiMqSampleWindow = constrain(atoi(espNode->webGetArg(String(F("multiMqSampleWindow"))).c_str()), 1, ADC_SAMPLER_MAX_WINDOW);
+  multiLightSamplePeriod = atoi(espNode->webGetArg(String(F("multiLightSamplePeriod"))).c_str());
+  multiLightSampleWindow = constrain(atoi(espNode->webGetArg(String(F("multiLightSampleWindow"))).c_str()), 1, ADC_SAMPLER_MAX_WINDOW);
+  multiMotionSamplePeriod = atoi(espNode->webGetArg(String(F("multiMotionSamplePeriod"))).c_str());
+  multiMotionSampleWindow = constrain(atoi(espNode->webGetArg(String(F("multiMotionSampleWindow"))).c_str()), 1, ADC_SAMPLER_MAX_WINDOW);
 
   espNode->debugPrintln(String(F("HTTP: Sending /saveMulti page to client")));
   espNode->webStartHttpMsg(String(F("")), HTML_SAVESETTINGS_START_REDIR_3SEC, 200, String(F("/multi")));
   espNode->webSendHttpContent(HTML_SAVESETTINGS_NOCHANGE, HTML_REPLACE_REDIRURL, String(F("/multi")));
   espNode->webEndHttpMsg();
 
-  multiConfigSave();
+  // Written by the node after a quiet period, further changes are merged into the same write
+  MultiConfig current;
+  multiConfigToRecord(current);
+  if (memcmp(&previous, &current, sizeof(current)) != 0)
+  {
+    // New rates and limits apply right away, the write to flash may follow later
+    multiAdcApplyRates();
+    multiDetectorsConfigure();
+
+    espNode->configSetDirty(multiConfigSave);
+  }
 }
 
 void setup()
@@ -595,6 +754,4 @@ void setup()
 void loop()
 {
   espNode->loop();
-
-  multiLoop();
 }
\ No newline at end of file
@@ -12,6 +12,7 @@
  */
 
 #include "EspNode.h"
+#include "EspNodePortal.h"
 
 // constructors
 EspNode::EspNode(char *nodeName, char *fwName, char *fwVersion)
@@ -20,7 +21,10 @@ EspNode::EspNode(char *nodeName, char *fwName, char *fwVersion)
   strcpy(_fwName, fwName);
   strcpy(_fwVersion, fwVersion);
 
-#ifdef ESP8266
+#ifdef ESPNODE_WEB_ASYNC
+  _webServer = new EspNodeAsyncWebServer(80);
+  _webUpdateServer = new EspNodeAsyncUpdateServer();
+#elif ESP8266
   _webServer = new ESP8266WebServer(80);
   _webUpdateServer = new ESP8266HTTPUpdateServer();
 #elif ESP32
@@ -32,6 +36,28 @@ EspNode::EspNode(char *nodeName, char *fwName, char *fwVersion)
 
   _mqttWifiClient = new WiFiClient();
   _mqttClient = new MQTTClient(MQTT_BUFFER);
+
+  // Intern the node's own topics, they are built once the node topic is known
+  _mqttAvailableTopic = mqttInternNodeTopic(_mqttAvailableSubTopic);
+  _mqttDebugTopic = mqttInternNodeTopic(_mqttDebugSubTopic);
+  _mqttEnableSendTopic = mqttInternNodeTopic(_mqttEnableSendSubTopic);
+  _mqttEnableDebugTopic = mqttInternNodeTopic(_mqttEnableDebugSubTopic);
+  _mqttEnableRemoteDebugTopic = mqttInternNodeTopic(_mqttEnableRemoteDebugSubTopic);
+  _mqttDebugLevelTopic = mqttInternNodeTopic(_mqttDebugLevelSubTopic);
+  _mqttAllCmdTopic = mqttInternNodeCmdTopic("#");
+
+  // Standard commands go through the same table as the app commands
+  mqttOnCommand(_mqttRebootSubTopic, [this](String &payload)
+                { this->_mqttCommandReboot(payload); });
+  mqttOnCommand(_mqttEnableSendSubTopic, [this](String &payload)
+                { this->_mqttCommandEnable(&this->_mqttSendEnabled, this->_mqttEnableSendTopic, payload); });
+  mqttOnCommand(_mqttEnableDebugSubTopic, [this](String &payload)
+                { this->_mqttCommandEnable(&this->_debugSerialEnabled, this->_mqttEnableDebugTopic, payload); });
+  mqttOnCommand(_mqttEnableRemoteDebugSubTopic, [this](String &payload)
+                { this->_mqttCommandEnable(&this->_debugRemoteEnabled, this->_mqttEnableRemoteDebugTopic, payload); });
+  mqttOnCommand(_mqttDebugLevelSubTopic, [this](String &payload)
+                { this->debugSetLevel(payload.toInt());
+                  this->_mqttSend(this->_mqttDebugLevelTopic, String(this->_debugLevel).c_str()); });
 }
 
 // destructor
@@ -46,6 +72,7 @@ void EspNode::setup()
   _debugSetup();
   _configRead();
   _nodeSetup();
+  _taskSetup();
   _wifiSetup();
   _mqttSetup();
   _webSetup();
@@ -55,36 +82,47 @@ void EspNode::setup()
 // loop method
 void EspNode::loop()
 {
-  _debugLoop();
-  _wifiLoop();
-  _mqttLoop();
-  _webLoop();
+  _taskLoop();
 }
 
 // debug print line
 void EspNode::debugPrintln(String debugText)
 {
-  if (!_debugSerialEnabled && !_debugRemoteEnabled)
+  debugLog(DEBUG_LEVEL_INFO, PSTR("%s"), debugText.c_str());
+}
+
+// debug log with printf style formatting, skipped before formatting if the level is disabled
+void EspNode::debugLog(uint8_t level, PGM_P format, ...)
+{
+  if (!debugIsEnabled(level))
   {
-    // No debug enabled so do nothing
     return;
   }
 
-  if (_debugSerialEnabled || _debugRemoteEnabled)
-  {
-    String debugTimeText = "[+" + String(float(millis()) / 1000, 3) + "s] " + debugText;
+  char line[DEBUG_LINE_SIZE];
+  unsigned long now = millis();
+  int len = snprintf(line, sizeof(line), "[+%lu.%03lus] ", now / 1000, now % 1000);
 
-    if (_debugSerialEnabled)
-    {
-      Serial.println(debugTimeText);
-      Serial.flush();
-    }
+  va_list args;
+  va_start(args, format);
+  int textLen = vsnprintf_P(line + len, sizeof(line) - len - 1, format, args);
+  va_end(args);
 
-    if (_debugRemoteEnabled)
-    {
-      _mqttSend(mqttGetNodeTopic(_mqttDebugSubTopic), debugTimeText);
-    }
-  }
+  // Truncated lines keep their head, the line feed is always appended
+  len += (textLen < 0) ? 0 : min(textLen, (int)sizeof(line) - len - 2);
+  line[len++] = '\n';
+
+  _debugWrite(level, line, len);
+}
+
+bool EspNode::debugIsEnabled(uint8_t level)
+{
+  return (level <= _debugLevel) && (_debugSerialEnabled || _debugRemoteEnabled);
+}
+
+void EspNode::debugSetLevel(uint8_t level)
+{
+  _debugLevel = min(level, DEBUG_LEVEL_DEBUG);
 }
 
 File EspNode::configOpenFile(const char *path, const char *mode)
@@ -102,6 +140,103 @@ File EspNode::configOpenFile(const char *path, const char *mode)
   }
 }
 
+bool EspNode::configLoad(const char *path, JsonDocument &configJson, const JsonDocument *filter)
+{
+  if (!SPIFFS.exists(path))
+  {
+    debugLog(DEBUG_LEVEL_WARN, PSTR("SPIFFS: [WARNING] %s not found, will be created on first config save"), path);
+    return false;
+  }
+
+  File configFile = SPIFFS.open(path, "r");
+  if (!configFile)
+  {
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Failed to open %s"), path);
+    return false;
+  }
+
+  // Parse straight from the file into the caller's document, no copy of the file is held
+  DeserializationError jsonError = (filter != nullptr) ? deserializeJson(configJson, configFile, DeserializationOption::Filter(*filter))
+                                                       : deserializeJson(configJson, configFile);
+  configFile.close();
+
+  if (jsonError)
+  { // Couldn't parse the saved config
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Failed to parse %s: %s"), path, jsonError.c_str());
+
+    if (SPIFFS.remove(path))
+    {
+      debugLog(DEBUG_LEVEL_INFO, PSTR("SPIFFS: Removed corrupt file %s"), path);
+    }
+    else
+    {
+      debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Corrupt file %s could not be removed"), path);
+    }
+    return false;
+  }
+
+  // Print read JSON configuration, serialized only if it is logged
+  if (debugIsEnabled(DEBUG_LEVEL_DEBUG))
+  {
+    String configJsonStr;
+    serializeJson(configJson, configJsonStr);
+    debugLog(DEBUG_LEVEL_DEBUG, PSTR("SPIFFS: parsed %s: %s"), path, configJsonStr.c_str());
+  }
+
+  return true;
+}
+
+bool EspNode::configImport(const char *path, JsonDocument &configJson, const JsonDocument *filter)
+{
+  // A JSON file is only present after an update from the JSON config format or if it was uploaded for import
+  if (!SPIFFS.exists(path))
+  {
+    return false;
+  }
+
+  debugLog(DEBUG_LEVEL_INFO, PSTR("SPIFFS: Importing %s"), path);
+  return configLoad(path, configJson, filter);
+}
+
+void EspNode::configImportDone(const char *path)
+{
+  // Called once the imported values were saved as binary record, the JSON file is not needed anymore
+  if (SPIFFS.remove(path))
+  {
+    debugLog(DEBUG_LEVEL_INFO, PSTR("SPIFFS: Imported %s into binary config"), path);
+  }
+  else
+  {
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Imported file %s could not be removed"), path);
+  }
+}
+
+bool EspNode::configRecordLoad(const char *name, uint16_t version, void *record, size_t size)
+{
+  return _configRecordRead(name, version, record, size, _configGeneration);
+}
+
+bool EspNode::configRecordSave(const char *name, uint16_t version, const void *record, size_t size)
+{
+  // A save outside of a batch is committed on its own
+  bool batch = _configBatch;
+  if (!batch)
+  {
+    _configBatchBegin();
+  }
+
+  if (_configRecordWrite(name, version, record, size, _configGeneration + 1))
+  {
+    _configBatchCnt++;
+  }
+  else
+  {
+    _configBatchFailed = true;
+  }
+
+  return batch ? !_configBatchFailed : _configBatchCommit();
+}
+
 void EspNode::configSaveAddCallback(ConfigSaveCallback callback)
 {
   for (int i = 0; i < CALLBACK_CNT; i++)
@@ -117,6 +252,20 @@ void EspNode::configSaveAddCallback(ConfigSaveCallback callback)
   _nodeReset();
 }
 
+void EspNode::configSetDirty(ConfigSaveCallback callback)
+{
+  for (int i = 0; i < CALLBACK_CNT; i++)
+  {
+    if (_configSaveCallbacks[i] == callback)
+    {
+      _configSetDirty(1 << i);
+      return;
+    }
+  }
+
+  debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Save callback not registered, change not saved"));
+}
+
 void EspNode::webStartHttpMsg(String type, int code)
 {
   webStartHttpMsg(type, String(F("")), code, String(F("/")));
@@ -132,17 +281,22 @@ void EspNode::webStartHttpMsg(String type, String meta, int code, String redirec
   // check if auth is needed
   _webCheckAuth();
 
-  // Prepare for multipart and send first part of html header
-  String httpMessage = FPSTR(HTTP_HEAD_START);
-
-  httpMessage.replace(String(F("{v}")), String(_uniqueNodeName));
-
+  // Send the headers only, the content follows in chunks
   _webServer->setContentLength(CONTENT_LENGTH_UNKNOWN);
-  _webServer->send(code, String(F("text/html")), httpMessage);
+  _webServer->send(code, String(F("text/html")), String());
+
+  // Send first part of html header
+  webSendTemplate(HTTP_HEAD_START, [this](const char *key, Print &out)
+                  {
+                    if (strcmp_P(key, PSTR("v")) != 0)
+                    {
+                      return false;
+                    }
+                    out.print(_uniqueNodeName);
+                    return true; });
 
-  // Send script, style and meta
-  webSendHttpContent(FPSTR(HTTP_SCRIPT));
-  webSendHttpContent(FPSTR(HTTP_STYLE));
+  // Link script and style, served gzipped from /static/* and cached by the browser, then send meta
+  webSendHttpContent(HTTP_HEAD_STATIC);
 
   if (meta.length() > 0)
   {
@@ -151,18 +305,18 @@ void EspNode::webStartHttpMsg(String type, String meta, int code, String redirec
   }
 
   // Send end of html header and start of html body
-  webSendHttpContent(FPSTR(HTTP_HEAD_END));
+  webSendHttpContent(HTTP_HEAD_END);
 
   // Send common content header
-  webSendHttpContent(String(F("<h1>")));
-  webSendHttpContent(String(_uniqueNodeName));
-  webSendHttpContent(String(F("</h1>")));
+  _webWriter.print(F("<h1>"));
+  _webWriter.print(_uniqueNodeName);
+  _webWriter.print(F("</h1>"));
 
   if (type.length() > 0)
   {
-    webSendHttpContent(String(F("<h2>")));
-    webSendHttpContent(String(type));
-    webSendHttpContent(String(F("</h2>")));
+    _webWriter.print(F("<h2>"));
+    _webWriter.print(type);
+    _webWriter.print(F("</h2>"));
   }
 }
 
@@ -172,15 +326,81 @@ void EspNode::webSendHttpContent(String content, String find, String replace)
   webSendHttpContent(content);
 }
 
+void EspNode::webSendHttpContent(PGM_P content, const String &find, const String &replace)
+{
+  // Streams the template, only the placeholder given as "{key}" is replaced
+  webSendTemplate(content, [&find, &replace](const char *key, Print &out)
+                  {
+                    size_t keyLen = strlen(key);
+                    if (find.length() != keyLen + 2 || find[0] != '{' || strncmp(find.c_str() + 1, key, keyLen) != 0)
+                    {
+                      return false;
+                    }
+                    out.print(replace);
+                    return true; });
+}
+
 void EspNode::webSendHttpContent(String content)
 {
-  _webServer->sendContent(content);
+  _webWriter.print(content);
+}
+
+void EspNode::webSendHttpContent(PGM_P content)
+{
+  _webWriter.write_P(content, strlen_P(content));
+}
+
+void EspNode::webSendTemplate(PGM_P content, WebTemplateCallback callback)
+{
+  // Copies the literal parts straight from flash into the send buffer, placeholders are
+  // written by the callback. Anything not looking like {key}, e.g. CSS, is passed as is.
+  char key[WEB_TEMPLATE_KEY_SIZE];
+  PGM_P literal = content;
+  PGM_P pos = content;
+  char c;
+
+  while ((c = pgm_read_byte(pos)) != '\0')
+  {
+    if (c != '{')
+    {
+      pos++;
+      continue;
+    }
+
+    size_t keyLen = 0;
+    PGM_P keyEnd = pos + 1;
+    char k;
+    while ((k = pgm_read_byte(keyEnd)) != '\0' && keyLen < sizeof(key) - 1 && (isalnum(k) || k == '_'))
+    {
+      key[keyLen++] = k;
+      keyEnd++;
+    }
+    if (k != '}' || keyLen == 0)
+    {
+      pos++;
+      continue;
+    }
+    key[keyLen] = '\0';
+
+    _webWriter.write_P(literal, pos - literal);
+    if (!callback(key, _webWriter))
+    {
+      // Unknown placeholder, keep it
+      _webWriter.write_P(pos, keyEnd + 1 - pos);
+    }
+
+    pos = keyEnd + 1;
+    literal = pos;
+  }
+
+  _webWriter.write_P(literal, pos - literal);
 }
 
 void EspNode::webEndHttpMsg()
 {
   // Send end of html body
-  _webServer->sendContent(FPSTR(HTTP_END));
+  webSendHttpContent(HTTP_END);
+  _webWriter.flush();
 
   _webServer->sendContent("");
   _webServer->setContentLength(CONTENT_LENGTH_NOT_SET);
@@ -217,6 +437,54 @@ void EspNode::webRegisterHandler(const Uri &uri, std::function<void(void)> handl
   _webServer->on(uri, handler);
 }
 
+void EspNode::webRegisterJsonProvider(const char *name, WebJsonProvider provider)
+{
+  // Served as /api/<name>, the provider fills the document on each request
+  String uri = String(F("/api/")) + name;
+  _webServer->on(uri, [this, provider]()
+                 { this->_webHandleJson(provider); });
+
+  debugLog(DEBUG_LEVEL_INFO, PSTR("HTTP: Added json provider - %s"), uri.c_str());
+}
+
+void EspNode::webSendEvent(const char *event, const char *data)
+{
+  if (!_webHasEventClients())
+  {
+    return;
+  }
+
+  // A line break would end the field early, such values are not streamed
+  if (strpbrk(event, "\r\n") != nullptr || strpbrk(data, "\r\n") != nullptr)
+  {
+    debugLog(DEBUG_LEVEL_WARN, PSTR("HTTP: Event %s contains a line break, not streamed."), event);
+    return;
+  }
+
+#ifdef ESPNODE_WEB_ASYNC
+  _webServer->sendEvent(event, data);
+#else
+  char msg[WEB_EVENTS_MSG_SIZE];
+  int len = snprintf_P(msg, sizeof(msg), PSTR("event: %s\ndata: %s\n\n"), event, data);
+  if (len < 0 || len >= (int)sizeof(msg))
+  {
+    debugLog(DEBUG_LEVEL_WARN, PSTR("HTTP: Event %s too long, not streamed."), event);
+    return;
+  }
+
+  for (int i = 0; i < WEB_EVENTS_CLIENT_CNT; i++)
+  {
+    WiFiClient &client = _webEventClients[i];
+    if (client.connected() && client.write((const uint8_t *)msg, len) != (size_t)len)
+    {
+      // A stalled client must not hold the loop, the browser reconnects on its own
+      client.stop();
+      debugLog(DEBUG_LEVEL_WARN, PSTR("HTTP: Event stream %d stalled, closed."), i);
+    }
+  }
+#endif
+}
+
 String EspNode::mqttGetDefaultTopic()
 {
   String topic = _mqttDefaultTopicBase + String(_uniqueNodeName);
@@ -269,6 +537,16 @@ String EspNode::mqttGetNodeCmdTopic(String subTopic)
   return topic;
 }
 
+const char *EspNode::mqttInternNodeTopic(const char *subTopic)
+{
+  return _mqttInternTopic(subTopic, false)->topic;
+}
+
+const char *EspNode::mqttInternNodeCmdTopic(const char *subTopic)
+{
+  return _mqttInternTopic(subTopic, true)->topic;
+}
+
 String EspNode::mqttGetCommonDefaultTopic()
 {
   return _mqttDefaultTopicBase;
@@ -304,46 +582,99 @@ bool EspNode::mqttSendAvailable(bool reset)
   {
     debugPrintln(String(F("MQTT: Preparing reset, sending available --> false.")) + String(_mqttServer));
 
-    return _mqttSend(mqttGetNodeTopic(_mqttAvailableSubTopic), String(F("false")));
+    // Flush the queue, the node will not come back to it
+    _mqttDrain(MQTT_QUEUE_CNT);
+
+    return _mqttPublish(_mqttAvailableTopic, "false", 5);
   }
 
-  if (_mqttAvailableMsgPending)
-  {
-    debugPrintln(String(F("MQTT: Sending pending available state --> true.")));
+  debugPrintln(String(F("MQTT: Queueing available state --> true.")));
 
-    _mqttAvailableMsgPending = !_mqttSend(mqttGetNodeTopic(_mqttAvailableSubTopic), String(F("true")));
+  _mqttSend(_mqttAvailableTopic, "true");
 
-    if (!_mqttAvailableMsgPending)
-    {
-      // send mqtt send enable status, if available paylod has been sent
-      _mqttSend(mqttGetNodeTopic(_mqttEnableSendSubTopic), mqttGetOnOffPayload(_mqttEnableSendSubTopic));
-      _mqttSend(mqttGetNodeTopic(_mqttEnableDebugSubTopic), mqttGetOnOffPayload(_debugSerialEnabled));
-      _mqttSend(mqttGetNodeTopic(_mqttEnableRemoteDebugSubTopic), mqttGetOnOffPayload(_debugRemoteEnabled));
+  // send mqtt send enable status together with the available payload
+  _mqttSend(_mqttEnableSendTopic, _mqttSendEnabled ? _mqttOnPayload : _mqttOffPayload);
+  _mqttSend(_mqttEnableDebugTopic, _debugSerialEnabled ? _mqttOnPayload : _mqttOffPayload);
+  _mqttSend(_mqttEnableRemoteDebugTopic, _debugRemoteEnabled ? _mqttOnPayload : _mqttOffPayload);
 
-      // Call mqtt available callbacks
-      for (int i = 0; i < CALLBACK_CNT; i++)
-      {
-        if (_mqttAvailableCallbacks[i] != nullptr)
-        {
-          _mqttAvailableCallbacks[i]();
-        }
-      }
+  // Call mqtt available callbacks
+  for (int i = 0; i < CALLBACK_CNT; i++)
+  {
+    if (_mqttAvailableCallbacks[i] != nullptr)
+    {
+      _mqttAvailableCallbacks[i]();
     }
+  }
 
-    return true;
+  return true;
+}
+
+bool EspNode::mqttSend(String topic, String cmd)
+{
+  // The web UI gets the same deltas, also while MQTT sending is disabled
+  _webPublishEvent(topic.c_str(), cmd.c_str(), true);
+
+  if (_mqttSendEnabled)
+  {
+    // State message, a newer value on the same topic replaces a queued one
+    return _mqttEnqueue(topic.c_str(), topic.length(), cmd.c_str(), cmd.length(), true);
   }
   else
   {
     return false;
   }
+}
 
-  return true;
+bool EspNode::mqttSend(const char *topic, const char *cmd)
+{
+  _webPublishEvent(topic, cmd, true);
+
+  if (_mqttSendEnabled)
+  {
+    return _mqttEnqueue(topic, strlen(topic), cmd, strlen(cmd), true);
+  }
+  else
+  {
+    return false;
+  }
 }
-bool EspNode::mqttSend(String topic, String cmd)
+
+bool EspNode::mqttSend(const char *topic, const String &cmd)
+{
+  _webPublishEvent(topic, cmd.c_str(), true);
+
+  if (_mqttSendEnabled)
+  {
+    return _mqttEnqueue(topic, strlen(topic), cmd.c_str(), cmd.length(), true);
+  }
+  else
+  {
+    return false;
+  }
+}
+
+bool EspNode::mqttSendEvent(String topic, String cmd)
+{
+  _webPublishEvent(topic.c_str(), cmd.c_str(), false);
+
+  if (_mqttSendEnabled)
+  {
+    // Event message, queued in order and never merged
+    return _mqttEnqueue(topic.c_str(), topic.length(), cmd.c_str(), cmd.length(), false);
+  }
+  else
+  {
+    return false;
+  }
+}
+
+bool EspNode::mqttSendEvent(const char *topic, const char *cmd)
 {
+  _webPublishEvent(topic, cmd, false);
+
   if (_mqttSendEnabled)
   {
-    return _mqttClient->publish(topic, cmd);
+    return _mqttEnqueue(topic, strlen(topic), cmd, strlen(cmd), false);
   }
   else
   {
@@ -351,6 +682,11 @@ bool EspNode::mqttSend(String topic, String cmd)
   }
 }
 
+void EspNode::mqttSetQueueDrainRate(uint8_t rate)
+{
+  _mqttQueueDrainRate = max(rate, (uint8_t)1);
+}
+
 void EspNode::mqttAvailableAddCallback(MQTTAvailableCallback callback)
 {
   for (int i = 0; i < CALLBACK_CNT; i++)
@@ -381,6 +717,88 @@ void EspNode::mqttRcvAddCallback(MQTTClientCallbackSimple callback)
   _nodeReset();
 }
 
+const char *EspNode::mqttOnCommand(const char *subTopic, MQTTCommandHandler handler)
+{
+  // Matching works on the sub topic, so a leading separator is not part of the key
+  if (subTopic[0] == '/')
+  {
+    subTopic++;
+  }
+
+  EspNodeTopic *topic = _mqttInternTopic(subTopic, true);
+  uint32_t hash = _mqttCommandHash(topic->subTopic);
+  EspNodeCommand **bucket = &_mqttCommands[hash & (MQTT_COMMAND_BUCKET_CNT - 1)];
+
+  for (EspNodeCommand *command = *bucket; command != nullptr; command = command->next)
+  {
+    if (command->topic == topic)
+    {
+      debugPrintln(String(F("MQTT: Replacing handler of command ")) + String(topic->subTopic));
+      command->handler = handler;
+      return topic->topic;
+    }
+  }
+
+  // Allocated once per command and never freed, there is no fixed limit of commands
+  EspNodeCommand *command = new EspNodeCommand();
+  command->topic = topic;
+  command->hash = hash;
+  command->handler = handler;
+  command->next = *bucket;
+  *bucket = command;
+
+  return topic->topic;
+}
+
+int EspNode::taskAdd(const char *name, TaskCallback callback, unsigned long periodMillis, unsigned long deadlineMillis, uint8_t priority)
+{
+  if (_taskCnt >= TASK_CNT)
+  {
+    debugPrintln(String(F("TASK: All task slots already used - restarting.")));
+    _nodeReset();
+    return -1;
+  }
+
+  EspNodeTask &task = _tasks[_taskCnt];
+  task.name = name;
+  task.callback = callback;
+  task.periodMillis = periodMillis;
+  task.deadlineMillis = deadlineMillis;
+  task.priority = priority;
+  task.dueMillis = millis();
+  task.triggered = false;
+  task.runCount = 0;
+  task.totalMicros = 0;
+  task.maxMicros = 0;
+  task.deadlineMisses = 0;
+
+  debugPrintln(String(F("TASK: Added task[")) + String(_taskCnt) + String(F("] - ")) + String(name) + String(F(" period=")) + ((periodMillis == TASK_EVENT) ? String(F("event")) : String(periodMillis)) + String(F(" prio=")) + String(priority));
+
+  return _taskCnt++;
+}
+
+void EspNode::taskTrigger(int taskId)
+{
+  if (taskId < 0 || taskId >= _taskCnt)
+  {
+    return;
+  }
+
+  EspNodeTask &task = _tasks[taskId];
+  if (!task.triggered)
+  {
+    // the first trigger sets the due time, further triggers are merged into the pending run
+    task.triggered = true;
+    task.dueMillis = millis();
+  }
+}
+
+bool EspNode::wifiIsConnected()
+{
+  // Also ask the driver, the state machine only polls every 100 ms
+  return (_wifiState == WIFI_STATE_CONNECTED) && (WiFi.status() == WL_CONNECTED);
+}
+
 void EspNode::_nodeSetup()
 {
   WiFi.macAddress(_espMac); // Read our MAC address and save it to espMac
@@ -392,7 +810,11 @@ void EspNode::_nodeReset()
 {
   debugPrintln(F("RESET: reset"));
 
+  // Write pending config changes, the quiet period is cut short
+  _configFlush();
+
   mqttSendAvailable(true);
+  _debugDrain(true);
   delay(500);
   ESP.restart();
   delay(5000);
@@ -414,177 +836,603 @@ void EspNode::_debugSetupFinalize()
   {
     debugPrintln(String(F("SYSTEM: Stopping serial debug due to configuration")));
 
+    _debugDrain(true);
     Serial.flush();
     Serial.end();
   }
-}
 
-void EspNode::_debugLoop()
-{
-  // currently nothing in here
+  // From now on lines are only buffered and the debug task does the output
+  _debugDeferred = true;
 }
 
-void EspNode::_configRead()
+void EspNode::_debugWrite(uint8_t level, const char *line, size_t len)
 {
-  // Read saved config.json from SPIFFS
-  debugPrintln(F("SPIFFS: mounting SPIFFS"));
+  // Outputs, which are switched off, don't hold back the ring
+  if (!_debugSerialEnabled)
+  {
+    _debugSerialPos = _debugWritePos;
+  }
+  if (!_debugRemoteEnabled)
+  {
+    _debugRemotePos = _debugWritePos;
+  }
 
-#ifdef ESP8266
-  if (SPIFFS.begin())
-#endif
-#ifdef ESP32
-    if (SPIFFS.begin(true))
-#endif
+  // Drop the oldest lines until the new one fits
+  while (_debugWritePos + len - min(_debugSerialPos, _debugRemotePos) > (unsigned long)DEBUG_RING_SIZE)
+  {
+    unsigned long oldest = min(_debugSerialPos, _debugRemotePos);
+    while (oldest < _debugWritePos && _debugRing[oldest % DEBUG_RING_SIZE] != '\n')
     {
-      if (SPIFFS.exists("/config.json"))
-      { // File exists, reading and loading
-        debugPrintln(F("SPIFFS: reading /config.json"));
+      oldest++;
+    }
+    oldest++;
 
-        File configFile = SPIFFS.open("/config.json", "r");
-        if (configFile)
-        {
-          size_t configFileSize = configFile.size(); // Allocate a buffer to store contents of the file.
-          std::unique_ptr<char[]> buf(new char[configFileSize]);
-          configFile.readBytes(buf.get(), configFileSize);
-
-          DynamicJsonDocument configJson(CONFIG_SIZE);
-          DeserializationError jsonError = deserializeJson(configJson, buf.get());
-
-          if (jsonError)
-          { // Couldn't parse the saved config
-            bool removedJson = SPIFFS.remove("/config.json");
-
-            debugPrintln(String(F("SPIFFS: [ERROR] Failed to parse /config.json: ")) + String(jsonError.c_str()));
-
-            if (removedJson)
-            {
-              debugPrintln(String(F("SPIFFS: Removed corrupt file /config.json")));
-            }
-            else
-            {
-              debugPrintln(String(F("SPIFFS: [ERROR] Corrupt file /config.json could not be removed")));
-            }
-          }
-          else
-          {
-            // Read node configuration
-            if (!configJson["nodeName"].isNull())
-            {
-              strcpy(_nodeName, configJson["nodeName"]);
-            }
-            if (!configJson["configUser"].isNull())
-            {
-              strcpy(_configUser, configJson["configUser"]);
-            }
-            if (!configJson["configPassword"].isNull())
-            {
-              strcpy(_configPassword, configJson["configPassword"]);
-            }
-
-            // Read MQTT configuration
-            if (!configJson["mqttServer"].isNull())
-            {
-              strcpy(_mqttServer, configJson["mqttServer"]);
-            }
-            if (!configJson["mqttPort"].isNull())
-            {
-              _mqttPort = configJson["mqttPort"];
-            }
-            if (!configJson["mqttUser"].isNull())
-            {
-              strcpy(_mqttUser, configJson["mqttUser"]);
-            }
-            if (!configJson["mqttPassword"].isNull())
-            {
-              strcpy(_mqttPassword, configJson["mqttPassword"]);
-            }
-            if (!configJson["mqttTopic"].isNull())
-            {
-              strcpy(_mqttTopic, configJson["mqttTopic"]);
-            }
-
-            // Read Debug configuration
-            if (!configJson["debugSerialEnabled"].isNull())
-            {
-              _debugSerialEnabled = configJson["debugSerialEnabled"];
-            }
-            if (!configJson["debugRemoteEnabled"].isNull())
-            {
-              _debugRemoteEnabled = configJson["debugRemoteEnabled"];
-            }
-
-            // Print read JSON configuration
-            String configJsonStr;
-            serializeJson(configJson, configJsonStr);
-
-            debugPrintln(String(F("SPIFFS: parsed json:")) + configJsonStr);
-          }
-        }
-        else
-        {
-          debugPrintln(F("SPIFFS: [ERROR] File not found /config.json"));
-        }
+    _debugSerialPos = max(_debugSerialPos, oldest);
+    _debugRemotePos = max(_debugRemotePos, oldest);
+    _debugDropped++;
+  }
+
+  for (size_t i = 0; i < len; i++)
+  {
+    _debugRing[(_debugWritePos + i) % DEBUG_RING_SIZE] = line[i];
+  }
+  _debugWritePos += len;
+
+  if (_debugRemoteEnabled && level <= DEBUG_LEVEL_ERROR)
+  {
+    _debugRemoteUrgent = true;
+  }
+
+  if (!_debugDeferred)
+  {
+    // During setup there is no scheduler yet, so write through
+    _debugDrain(true);
+  }
+}
+
+void EspNode::_debugDrain(bool all)
+{
+  _debugDrainSerial(all);
+  _debugDrainRemote(all);
+}
+
+void EspNode::_debugDrainSerial(bool all)
+{
+  if (!_debugSerialEnabled)
+  {
+    _debugSerialPos = _debugWritePos;
+    return;
+  }
+
+  while (_debugSerialPos < _debugWritePos)
+  {
+    // Only write what fits into the UART FIFO, so the task never waits for the line
+    size_t index = _debugSerialPos % DEBUG_RING_SIZE;
+    size_t len = min((size_t)(_debugWritePos - _debugSerialPos), (size_t)DEBUG_RING_SIZE - index);
+    if (!all)
+    {
+      len = min(len, (size_t)Serial.availableForWrite());
+      if (len == 0)
+      {
+        return;
       }
-      else
+    }
+
+    Serial.write((const uint8_t *)&_debugRing[index], len);
+    _debugSerialPos += len;
+  }
+}
+
+void EspNode::_debugDrainRemote(bool all)
+{
+  if (!_debugRemoteEnabled)
+  {
+    _debugRemotePos = _debugWritePos;
+    return;
+  }
+
+  if (_debugRemoteBatch == nullptr)
+  {
+    // Allocated once, nodes without remote debug don't pay for it
+    _debugRemoteBatch = new char[DEBUG_REMOTE_BATCH_SIZE];
+  }
+
+  // Move whole lines from the ring into the batch
+  while (_debugRemotePos < _debugWritePos)
+  {
+    size_t len = 0;
+    while (_debugRing[(_debugRemotePos + len++) % DEBUG_RING_SIZE] != '\n')
+    {
+    }
+
+    if (_debugRemoteBatchLen + len > (size_t)DEBUG_REMOTE_BATCH_SIZE && !_debugFlushRemote())
+    {
+      // The broker falls behind, make room by dropping the oldest batched lines
+      _debugDropRemote(len);
+    }
+
+    if (_debugRemoteBatchLen == 0)
+    {
+      _debugRemoteBatchMillis = millis();
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+      _debugRemoteBatch[_debugRemoteBatchLen++] = _debugRing[_debugRemotePos++ % DEBUG_RING_SIZE];
+    }
+  }
+
+  // Flush on time or on error severity, the size is handled above
+  if (_debugRemoteBatchLen > 0 && (all || _debugRemoteUrgent || (millis() - _debugRemoteBatchMillis >= DEBUG_REMOTE_FLUSH_PERIOD)))
+  {
+    _debugFlushRemote();
+  }
+}
+
+bool EspNode::_debugFlushRemote()
+{
+  // The last line feed is not part of the payload
+  if (!_mqttPublish(_mqttDebugTopic, _debugRemoteBatch, _debugRemoteBatchLen - 1))
+  {
+    return false;
+  }
+
+  _debugRemoteBatchLen = 0;
+  _debugRemoteUrgent = false;
+
+  if (_debugRemoteDropped > 0)
+  {
+    // Report the gap at the head of the next batch
+    unsigned long now = millis();
+    _debugRemoteBatchLen = snprintf(_debugRemoteBatch, DEBUG_REMOTE_BATCH_SIZE, "[+%lu.%03lus] DEBUG: %lu remote lines dropped\n", now / 1000, now % 1000, _debugRemoteDropped);
+    _debugRemoteBatchMillis = now;
+    _debugRemoteDropped = 0;
+  }
+
+  return true;
+}
+
+void EspNode::_debugDropRemote(size_t len)
+{
+  size_t dropLen = 0;
+  while (dropLen < _debugRemoteBatchLen && _debugRemoteBatchLen - dropLen + len > (size_t)DEBUG_REMOTE_BATCH_SIZE)
+  {
+    const char *lineEnd = (const char *)memchr(_debugRemoteBatch + dropLen, '\n', _debugRemoteBatchLen - dropLen);
+    dropLen = (lineEnd - _debugRemoteBatch) + 1;
+    _debugRemoteDropped++;
+  }
+
+  memmove(_debugRemoteBatch, _debugRemoteBatch + dropLen, _debugRemoteBatchLen - dropLen);
+  _debugRemoteBatchLen -= dropLen;
+}
+
+void EspNode::_debugLoop()
+{
+  _debugDrain(false);
+}
+
+void EspNode::_configRead()
+{
+  // Read saved config from SPIFFS
+  debugPrintln(F("SPIFFS: mounting SPIFFS"));
+
+#ifdef ESP8266
+  if (SPIFFS.begin())
+#endif
+#ifdef ESP32
+    if (SPIFFS.begin(true))
+#endif
+    {
+      // Records of a generation that wasn't committed are ignored
+      if (!_configRecordRead(CONFIG_COMMIT_RECORD, 1, &_configGeneration, sizeof(_configGeneration), UINT32_MAX))
       {
-        debugPrintln(F("SPIFFS: [WARNING] /config.json not found, will be created on first config save"));
+        _configGeneration = 0;
+      }
+
+      // Start from the current values, a record of an older version only fills the fields it knows
+      EspNodeConfig record;
+      memset(&record, 0, sizeof(record));
+      snprintf(record.nodeName, sizeof(record.nodeName), "%s", _nodeName);
+      snprintf(record.configUser, sizeof(record.configUser), "%s", _configUser);
+      snprintf(record.configPassword, sizeof(record.configPassword), "%s", _configPassword);
+      snprintf(record.mqttServer, sizeof(record.mqttServer), "%s", _mqttServer);
+      record.mqttPort = _mqttPort;
+      snprintf(record.mqttUser, sizeof(record.mqttUser), "%s", _mqttUser);
+      snprintf(record.mqttPassword, sizeof(record.mqttPassword), "%s", _mqttPassword);
+      snprintf(record.mqttTopic, sizeof(record.mqttTopic), "%s", _mqttTopic);
+      record.debugSerialEnabled = _debugSerialEnabled;
+      record.debugRemoteEnabled = _debugRemoteEnabled;
+
+      if (configRecordLoad(CONFIG_NODE_RECORD, CONFIG_NODE_VERSION, &record, sizeof(record)))
+      {
+        // Read node configuration
+        memcpy(_nodeName, record.nodeName, sizeof(_nodeName));
+        memcpy(_configUser, record.configUser, sizeof(_configUser));
+        memcpy(_configPassword, record.configPassword, sizeof(_configPassword));
+
+        // Read MQTT configuration
+        memcpy(_mqttServer, record.mqttServer, sizeof(_mqttServer));
+        _mqttPort = record.mqttPort;
+        memcpy(_mqttUser, record.mqttUser, sizeof(_mqttUser));
+        memcpy(_mqttPassword, record.mqttPassword, sizeof(_mqttPassword));
+        memcpy(_mqttTopic, record.mqttTopic, sizeof(_mqttTopic));
+
+        // Read Debug configuration
+        _debugSerialEnabled = record.debugSerialEnabled;
+        _debugRemoteEnabled = record.debugRemoteEnabled;
+      }
+
+      // Migrate or import a JSON configuration, its values override the record
+      StaticJsonDocument<CONFIG_NODE_DOC_SIZE> configJson;
+
+      if (configImport("/config.json", configJson))
+      {
+        _configFromJson(configJson);
+
+        if (_configSaveRecord())
+        {
+          configImportDone("/config.json");
+        }
       }
     }
     else
     {
-      debugPrintln(F("SPIFFS: [ERROR] Failed to mount FS"));
+      debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Failed to mount FS"));
     }
 }
 
 void EspNode::_configSave()
 {
-  // Save the parameters to config.json
-  debugPrintln(F("SPIFFS: Saving config"));
-  DynamicJsonDocument jsonConfigValues(CONFIG_SIZE);
+  // Save the node and all modules right away
+  _configSetDirty(CONFIG_DIRTY_NODE | ((1 << CALLBACK_CNT) - 1));
+  _configFlush();
+}
+
+void EspNode::_configSetDirty(uint8_t flags)
+{
+  // Every change restarts the quiet period, a burst of changes is written once
+  _configDirty |= flags;
+  _configDirtyMillis = millis();
+}
+
+void EspNode::_configFlush()
+{
+  uint8_t dirty = _configDirty;
+  if (dirty == 0)
+  {
+    return;
+  }
+  _configDirty = 0;
+
+  // Save the changed modules only, committed as one generation
+  debugLog(DEBUG_LEVEL_INFO, PSTR("SPIFFS: Saving config, changed modules 0x%02x"), dirty);
+
+  _configBatchBegin();
+
+  if (dirty & CONFIG_DIRTY_NODE)
+  {
+    _configSaveRecord();
+  }
+
+  // Call save callbacks of the changed modules
+  for (int i = 0; i < CALLBACK_CNT; i++)
+  {
+    if ((dirty & (1 << i)) && _configSaveCallbacks[i] != nullptr)
+    {
+      _configSaveCallbacks[i]();
+    }
+  }
+
+  if (!_configBatchCommit())
+  {
+    // Keep the changes and retry after the next quiet period
+    _configSetDirty(dirty);
+  }
+}
+
+void EspNode::_configLoop()
+{
+  if (_configDirty != 0 && millis() - _configDirtyMillis >= CONFIG_FLUSH_DELAY)
+  {
+    _configFlush();
+  }
+}
+
+bool EspNode::_configSaveRecord()
+{
+  EspNodeConfig record;
+  memset(&record, 0, sizeof(record));
 
   // Save node configuration
-  jsonConfigValues["nodeName"] = _nodeName;
-  jsonConfigValues["configUser"] = _configUser;
-  jsonConfigValues["configPassword"] = _configPassword;
+  snprintf(record.nodeName, sizeof(record.nodeName), "%s", _nodeName);
+  snprintf(record.configUser, sizeof(record.configUser), "%s", _configUser);
+  snprintf(record.configPassword, sizeof(record.configPassword), "%s", _configPassword);
 
   // Save MQTT configuration
-  jsonConfigValues["mqttServer"] = _mqttServer;
-  jsonConfigValues["mqttPort"] = _mqttPort;
-  jsonConfigValues["mqttUser"] = _mqttUser;
-  jsonConfigValues["mqttPassword"] = _mqttPassword;
-  jsonConfigValues["mqttTopic"] = _mqttTopic;
+  snprintf(record.mqttServer, sizeof(record.mqttServer), "%s", _mqttServer);
+  record.mqttPort = _mqttPort;
+  snprintf(record.mqttUser, sizeof(record.mqttUser), "%s", _mqttUser);
+  snprintf(record.mqttPassword, sizeof(record.mqttPassword), "%s", _mqttPassword);
+  snprintf(record.mqttTopic, sizeof(record.mqttTopic), "%s", _mqttTopic);
 
   // Save Debug configuration
-  jsonConfigValues["debugSerialEnabled"] = _debugSerialEnabled;
-  jsonConfigValues["debugRemoteEnabled"] = _debugRemoteEnabled;
+  record.debugSerialEnabled = _debugSerialEnabled;
+  record.debugRemoteEnabled = _debugRemoteEnabled;
 
-  File configFile = SPIFFS.open("/config.json", "w");
-  if (!configFile)
+  return configRecordSave(CONFIG_NODE_RECORD, CONFIG_NODE_VERSION, &record, sizeof(record));
+}
+
+void EspNode::_configToJson(JsonObject configJson)
+{
+  // Export node configuration, passwords are masked like on the settings page
+  configJson["nodeName"] = _nodeName;
+  configJson["configUser"] = _configUser;
+  configJson["configPassword"] = (_configPassword[0] != '\0') ? MASKED_PASSWORD : "";
+
+  // Export MQTT configuration
+  configJson["mqttServer"] = _mqttServer;
+  configJson["mqttPort"] = _mqttPort;
+  configJson["mqttUser"] = _mqttUser;
+  configJson["mqttPassword"] = (_mqttPassword[0] != '\0') ? MASKED_PASSWORD : "";
+  configJson["mqttTopic"] = _mqttTopic;
+
+  // Export Debug configuration
+  configJson["debugSerialEnabled"] = _debugSerialEnabled;
+  configJson["debugRemoteEnabled"] = _debugRemoteEnabled;
+}
+
+void EspNode::_configFromJson(JsonDocument &configJson)
+{
+  // Read node configuration
+  if (!configJson["nodeName"].isNull())
   {
-    debugPrintln(F("SPIFFS: Failed to open config file for writing"));
+    snprintf(_nodeName, sizeof(_nodeName), "%s", configJson["nodeName"] | "");
   }
-  else
+  if (!configJson["configUser"].isNull())
+  {
+    snprintf(_configUser, sizeof(_configUser), "%s", configJson["configUser"] | "");
+  }
+  if (!configJson["configPassword"].isNull() && strcmp(configJson["configPassword"] | "", MASKED_PASSWORD) != 0)
   {
-    serializeJson(jsonConfigValues, configFile);
-    configFile.close();
+    snprintf(_configPassword, sizeof(_configPassword), "%s", configJson["configPassword"] | "");
+  }
 
-    // Print saved JSON configuration
-    String configJsonStr;
-    serializeJson(jsonConfigValues, configJsonStr);
+  // Read MQTT configuration
+  if (!configJson["mqttServer"].isNull())
+  {
+    snprintf(_mqttServer, sizeof(_mqttServer), "%s", configJson["mqttServer"] | "");
+  }
+  if (!configJson["mqttPort"].isNull())
+  {
+    _mqttPort = configJson["mqttPort"];
+  }
+  if (!configJson["mqttUser"].isNull())
+  {
+    snprintf(_mqttUser, sizeof(_mqttUser), "%s", configJson["mqttUser"] | "");
+  }
+  if (!configJson["mqttPassword"].isNull() && strcmp(configJson["mqttPassword"] | "", MASKED_PASSWORD) != 0)
+  {
+    snprintf(_mqttPassword, sizeof(_mqttPassword), "%s", configJson["mqttPassword"] | "");
+  }
+  if (!configJson["mqttTopic"].isNull())
+  {
+    snprintf(_mqttTopic, sizeof(_mqttTopic), "%s", configJson["mqttTopic"] | "");
+  }
 
-    debugPrintln(String(F("SPIFFS: saved json:")) + configJsonStr);
+  // Read Debug configuration
+  if (!configJson["debugSerialEnabled"].isNull())
+  {
+    _debugSerialEnabled = configJson["debugSerialEnabled"];
+  }
+  if (!configJson["debugRemoteEnabled"].isNull())
+  {
+    _debugRemoteEnabled = configJson["debugRemoteEnabled"];
   }
+}
 
-  // Call save callbacks
-  for (int i = 0; i < CALLBACK_CNT; i++)
+bool EspNode::_configRecordRead(const char *name, uint16_t version, void *record, size_t size, uint32_t maxGeneration)
+{
+  char path[CONFIG_RECORD_SLOT_CNT][CONFIG_RECORD_PATH_SIZE];
+  EspNodeConfigHeader header[CONFIG_RECORD_SLOT_CNT];
+  bool valid[CONFIG_RECORD_SLOT_CNT];
+
+  for (int slot = 0; slot < CONFIG_RECORD_SLOT_CNT; slot++)
+  {
+    snprintf(path[slot], sizeof(path[slot]), "/%s.%d", name, slot);
+    valid[slot] = _configSlotHeader(path[slot], version, size, maxGeneration, header[slot]);
+  }
+
+  // Try the newest committed slot first, the other one holds the previous copy
+  int newest = (valid[1] && (!valid[0] || header[1].generation > header[0].generation)) ? 1 : 0;
+
+  for (int i = 0; i < CONFIG_RECORD_SLOT_CNT; i++)
   {
-    if (_configSaveCallbacks[i] != nullptr)
+    int slot = (newest + i) % CONFIG_RECORD_SLOT_CNT;
+    if (!valid[slot])
     {
-      _configSaveCallbacks[i]();
+      continue;
+    }
+
+    // The CRC is checked before the record is touched, a failed slot leaves the defaults for the other one
+    if (!_configSlotCrc(path[slot], header[slot]))
+    {
+      debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] %s failed the CRC check"), path[slot]);
+      continue;
+    }
+
+    // Older versions are a prefix of the current record, the fields behind keep their defaults
+    File recordFile = SPIFFS.open(path[slot], "r");
+    bool loaded = recordFile && recordFile.seek(sizeof(EspNodeConfigHeader)) &&
+                  (recordFile.read((uint8_t *)record, header[slot].size) == header[slot].size);
+    recordFile.close();
+
+    if (!loaded)
+    {
+      debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Failed to read %s"), path[slot]);
+      continue;
     }
+
+    if (i != 0)
+    {
+      debugLog(DEBUG_LEVEL_WARN, PSTR("SPIFFS: [WARNING] Record '%s' restored from previous copy"), name);
+    }
+    if (header[slot].version < version)
+    {
+      debugLog(DEBUG_LEVEL_INFO, PSTR("SPIFFS: Migrating %s from v%u to v%u"), path[slot], header[slot].version, version);
+    }
+    return true;
   }
 
-  delay(500);
+  return false;
+}
+
+bool EspNode::_configRecordWrite(const char *name, uint16_t version, const void *record, size_t size, uint32_t generation)
+{
+  char path[CONFIG_RECORD_PATH_SIZE];
+  EspNodeConfigHeader header;
+  int target = 0;
+  uint32_t targetGeneration = UINT32_MAX;
+
+  // Write the shadow slot, the one not holding the newest copy. An uncommitted slot counts as free.
+  for (int slot = 0; slot < CONFIG_RECORD_SLOT_CNT; slot++)
+  {
+    snprintf(path, sizeof(path), "/%s.%d", name, slot);
+    uint32_t slotGeneration = _configSlotHeader(path, version, size, generation - 1, header) ? header.generation : 0;
+    if (slotGeneration < targetGeneration)
+    {
+      target = slot;
+      targetGeneration = slotGeneration;
+    }
+  }
+
+  snprintf(path, sizeof(path), "/%s.%d", name, target);
+  File recordFile = SPIFFS.open(path, "w");
+  if (!recordFile)
+  {
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Failed to open %s for writing"), path);
+    return false;
+  }
+
+  header.magic = CONFIG_RECORD_MAGIC;
+  header.version = version;
+  header.size = size;
+  header.generation = generation;
+  header.crc = _configCrc32(record, size);
+
+  bool written = (recordFile.write((const uint8_t *)&header, sizeof(header)) == sizeof(header)) &&
+                 (recordFile.write((const uint8_t *)record, size) == size);
+  recordFile.flush();
+  recordFile.close();
+
+  if (!written)
+  {
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Failed to write %s"), path);
+    return false;
+  }
+
+  debugLog(DEBUG_LEVEL_DEBUG, PSTR("SPIFFS: Wrote %s v%u gen %u, %u bytes"), path, version, generation, (unsigned int)size);
+  return true;
+}
+
+bool EspNode::_configSlotHeader(const char *path, uint16_t version, size_t size, uint32_t maxGeneration, EspNodeConfigHeader &header)
+{
+  if (!SPIFFS.exists(path))
+  {
+    return false;
+  }
+
+  File recordFile = SPIFFS.open(path, "r");
+  if (!recordFile)
+  {
+    return false;
+  }
+
+  // A torn write shows as a short file, the CRC is checked on load
+  bool valid = (recordFile.read((uint8_t *)&header, sizeof(header)) == sizeof(header)) &&
+               (header.magic == CONFIG_RECORD_MAGIC) && (header.version <= version) && (header.size <= size) &&
+               (header.generation <= maxGeneration) && (recordFile.size() == sizeof(header) + header.size);
+  recordFile.close();
+
+  return valid;
+}
+
+bool EspNode::_configSlotCrc(const char *path, const EspNodeConfigHeader &header)
+{
+  File recordFile = SPIFFS.open(path, "r");
+  if (!recordFile || !recordFile.seek(sizeof(EspNodeConfigHeader)))
+  {
+    return false;
+  }
+
+  // Streamed in chunks, the record itself may be larger than the stack should hold
+  uint8_t chunk[CONFIG_RECORD_CHUNK_SIZE];
+  uint32_t crc = 0;
+  size_t remaining = header.size;
+  while (remaining > 0)
+  {
+    size_t len = min(remaining, sizeof(chunk));
+    if (recordFile.read(chunk, len) != len)
+    {
+      break;
+    }
+    crc = _configCrc32(chunk, len, crc);
+    remaining -= len;
+  }
+  recordFile.close();
+
+  return (remaining == 0) && (crc == header.crc);
+}
+
+void EspNode::_configBatchBegin()
+{
+  _configBatch = true;
+  _configBatchCnt = 0;
+  _configBatchFailed = false;
+}
+
+bool EspNode::_configBatchCommit()
+{
+  _configBatch = false;
+
+  if (_configBatchFailed)
+  {
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("SPIFFS: [ERROR] Config not committed, keeping generation %u"), _configGeneration);
+    return false;
+  }
+  if (_configBatchCnt == 0)
+  {
+    return true;
+  }
+
+  // Writing the generation is the commit point, the records of this batch become visible at once
+  uint32_t generation = _configGeneration + 1;
+  if (!_configRecordWrite(CONFIG_COMMIT_RECORD, 1, &generation, sizeof(generation), generation))
+  {
+    return false;
+  }
+
+  _configGeneration = generation;
+  debugLog(DEBUG_LEVEL_INFO, PSTR("SPIFFS: Committed %u config records as generation %u"), _configBatchCnt, _configGeneration);
+  return true;
+}
+
+uint32_t EspNode::_configCrc32(const void *data, size_t len, uint32_t crc)
+{
+  // Bitwise CRC32 (IEEE 802.3), records are small and only checked on load and save.
+  // The CRC of a previous chunk continues over this one, 0 starts a new one.
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+
+  while (len--)
+  {
+    crc ^= *bytes++;
+    for (int i = 0; i < 8; i++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+
+  return ~crc;
 }
 
 void EspNode::_configClear(bool all)
@@ -611,8 +1459,7 @@ void EspNode::_wifiResetSettings()
 {
   debugPrintln(F("WIFI: Clearing WiFi settings..."));
 
-  WiFiManager wifiManager;
-  wifiManager.resetSettings();
+  espNodePortalReset();
 }
 
 void EspNode::_wifiConfig(String wifiSsid, String wifiPass)
@@ -626,23 +1473,75 @@ void EspNode::_wifiConfig(String wifiSsid, String wifiPass)
 
 void EspNode::_wifiSetup()
 {
-  WiFiManager wifiManager;
-  wifiManager.autoConnect(_uniqueNodeName);
+  // Connect or open the config portal once at boot, afterwards the state machine in _wifiLoop reconnects
+  espNodePortalConnect(_uniqueNodeName, RECONNECT_TO, CONNECT_TO);
+
+  WiFi.setAutoReconnect(false);
+
+  _wifiSetState(_wifiLinkUp() ? WIFI_STATE_CONNECTED : WIFI_STATE_DISCONNECTED);
+}
+
+bool EspNode::_wifiLinkUp()
+{
+  // Check WiFi is connected and that we have a valid IP
+  return (WiFi.status() == WL_CONNECTED) && ((uint32_t)WiFi.localIP() != 0);
+}
+
+void EspNode::_wifiSetState(EspNodeWifiState state)
+{
+  _wifiState = state;
+  _wifiStateMillis = millis();
 }
 
 void EspNode::_wifiLoop()
 {
-  while ((WiFi.status() != WL_CONNECTED) || (WiFi.localIP().toString() == "0.0.0.0"))
+  // Never blocks, every pass checks the state and moves on
+  switch (_wifiState)
   {
-    // Check WiFi is connected and that we have a valid IP, retry until we do.
+  case WIFI_STATE_CONNECTED:
+    if (!_wifiLinkUp())
+    {
+      debugPrintln(String(F("WIFI: Connection lost.")));
+
+      _wifiBackoffMillis = WIFI_BACKOFF_MIN;
+      _wifiSetState(WIFI_STATE_DISCONNECTED);
+    }
+    break;
 
-    if (WiFi.status() == WL_CONNECTED)
+  case WIFI_STATE_DISCONNECTED:
+    debugPrintln(String(F("WIFI: Reconnecting to ")) + WiFi.SSID() + String(F("...")));
+
+    WiFi.begin();
+    _wifiSetState(WIFI_STATE_CONNECTING);
+    break;
+
+  case WIFI_STATE_CONNECTING:
+    if (_wifiLinkUp())
     {
-      // If we're currently connected, disconnect so we can try again
+      debugPrintln(String(F("WIFI: Connected @ ")) + WiFi.localIP().toString());
+
+      _wifiBackoffMillis = WIFI_BACKOFF_MIN;
+      _wifiSetState(WIFI_STATE_CONNECTED);
+    }
+    else if ((millis() - _wifiStateMillis) >= (RECONNECT_TO * 1000))
+    {
+      // Back off exponentially, the jitter keeps nodes from retrying in lockstep after an AP outage
+      _wifiBackoffDelay = _wifiBackoffMillis + random(_wifiBackoffMillis / 2 + 1);
+      _wifiBackoffMillis = min(_wifiBackoffMillis * 2, WIFI_BACKOFF_MAX);
+
+      debugLog(DEBUG_LEVEL_WARN, PSTR("WIFI: Reconnection failed, retrying in %lu ms."), _wifiBackoffDelay);
+
       WiFi.disconnect();
+      _wifiSetState(WIFI_STATE_BACKOFF);
     }
+    break;
 
-    _wifiSetup();
+  case WIFI_STATE_BACKOFF:
+    if ((millis() - _wifiStateMillis) >= _wifiBackoffDelay)
+    {
+      _wifiSetState(WIFI_STATE_DISCONNECTED);
+    }
+    break;
   }
 }
 
@@ -658,7 +1557,9 @@ void EspNode::_webSetup()
     _webUpdateServer->setup(_webServer, String(F("/updateFw")));
   }
 
-  // Setup webserver
+  // Setup webserver, keep the header revalidating the static assets
+  const char *headerKeys[] = {"If-None-Match"};
+  _webServer->collectHeaders(headerKeys, 1);
 
   _webServer->on("/", [this]()
                  { this->_webHandleRoot(); });
@@ -668,6 +1569,28 @@ void EspNode::_webSetup()
                  { this->_webHandleSaveSettings(); });
   _webServer->on("/status", [this]()
                  { this->_webHandleStatus(); });
+  _webServer->on("/configExport", [this]()
+                 { this->_webHandleConfigExport(); });
+
+  // Pre-gzipped script and style shared with the config portal
+  _webServer->on(String(FPSTR(R_static_style)), [this]()
+                 { this->_webHandleStatic(HTTP_STATIC_STYLE_GZ, sizeof(HTTP_STATIC_STYLE_GZ), HTTP_HEAD_CT_CSS, HTTP_STATIC_STYLE_ETAG); });
+  _webServer->on(String(FPSTR(R_static_script)), [this]()
+                 { this->_webHandleStatic(HTTP_STATIC_SCRIPT_GZ, sizeof(HTTP_STATIC_SCRIPT_GZ), HTTP_HEAD_CT_JS, HTTP_STATIC_SCRIPT_ETAG); });
+
+  // Machine readable state for monitoring, apps add their own providers
+  webRegisterJsonProvider("status", [this](JsonObject json)
+                          { this->_webStatusToJson(json); });
+  webRegisterJsonProvider("config", [this](JsonObject json)
+                          { this->_configToJson(json); });
+
+  // Live state stream, fed with what the node and the apps publish
+#ifdef ESPNODE_WEB_ASYNC
+  _webServer->onEvents(String(F("/events")), String(_configUser), String(_configPassword), WEB_EVENTS_CLIENT_CNT);
+#else
+  _webServer->on(String(F("/events")), [this]()
+                 { this->_webHandleEvents(); });
+#endif
 
   _webServer->onNotFound([this]()
                          { this->_webHandleNotFound(); });
@@ -689,6 +1612,104 @@ void EspNode::_webCheckAuth()
   }
 }
 
+void EspNode::_webSendChunk(const char *content, size_t size)
+{
+  _webServer->sendContent(content, size);
+}
+
+EspNodeWebWriter::EspNodeWebWriter(EspNode *node) : _node(node)
+{
+}
+
+EspNodeWebWriter::~EspNodeWebWriter()
+{
+  free(_buffer);
+}
+
+size_t EspNodeWebWriter::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t EspNodeWebWriter::write(const uint8_t *buffer, size_t size)
+{
+  if (!_allocate())
+  {
+    // No buffer, send unbuffered
+    _node->_webSendChunk((const char *)buffer, size);
+    return size;
+  }
+
+  size_t written = 0;
+  while (written < size)
+  {
+    size_t part = min(size - written, (size_t)WEB_BUFFER_SIZE - _len);
+    memcpy(_buffer + _len, buffer + written, part);
+    _len += part;
+    written += part;
+
+    if (_len == (size_t)WEB_BUFFER_SIZE)
+    {
+      flush();
+    }
+  }
+
+  return written;
+}
+
+size_t EspNodeWebWriter::write_P(PGM_P content, size_t size)
+{
+  if (!_allocate())
+  {
+    // No buffer, send unbuffered in small pieces copied from flash
+    char part[64];
+    for (size_t written = 0; written < size; written += sizeof(part))
+    {
+      size_t partLen = min(size - written, sizeof(part));
+      memcpy_P(part, content + written, partLen);
+      _node->_webSendChunk(part, partLen);
+    }
+    return size;
+  }
+
+  // Copy straight from flash into the send buffer
+  size_t written = 0;
+  while (written < size)
+  {
+    size_t part = min(size - written, (size_t)WEB_BUFFER_SIZE - _len);
+    memcpy_P(_buffer + _len, content + written, part);
+    _len += part;
+    written += part;
+
+    if (_len == (size_t)WEB_BUFFER_SIZE)
+    {
+      flush();
+    }
+  }
+
+  return written;
+}
+
+void EspNodeWebWriter::flush()
+{
+  if (_len > 0)
+  {
+    _node->_webSendChunk(_buffer, _len);
+    _len = 0;
+  }
+}
+
+bool EspNodeWebWriter::_allocate()
+{
+  // Allocated with the first page and kept, pages are rendered without further allocations
+  if (_buffer == nullptr)
+  {
+    _buffer = (char *)malloc(WEB_BUFFER_SIZE);
+  }
+
+  return _buffer != nullptr;
+}
+
 void EspNode::_webHandleRootCallback(void *ptr)
 {
 }
@@ -723,26 +1744,87 @@ void EspNode::_webHandleSettings()
 
   webStartHttpMsg(String(F("Settings")), 200);
 
-  String httpMessage = "";
+  // One callback fills the placeholders of all settings fragments
+  WebTemplateCallback settingsValues = [this](const char *key, Print &out)
+  {
+    if (strcmp_P(key, PSTR("nodeName")) == 0)
+    {
+      out.print(_nodeName);
+    }
+    else if (strcmp_P(key, PSTR("wifiSsid")) == 0)
+    {
+      out.print(WiFi.SSID());
+    }
+    else if (strcmp_P(key, PSTR("wifiPass")) == 0)
+    {
+      out.print(MASKED_PASSWORD);
+    }
+    else if (strcmp_P(key, PSTR("configUser")) == 0)
+    {
+      out.print(_configUser);
+    }
+    else if (strcmp_P(key, PSTR("configPassword")) == 0)
+    {
+      out.print((_configPassword[0] != '\0') ? MASKED_PASSWORD : "");
+    }
+    else if (strcmp_P(key, PSTR("mqttServer")) == 0)
+    {
+      out.print(_mqttServer);
+    }
+    else if (strcmp_P(key, PSTR("mqttPort")) == 0)
+    {
+      out.print(_mqttPort);
+    }
+    else if (strcmp_P(key, PSTR("mqttUser")) == 0)
+    {
+      out.print(_mqttUser);
+    }
+    else if (strcmp_P(key, PSTR("mqttPassword")) == 0)
+    {
+      out.print((_mqttPassword[0] != '\0') ? MASKED_PASSWORD : "");
+    }
+    else if (strcmp_P(key, PSTR("mqttTopic")) == 0)
+    {
+      out.print((_mqttTopic[0] != '\0') ? _mqttTopic : _mqttNodeTopic);
+    }
+    else if (strcmp_P(key, PSTR("mqttStatus")) == 0)
+    {
+      out.print(_mqttClient->connected() ? F("connected") : F("diconnected"));
+    }
+    else if (strcmp_P(key, PSTR("debugSerialEnabled")) == 0)
+    {
+      out.print(_debugSerialEnabled ? '1' : '0');
+    }
+    else if (strcmp_P(key, PSTR("debugRemoteEnabled")) == 0)
+    {
+      out.print(_debugRemoteEnabled ? '1' : '0');
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  };
+
   webSendHttpContent(HTML_SETTINGS_FORM_START);
 
-  webSendHttpContent(HTML_SETTINGS_NODE_NAME, String(F("{nodeName}")), _nodeName);
+  webSendTemplate(HTML_SETTINGS_NODE_NAME, settingsValues);
 
-  webSendHttpContent(HTML_SETTINGS_WIFI_SSID, String(F("{wifiSsid}")), String(WiFi.SSID()));
-  webSendHttpContent(HTML_SETTINGS_WIFI_PASSWD, String(F("{wifiSsid}")), MASKED_PASSWORD);
+  webSendTemplate(HTML_SETTINGS_WIFI_SSID, settingsValues);
+  webSendTemplate(HTML_SETTINGS_WIFI_PASSWD, settingsValues);
 
-  webSendHttpContent(HTML_SETTINGS_ADMIN_USER, String(F("{configUser}")), String(_configUser));
-  webSendHttpContent(HTML_SETTINGS_ADMIN_PASSWD, String(F("{configPassword}")), (strlen(_configPassword) != 0) ? MASKED_PASSWORD : String(F("")));
+  webSendTemplate(HTML_SETTINGS_ADMIN_USER, settingsValues);
+  webSendTemplate(HTML_SETTINGS_ADMIN_PASSWD, settingsValues);
 
-  webSendHttpContent(HTML_SETTINGS_MQTT_SERVER, String(F("{mqttServer}")), String(_mqttServer));
-  webSendHttpContent(HTML_SETTINGS_MQTT_PORT, String(F("{mqttPort}")), String(_mqttPort));
-  webSendHttpContent(HTML_SETTINGS_MQTT_USER, String(F("{mqttUser}")), String(_mqttUser));
-  webSendHttpContent(HTML_SETTINGS_MQTT_PASSWD, String(F("{mqttPassword}")), (strlen(_mqttPassword) != 0) ? MASKED_PASSWORD : String(F("")));
-  webSendHttpContent(HTML_SETTINGS_MQTT_TOPIC, String(F("{mqttTopic}")), (strlen(_mqttTopic) != 0) ? String(_mqttTopic) : mqttGetDefaultTopic());
-  webSendHttpContent(HTML_SETTINGS_MQTT_STATUS, String(F("{mqttStatus}")), (_mqttClient->connected()) ? String(F("connected")) : String(F("diconnected")));
+  webSendTemplate(HTML_SETTINGS_MQTT_SERVER, settingsValues);
+  webSendTemplate(HTML_SETTINGS_MQTT_PORT, settingsValues);
+  webSendTemplate(HTML_SETTINGS_MQTT_USER, settingsValues);
+  webSendTemplate(HTML_SETTINGS_MQTT_PASSWD, settingsValues);
+  webSendTemplate(HTML_SETTINGS_MQTT_TOPIC, settingsValues);
+  webSendTemplate(HTML_SETTINGS_MQTT_STATUS, settingsValues);
 
-  webSendHttpContent(HTML_SETTINGS_DEBUG_SERIAL, String(F("{debugSerialEnabled}")), (_debugSerialEnabled ? String(F("1")) : String(F("0"))));
-  webSendHttpContent(HTML_SETTINGS_DEBUG_REMOTE, String(F("{debugRemoteEnabled}")), (_debugRemoteEnabled ? String(F("1")) : String(F("0"))));
+  webSendTemplate(HTML_SETTINGS_DEBUG_SERIAL, settingsValues);
+  webSendTemplate(HTML_SETTINGS_DEBUG_REMOTE, settingsValues);
 
   webSendHttpContent(HTML_SETTINGS_BTN_SAVE_FORM_END);
   webSendHttpContent(HTML_SETTINGS_BTN_BACK);
@@ -826,6 +1908,7 @@ void EspNode::_webHandleSaveSettings()
     configShouldSave = true;
 
     _webServer->arg(String(F("mqttTopic"))).toCharArray(_mqttTopic, 128);
+    _mqttBuildTopics();
   }
 
   // check if debug settings have changed
@@ -855,7 +1938,7 @@ void EspNode::_webHandleSaveSettings()
 
     if (configShouldSave)
     {
-      _configSave();
+      _configSetDirty(CONFIG_DIRTY_NODE);
     }
 
     if (shouldSaveWifi)
@@ -875,63 +1958,361 @@ void EspNode::_webHandleSaveSettings()
     webEndHttpMsg();
   }
 
-  debugPrintln(String(F("HTTP: WebHandleSaveSettings page sent.")));
+  debugPrintln(String(F("HTTP: WebHandleSaveSettings page sent.")));
+}
+
+void EspNode::_webHandleStatus()
+{
+  debugPrintln(String(F("HTTP: WebHandleStatus called from client: ")) + _webServer->client().remoteIP().toString());
+
+  webStartHttpMsg(String(F("Status")), 200);
+
+  // One callback fills the placeholders of all status fragments
+  WebTemplateCallback statusValues = [this](const char *key, Print &out)
+  {
+    if (strcmp_P(key, PSTR("firmwareName")) == 0)
+    {
+      out.print(_fwName);
+    }
+    else if (strcmp_P(key, PSTR("firmwareVersion")) == 0)
+    {
+      out.print(_fwVersion);
+    }
+    else if (strcmp_P(key, PSTR("cpuFreq")) == 0)
+    {
+      out.print(ESP.getCpuFreqMHz());
+    }
+    else if (strcmp_P(key, PSTR("sketchSize")) == 0)
+    {
+      out.print(ESP.getSketchSize());
+    }
+    else if (strcmp_P(key, PSTR("freeSketchSize")) == 0)
+    {
+      out.print(ESP.getFreeSketchSpace());
+    }
+    else if (strcmp_P(key, PSTR("freeHeap")) == 0)
+    {
+      out.print(ESP.getFreeHeap());
+    }
+    else if (strcmp_P(key, PSTR("ipAddr")) == 0)
+    {
+      out.print(WiFi.localIP().toString());
+    }
+    else if (strcmp_P(key, PSTR("sigStrength")) == 0)
+    {
+      out.print(WiFi.RSSI());
+    }
+    else if (strcmp_P(key, PSTR("mqttQueue")) == 0)
+    {
+      out.print(_mqttQueueCnt);
+      out.print('/');
+      out.print(MQTT_QUEUE_CNT);
+      out.print(F(" queued, "));
+      out.print(_mqttQueueDropped);
+      out.print(F(" dropped"));
+    }
+    else if (strcmp_P(key, PSTR("debugLog")) == 0)
+    {
+      out.print(_debugDropped);
+      out.print(F(" dropped, "));
+      out.print(_debugRemoteBatchLen);
+      out.print(F(" bytes batched"));
+    }
+    else if (strcmp_P(key, PSTR("uptime")) == 0)
+    {
+      out.print(millis() / 1000);
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  };
+
+  webSendTemplate(HTML_STATUS_FW_NAME, statusValues);
+  webSendTemplate(HTML_STATUS_FW_VERSION, statusValues);
+  webSendHttpContent(HTML_STATUS_FW_FORM);
+  webSendTemplate(HTML_STATUS_CPU, statusValues);
+  webSendTemplate(HTML_STATUS_SKETCH_SIZE, statusValues);
+  webSendTemplate(HTML_STATUS_SKETCH_FREESIZE, statusValues);
+  webSendTemplate(HTML_STATUS_HEAP, statusValues);
+  webSendTemplate(HTML_STATUS_IPADDR, statusValues);
+  webSendTemplate(HTML_STATUS_SIGSTRENGTH, statusValues);
+  webSendTemplate(HTML_STATUS_MQTT_QUEUE, statusValues);
+  webSendTemplate(HTML_STATUS_DEBUG_LOG, statusValues);
+  webSendTemplate(HTML_STATUS_UPTIME, statusValues);
+
+  webSendHttpContent(HTML_STATUS_TASKS);
+  for (int i = 0; i < _taskCnt; i++)
+  {
+    EspNodeTask &task = _tasks[i];
+    webSendTemplate(HTML_STATUS_TASK, [&task](const char *key, Print &out)
+                    {
+                      if (strcmp_P(key, PSTR("taskName")) == 0)
+                      {
+                        out.print(task.name);
+                      }
+                      else if (strcmp_P(key, PSTR("taskStats")) == 0)
+                      {
+                        if (task.periodMillis == TASK_EVENT)
+                        {
+                          out.print(F("event"));
+                        }
+                        else
+                        {
+                          out.print(task.periodMillis);
+                        }
+                        out.print(F(" / "));
+                        out.print(task.runCount);
+                        out.print(F(" / "));
+                        out.print((task.runCount > 0) ? (task.totalMicros / task.runCount) : 0);
+                        out.print(F(" / "));
+                        out.print(task.maxMicros);
+                        out.print(F(" / "));
+                        out.print(task.deadlineMisses);
+                      }
+                      else
+                      {
+                        return false;
+                      }
+                      return true; });
+  }
+
+  webSendHttpContent(HTML_STATUS_BTN_BACK);
+
+  webEndHttpMsg();
+
+  debugPrintln(String(F("HTTP: WebHandleStatus page sent.")));
+}
+
+void EspNode::_webHandleConfigExport()
+{
+  debugPrintln(String(F("HTTP: WebHandleConfigExport called from client: ")) + _webServer->client().remoteIP().toString());
+
+  if (_configPassword[0] != '\0' && !_webServer->authenticate(_configUser, _configPassword))
+  {
+    return _webServer->requestAuthentication();
+  }
+
+  // JSON view of the binary node config, uploading it as /config.json imports it on next boot
+  StaticJsonDocument<CONFIG_NODE_DOC_SIZE> configJson;
+  _configToJson(configJson.to<JsonObject>());
+
+  _webServer->sendHeader(String(F("Content-Disposition")), String(F("attachment; filename=config.json")));
+  _webSendJson(configJson);
+}
+
+void EspNode::_webHandleJson(const WebJsonProvider &provider)
+{
+  debugLog(DEBUG_LEVEL_DEBUG, PSTR("HTTP: WebHandleJson %s called from client: %s"), _webServer->uri().c_str(), _webServer->client().remoteIP().toString().c_str());
+
+  if (_configPassword[0] != '\0' && !_webServer->authenticate(_configUser, _configPassword))
+  {
+    return _webServer->requestAuthentication();
+  }
+
+  // Fixed size document on the stack, providers add strings as const char * so they are referenced, not copied
+  StaticJsonDocument<WEB_JSON_DOC_SIZE> json;
+  provider(json.to<JsonObject>());
+
+  _webSendJson(json);
+}
+
+void EspNode::_webSendJson(JsonDocument &json)
+{
+  if (json.overflowed())
+  {
+    debugLog(DEBUG_LEVEL_WARN, PSTR("HTTP: JSON response of %s truncated, document is too small."), _webServer->uri().c_str());
+  }
+
+  // The length is known up front, so the body goes out unchunked through the send buffer
+  _webServer->setContentLength(measureJson(json));
+  _webServer->send(200, String(F("application/json")), String());
+
+  serializeJson(json, _webWriter);
+  _webWriter.flush();
+
+  _webServer->setContentLength(CONTENT_LENGTH_NOT_SET);
+}
+
+void EspNode::_webStatusToJson(JsonObject json)
+{
+  // Same values as the status page, without the markup and the upload form
+  json["firmwareName"] = (const char *)_fwName;
+  json["firmwareVersion"] = (const char *)_fwVersion;
+  json["nodeName"] = (const char *)_uniqueNodeName;
+  json["cpuFreq"] = ESP.getCpuFreqMHz();
+  json["sketchSize"] = ESP.getSketchSize();
+  json["freeSketchSize"] = ESP.getFreeSketchSpace();
+  json["freeHeap"] = ESP.getFreeHeap();
+  json["ipAddr"] = WiFi.localIP().toString();
+  json["sigStrength"] = WiFi.RSSI();
+  json["mqttConnected"] = _mqttClient->connected();
+  json["mqttQueue"] = _mqttQueueCnt;
+  json["mqttQueueDropped"] = _mqttQueueDropped;
+  json["debugDropped"] = _debugDropped;
+  json["uptime"] = millis() / 1000;
+}
+
+void EspNode::_webHandleStatic(const uint8_t *content, size_t size, PGM_P type, PGM_P etag)
+{
+  // The assets never change within a firmware, the pages link them with their etag as version
+  _webServer->sendHeader(String(F("Cache-Control")), String(FPSTR(HTTP_HEAD_CACHE_IMMUTABLE)));
+  _webServer->sendHeader(String(F("ETag")), String(FPSTR(etag)));
+
+  if (strcmp_P(_webServer->header(String(F("If-None-Match"))).c_str(), etag) == 0)
+  {
+    _webServer->send(304);
+    return;
+  }
+
+  _webServer->sendHeader(String(F("Content-Encoding")), String(F("gzip")));
+  _webServer->send_P(200, type, (PGM_P)content, size);
+}
+
+void EspNode::_webHandleNotFound()
+{
+  debugPrintln(String(F("HTTP: WebHandleNotFound called from client: ")) + _webServer->client().remoteIP().toString());
+
+  webStartHttpMsg(String(F("File Not Found\n\n")), 404);
+  webSendHttpContent(String(F("URI: ")));
+  webSendHttpContent(_webServer->uri());
+  webSendHttpContent(String(F("\nMethod: ")));
+  webSendHttpContent((_webServer->method() == HTTP_GET) ? String(F("GET")) : String(F("POST")));
+  webSendHttpContent(String(F("\nArguments: ")));
+  webSendHttpContent(String(_webServer->args()));
+  webSendHttpContent(String(F("\n")));
+
+  for (uint8_t i = 0; i < _webServer->args(); i++)
+  {
+    webSendHttpContent(" " + _webServer->argName(i) + ": " + _webServer->arg(i) + "\n");
+  }
+
+  webEndHttpMsg();
+
+  debugPrintln(String(F("HTTP: WebHandleNotFound page sent.")));
+}
+
+#ifndef ESPNODE_WEB_ASYNC
+void EspNode::_webHandleEvents()
+{
+  debugLog(DEBUG_LEVEL_DEBUG, PSTR("HTTP: WebHandleEvents called from client: %s"), _webServer->client().remoteIP().toString().c_str());
+
+  if (_configPassword[0] != '\0' && !_webServer->authenticate(_configUser, _configPassword))
+  {
+    return _webServer->requestAuthentication();
+  }
+
+  for (int i = 0; i < WEB_EVENTS_CLIENT_CNT; i++)
+  {
+    WiFiClient &client = _webEventClients[i];
+    if (!client.connected())
+    {
+      // Keep a reference to the connection, the server only drops its own when the handler returns
+      client = _webServer->client();
+      client.setNoDelay(true);
+      client.setTimeout(WEB_EVENTS_WRITE_TO);
+      client.print(F("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\nretry: 3000\n\n"));
+
+      debugLog(DEBUG_LEVEL_INFO, PSTR("HTTP: Event stream %d opened."), i);
+      return;
+    }
+  }
+
+  _webServer->send(503, "text/plain", String(F("Too many event streams")));
+}
+#endif
+
+bool EspNode::_webHasEventClients()
+{
+#ifdef ESPNODE_WEB_ASYNC
+  return _webServer->eventClientCnt() > 0;
+#else
+  for (int i = 0; i < WEB_EVENTS_CLIENT_CNT; i++)
+  {
+    if (_webEventClients[i].connected())
+    {
+      return true;
+    }
+  }
+
+  return false;
+#endif
 }
 
-void EspNode::_webHandleStatus()
+void EspNode::_webPublishEvent(const char *topic, const char *payload, bool state)
 {
-  debugPrintln(String(F("HTTP: WebHandleStatus called from client: ")) + _webServer->client().remoteIP().toString());
+  if (!_webHasEventClients())
+  {
+    _webEventsActive = false;
+    return;
+  }
 
-  webStartHttpMsg(String(F("Status")), 200);
+  if (!_webEventsActive)
+  {
+    // Pages opened since the last stream closed show the current state, compare against nothing
+    for (EspNodeTopic *interned = _mqttTopics; interned != nullptr; interned = interned->next)
+    {
+      interned->eventHash = 0;
+    }
+    _webEventsActive = true;
+  }
 
-  webSendHttpContent(HTML_STATUS_FW_NAME, String(F("{firmwareName}")), String(_fwName));
-  webSendHttpContent(HTML_STATUS_FW_VERSION, String(F("{firmwareVersion}")), String(_fwVersion));
-  webSendHttpContent(HTML_STATUS_FW_FORM);
-  webSendHttpContent(HTML_STATUS_CPU, String(F("{cpuFreq}")), String(ESP.getCpuFreqMHz()));
-  webSendHttpContent(HTML_STATUS_SKETCH_SIZE, String(F("{sketchSize}")), String(ESP.getSketchSize()));
-  webSendHttpContent(HTML_STATUS_SKETCH_FREESIZE, String(F("{freeSketchSize}")), String(ESP.getFreeSketchSpace()));
-  webSendHttpContent(HTML_STATUS_HEAP, String(F("{freeHeap}")), String(ESP.getFreeHeap()));
-  webSendHttpContent(HTML_STATUS_IPADDR, String(F("{ipAddr}")), String(WiFi.localIP().toString()));
-  webSendHttpContent(HTML_STATUS_SIGSTRENGTH, String(F("{sigStrength}")), String(WiFi.RSSI()));
-  unsigned long uptime = (millis() / 1000);
-  webSendHttpContent(HTML_STATUS_UPTIME, String(F("{uptime}")), String(uptime));
-  webSendHttpContent(HTML_STATUS_BTN_BACK);
+  if (state)
+  {
+    // Apps republish all their state on reconnects and commands, only changes are streamed
+    for (EspNodeTopic *interned = _mqttTopics; interned != nullptr; interned = interned->next)
+    {
+      if (interned->topic == topic)
+      {
+        uint32_t hash = _mqttCommandHash(payload);
+        if (hash == interned->eventHash)
+        {
+          return;
+        }
+        interned->eventHash = hash;
+        break;
+      }
+    }
+  }
 
-  webEndHttpMsg();
+  // Named by the sub topic below the node topic, foreign topics keep their full name
+  size_t nodeTopicLen = strlen(_mqttNodeTopic);
+  if (nodeTopicLen > 0 && strncmp(topic, _mqttNodeTopic, nodeTopicLen) == 0 && topic[nodeTopicLen] == '/')
+  {
+    topic += nodeTopicLen + 1;
+  }
 
-  debugPrintln(String(F("HTTP: WebHandleStatus page sent.")));
+  webSendEvent(topic, payload);
 }
 
-void EspNode::_webHandleNotFound()
+void EspNode::_webEventsLoop()
 {
-  debugPrintln(String(F("HTTP: WebHandleNotFound called from client: ")) + _webServer->client().remoteIP().toString());
-
-  webStartHttpMsg(String(F("File Not Found\n\n")), 404);
-  webSendHttpContent(String(F("URI: ")));
-  webSendHttpContent(_webServer->uri());
-  webSendHttpContent(String(F("\nMethod: ")));
-  webSendHttpContent((_webServer->method() == HTTP_GET) ? String(F("GET")) : String(F("POST")));
-  webSendHttpContent(String(F("\nArguments: ")));
-  webSendHttpContent(String(_webServer->args()));
-  webSendHttpContent(String(F("\n")));
-
-  for (uint8_t i = 0; i < _webServer->args(); i++)
+#ifndef ESPNODE_WEB_ASYNC
+  // A comment line keeps idle streams open and finds clients gone without a close
+  for (int i = 0; i < WEB_EVENTS_CLIENT_CNT; i++)
   {
-    webSendHttpContent(" " + _webServer->argName(i) + ": " + _webServer->arg(i) + "\n");
+    WiFiClient &client = _webEventClients[i];
+    if (client.connected() && client.write((const uint8_t *)":\n\n", 3) != 3)
+    {
+      client.stop();
+    }
   }
-
-  webEndHttpMsg();
-
-  debugPrintln(String(F("HTTP: WebHandleNotFound page sent.")));
+#endif
 }
 
 void EspNode::_webLoop()
 {
   _webServer->handleClient();
+#ifdef ESPNODE_WEB_ASYNC
+  _webUpdateServer->handle();
+#endif
 }
 
 void EspNode::_mqttSetup()
 {
+  _mqttBuildTopics();
+
   _mqttClient->begin(_mqttServer, _mqttPort, *_mqttWifiClient);
 
   _mqttClient->onMessage([this](String &topic, String &payload)
@@ -941,6 +2322,12 @@ void EspNode::_mqttSetup()
 
 void EspNode::_mqttConnect()
 {
+  // Skip while WiFi is down, a connect attempt would block until its timeout
+  if (!wifiIsConnected())
+  {
+    return;
+  }
+
   // Connect initially or reconnect if connection was lost
   if (!_mqttClient->connected())
   {
@@ -966,108 +2353,314 @@ void EspNode::_mqttConnect()
       if (_mqttClient->connected())
       {
         _mqttRetryMillis = 0;
-        _mqttAvailableMsgPending = true;
 
         debugPrintln(String(F("MQTT: Connection established to ")) + String(_mqttServer));
 
-        _mqttClient->subscribe(mqttGetNodeCmdTopic(F("#")));
+        _mqttBuildTopics();
+
+        if (_mqttAllCmdTopic[0] != '\0')
+        {
+          _mqttClient->subscribe(_mqttAllCmdTopic);
+        }
         _mqttClient->subscribe(mqttGetCommonNodesCmdTopic(F("#")));
+
+        // Announce from the loop, so callbacks registered by the app after setup() are included
+        taskTrigger(_mqttAvailableTaskId);
       }
       else
       {
         _mqttRetryMillis = millis();
 
-        debugPrintln(String(F("MQTT: Connection could not be established - failed with rc ")) + String(_mqttClient->returnCode()));
+        debugLog(DEBUG_LEVEL_WARN, PSTR("MQTT: Connection could not be established - failed with rc %d"), (int)_mqttClient->returnCode());
       }
     }
   }
 }
 
-bool EspNode::_mqttSend(String topic, String cmd)
+EspNodeTopic *EspNode::_mqttInternTopic(const char *subTopic, bool cmd)
 {
-  return _mqttClient->publish(topic, cmd);
+  EspNodeTopic *last = nullptr;
+  for (EspNodeTopic *topic = _mqttTopics; topic != nullptr; topic = topic->next)
+  {
+    if (topic->cmd == cmd && strcmp(topic->subTopic, subTopic) == 0)
+    {
+      return topic;
+    }
+    last = topic;
+  }
+
+  if (strlen(subTopic) >= MQTT_SUBTOPIC_SIZE)
+  {
+    debugPrintln(String(F("MQTT: Sub topic too long to intern - restarting: ")) + String(subTopic));
+    _nodeReset();
+  }
+
+  // Allocated once per sub topic and kept for the node's lifetime, handles stay valid across rebuilds
+  EspNodeTopic *topic = new EspNodeTopic();
+  snprintf(topic->subTopic, MQTT_SUBTOPIC_SIZE, "%s", subTopic);
+  topic->cmd = cmd;
+  topic->next = nullptr;
+  _mqttBuildTopic(topic);
+
+  if (last == nullptr)
+  {
+    _mqttTopics = topic;
+  }
+  else
+  {
+    last->next = topic;
+  }
+
+  return topic;
 }
 
-void EspNode::_mqttSendAvailableResend()
+bool EspNode::_mqttBuildTopic(EspNodeTopic *topic)
 {
-  _mqttAvailableMsgPending = true;
+  const char *cmdPart = topic->cmd ? "/cmd" : "";
+  const char *separator = (topic->subTopic[0] == '\0' || topic->subTopic[0] == '/') ? "" : "/";
+
+  int len = snprintf(topic->topic, MQTT_TOPIC_SIZE, "%s%s%s%s", _mqttNodeTopic, cmdPart, separator, topic->subTopic);
+  if (len < 0 || len >= MQTT_TOPIC_SIZE)
+  {
+    // A cut topic wouldn't match what the broker delivers, it stays empty and is never sent or subscribed
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("MQTT: [ERROR] Topic of '%s' exceeds %d chars, not used"), topic->subTopic, MQTT_TOPIC_SIZE - 1);
+    topic->topic[0] = '\0';
+    return false;
+  }
+
+  return true;
 }
 
-void EspNode::_mqttRcvCallback(String &topic, String &payload)
+void EspNode::_mqttBuildTopics()
 {
-  debugPrintln(String(F("MQTT: Message arrived on topic: '")) + topic + String(F("' with payload: '")) + payload + String(F("'.")));
-
-  if (topic.equals(mqttGetNodeCmdTopic(_mqttRebootSubTopic)))
+  // Same rules as mqttGetNodeTopic(), but built once instead of per call
+  int len;
+  if (_mqttTopic[0] != '\0')
   {
-    // standard command reset
-    if (payload.equals(_mqttSavePayload))
-    {
-      _configSave();
-    }
+    len = snprintf(_mqttNodeTopic, MQTT_TOPIC_SIZE, "%s", _mqttTopic);
+  }
+  else
+  {
+    len = snprintf(_mqttNodeTopic, MQTT_TOPIC_SIZE, "%s%s", _mqttDefaultTopicBase, _uniqueNodeName);
+  }
 
-    _nodeReset();
+  bool nodeTopicValid = (len >= 0 && len < MQTT_TOPIC_SIZE);
+  if (!nodeTopicValid)
+  {
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("MQTT: [ERROR] Node topic exceeds %d chars, no topic used"), MQTT_TOPIC_SIZE - 1);
   }
-  else if (topic.equals(mqttGetNodeCmdTopic(_mqttEnableSendSubTopic)))
+
+  snprintf(_mqttCommonCmdTopic, sizeof(_mqttCommonCmdTopic), "%scmd", _mqttDefaultTopicBase);
+
+  for (EspNodeTopic *topic = _mqttTopics; topic != nullptr; topic = topic->next)
   {
-    // standard command to enable/disable the sending of node specific payloads
-    // debug and availability will always be send
-    if (payload.equals(_mqttOnPayload))
-    {
-      _mqttSendEnabled = true;
-      _mqttSend(mqttGetNodeTopic(_mqttEnableSendSubTopic), payload);
-    }
-    else if (payload.equals(_mqttOffPayload))
+    if (nodeTopicValid)
     {
-      _mqttSendEnabled = false;
-      _mqttSend(mqttGetNodeTopic(_mqttEnableSendSubTopic), payload);
+      _mqttBuildTopic(topic);
     }
     else
     {
-      debugPrintln(String(F("MQTT: Unknown payload in topic - ")) + topic + String(F("#")) + payload + String(F("'.")));
+      topic->topic[0] = '\0';
     }
   }
-  else if (topic.equals(mqttGetNodeCmdTopic(_mqttEnableDebugSubTopic)))
+
+  // "<node topic>/cmd/#" without the wildcard, 0 if it was rejected
+  _mqttCmdPrefixLen = (_mqttAllCmdTopic[0] != '\0') ? strlen(_mqttAllCmdTopic) - 1 : 0;
+}
+
+bool EspNode::_mqttSend(const char *topic, const char *cmd)
+{
+  return _mqttEnqueue(topic, strlen(topic), cmd, strlen(cmd), true);
+}
+
+bool EspNode::_mqttPublish(const char *topic, const char *payload, size_t payloadLen)
+{
+  // Bypass the queue, used for debug output, oversize payloads and the final message before a reset
+  if (!_mqttClient->connected())
   {
-    // standard command to enable/disable the serial debug mode
-    if (payload.equals(_mqttOnPayload))
-    {
-      _debugSerialEnabled = true;
-      _mqttSend(mqttGetNodeTopic(_mqttEnableDebugSubTopic), payload);
-    }
-    else if (payload.equals(_mqttOffPayload))
+    return false;
+  }
+
+  return _mqttClient->publish(topic, payload, payloadLen);
+}
+
+bool EspNode::_mqttEnqueue(const char *topic, size_t topicLen, const char *payload, size_t payloadLen, bool coalesce)
+{
+  if (topicLen == 0)
+  {
+    // Rejected interned topic, reported when it was built
+    return false;
+  }
+
+  if (topicLen >= MQTT_TOPIC_SIZE)
+  {
+    _mqttQueueDropped++;
+
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("MQTT: [ERROR] Topic too long for queue, dropped - %.*s"), (int)topicLen, topic);
+    return false;
+  }
+
+  if (payloadLen >= MQTT_QUEUE_PAYLOAD_SIZE)
+  {
+    // Payloads up to MQTT_BUFFER are published right away, after the queued messages to keep the order
+    _mqttDrain(MQTT_QUEUE_CNT);
+    if (_mqttQueueCnt == 0 && _mqttPublish(topic, payload, payloadLen))
     {
-      _debugSerialEnabled = false;
-      _mqttSend(mqttGetNodeTopic(_mqttEnableDebugSubTopic), payload);
+      return true;
     }
-    else
+
+    _mqttQueueDropped++;
+
+    debugLog(DEBUG_LEVEL_ERROR, PSTR("MQTT: [ERROR] Message too long for queue and not sent, dropped - %.*s"), (int)topicLen, topic);
+    return false;
+  }
+
+  EspNodeMqttMsg *msg = nullptr;
+
+  if (coalesce)
+  {
+    // Last value wins for state topics, the message keeps its place in the queue
+    for (int i = 0; i < _mqttQueueCnt; i++)
     {
-      debugPrintln(String(F("MQTT: Unknown payload in topic - ")) + topic + String(F("#")) + payload + String(F("'.")));
+      EspNodeMqttMsg &queued = _mqttQueue[(_mqttQueueHead + i) % MQTT_QUEUE_CNT];
+      if (queued.coalesce && queued.topicLen == topicLen && memcmp(queued.topic, topic, topicLen) == 0)
+      {
+        msg = &queued;
+        break;
+      }
     }
   }
-  else if (topic.equals(mqttGetNodeCmdTopic(_mqttEnableRemoteDebugSubTopic)))
+
+  if (msg == nullptr)
   {
-    // standard command to enable/disable the remote debug mode
-    if (payload.equals(_mqttOnPayload))
+    if (_mqttQueueCnt >= MQTT_QUEUE_CNT)
     {
-      _debugRemoteEnabled = true;
-      _mqttSend(mqttGetNodeTopic(_mqttEnableRemoteDebugSubTopic), payload);
+      // Queue is full, drop the oldest message
+      _mqttQueueHead = (_mqttQueueHead + 1) % MQTT_QUEUE_CNT;
+      _mqttQueueCnt--;
+      _mqttQueueDropped++;
     }
-    else if (payload.equals(_mqttOffPayload))
+
+    msg = &_mqttQueue[(_mqttQueueHead + _mqttQueueCnt) % MQTT_QUEUE_CNT];
+    _mqttQueueCnt++;
+
+    memcpy(msg->topic, topic, topicLen);
+    msg->topic[topicLen] = '\0';
+    msg->topicLen = topicLen;
+    msg->coalesce = coalesce;
+  }
+
+  memcpy(msg->payload, payload, payloadLen);
+  msg->payload[payloadLen] = '\0';
+  msg->payloadLen = payloadLen;
+
+  return true;
+}
+
+void EspNode::_mqttDrain(int maxCnt)
+{
+  for (int i = 0; i < maxCnt && _mqttQueueCnt > 0; i++)
+  {
+    EspNodeMqttMsg &msg = _mqttQueue[_mqttQueueHead];
+    if (!_mqttClient->publish(msg.topic, msg.payload, msg.payloadLen))
     {
-      _debugRemoteEnabled = false;
-      _mqttSend(mqttGetNodeTopic(_mqttEnableRemoteDebugSubTopic), payload);
+      if (!_mqttClient->connected())
+      {
+        // Connection lost, keep the message for the retry after reconnect
+        return;
+      }
+
+      // Rejected on a working connection, dropping it keeps the queue moving
+      _mqttQueueDropped++;
+
+      debugLog(DEBUG_LEVEL_ERROR, PSTR("MQTT: [ERROR] Message rejected by client, dropped - %s"), msg.topic);
     }
-    else
+
+    _mqttQueueHead = (_mqttQueueHead + 1) % MQTT_QUEUE_CNT;
+    _mqttQueueCnt--;
+  }
+}
+
+uint32_t EspNode::_mqttCommandHash(const char *subTopic)
+{
+  // FNV-1a, cheap and well spread for short topic strings
+  uint32_t hash = 2166136261UL;
+  while (*subTopic != '\0')
+  {
+    hash ^= (uint8_t)*subTopic++;
+    hash *= 16777619UL;
+  }
+
+  return hash;
+}
+
+bool EspNode::_mqttDispatchCommand(String &topic, String &payload)
+{
+  if (_mqttCmdPrefixLen == 0 || topic.length() <= _mqttCmdPrefixLen || strncmp(topic.c_str(), _mqttAllCmdTopic, _mqttCmdPrefixLen) != 0)
+  {
+    return false;
+  }
+
+  const char *subTopic = topic.c_str() + _mqttCmdPrefixLen;
+  uint32_t hash = _mqttCommandHash(subTopic);
+
+  for (EspNodeCommand *command = _mqttCommands[hash & (MQTT_COMMAND_BUCKET_CNT - 1)]; command != nullptr; command = command->next)
+  {
+    if (command->hash == hash && strcmp(command->topic->subTopic, subTopic) == 0)
     {
-      debugPrintln(String(F("MQTT: Unknown payload in topic - ")) + topic + String(F("#")) + payload + String(F("'.")));
+      command->handler(payload);
+      return true;
     }
   }
-  else if (topic.equals(mqttGetCommonNodesCmdTopic("")))
+
+  return false;
+}
+
+void EspNode::_mqttCommandReboot(String &payload)
+{
+  // standard command reset
+  if (payload.equals(_mqttSavePayload))
+  {
+    _configSave();
+  }
+
+  _nodeReset();
+}
+
+void EspNode::_mqttCommandEnable(bool *enabled, const char *stateTopic, String &payload)
+{
+  // standard commands to enable/disable the sending of node specific payloads, serial and remote debug
+  // debug and availability will always be send
+  if (payload.equals(_mqttOnPayload))
+  {
+    *enabled = true;
+    _mqttSend(stateTopic, _mqttOnPayload);
+  }
+  else if (payload.equals(_mqttOffPayload))
+  {
+    *enabled = false;
+    _mqttSend(stateTopic, _mqttOffPayload);
+  }
+  else
+  {
+    debugPrintln(String(F("MQTT: Unknown payload in topic - ")) + String(stateTopic) + String(F("#")) + payload + String(F("'.")));
+  }
+}
+
+void EspNode::_mqttRcvCallback(String &topic, String &payload)
+{
+  debugPrintln(String(F("MQTT: Message arrived on topic: '")) + topic + String(F("' with payload: '")) + payload + String(F("'.")));
+
+  if (_mqttDispatchCommand(topic, payload))
+  {
+    return;
+  }
+
+  if (topic.equals(_mqttCommonCmdTopic))
   {
     // announce command to distribute the availabe messages again via mqtt (common topic)
     if (payload.equals(_mqttAnnouncePayload))
     {
-      _mqttSendAvailableResend();
       mqttSendAvailable(false);
     }
     else
@@ -1077,7 +2670,7 @@ void EspNode::_mqttRcvCallback(String &topic, String &payload)
   }
   else
   {
-    // delegate to handler if no standard command was triggered
+    // delegate to handler if no registered command matched
     for (int i = 0; i < CALLBACK_CNT; i++)
     {
       if (_mqttRcvCallbacks[i] != nullptr)
@@ -1091,7 +2684,127 @@ void EspNode::_mqttRcvCallback(String &topic, String &payload)
 void EspNode::_mqttLoop()
 {
   _mqttConnect();
-  mqttSendAvailable(false);
+
+  if (!_mqttClient->connected())
+  {
+    return;
+  }
 
   _mqttClient->loop();
-}
\ No newline at end of file
+  _mqttDrain(_mqttQueueDrainRate);
+}
+
+void EspNode::_taskSetup()
+{
+  // Register the node's own loops and events, apps add theirs after setup()
+  taskAdd("wifi", [this]()
+          { this->_wifiLoop(); },
+          100, 100, TASK_PRIO_HIGH);
+  taskAdd("mqtt", [this]()
+          { this->_mqttLoop(); },
+          0, 50, TASK_PRIO_HIGH);
+  taskAdd("web", [this]()
+          { this->_webLoop(); },
+          0, 250, TASK_PRIO_NORMAL);
+  taskAdd("events", [this]()
+          { this->_webEventsLoop(); },
+          WEB_EVENTS_KEEPALIVE_PERIOD, 1000, TASK_PRIO_LOW);
+  taskAdd("debug", [this]()
+          { this->_debugLoop(); },
+          DEBUG_DRAIN_PERIOD, 1000, TASK_PRIO_NORMAL);
+  taskAdd("config", [this]()
+          { this->_configLoop(); },
+          CONFIG_FLUSH_PERIOD, 1000, TASK_PRIO_LOW);
+  _mqttAvailableTaskId = taskAdd("available", [this]()
+                                 { this->mqttSendAvailable(false); },
+                                 TASK_EVENT, 1000, TASK_PRIO_NORMAL);
+}
+
+bool EspNode::_taskIsReady(EspNodeTask &task, unsigned long now)
+{
+  if (task.periodMillis == TASK_EVENT)
+  {
+    return task.triggered;
+  }
+
+  return ((long)(now - task.dueMillis) >= 0);
+}
+
+void EspNode::_taskRun(EspNodeTask &task)
+{
+  unsigned long startMillis = millis();
+  if ((startMillis - task.dueMillis) > task.deadlineMillis)
+  {
+    task.deadlineMisses++;
+  }
+
+  // Next due time keeps the period grid, unless the task fell behind by more than a period
+  if (task.periodMillis == TASK_EVENT)
+  {
+    task.triggered = false;
+  }
+  else if ((startMillis - task.dueMillis) >= task.periodMillis)
+  {
+    task.dueMillis = startMillis + task.periodMillis;
+  }
+  else
+  {
+    task.dueMillis += task.periodMillis;
+  }
+
+  unsigned long startMicros = micros();
+  task.callback();
+  unsigned long runMicros = micros() - startMicros;
+
+  task.runCount++;
+  task.totalMicros += runMicros;
+  if (runMicros > task.maxMicros)
+  {
+    task.maxMicros = runMicros;
+  }
+}
+
+void EspNode::_taskLoop()
+{
+  unsigned long now = millis();
+
+  for (int i = 0; i < _taskCnt; i++)
+  {
+    _taskReady[i] = _taskIsReady(_tasks[i], now);
+  }
+
+  // Run every ready task once, highest priority first and earliest deadline first within a priority
+  while (true)
+  {
+    int next = -1;
+    for (int i = 0; i < _taskCnt; i++)
+    {
+      if (!_taskReady[i])
+      {
+        continue;
+      }
+
+      if (next < 0 || _tasks[i].priority > _tasks[next].priority)
+      {
+        next = i;
+      }
+      else if (_tasks[i].priority == _tasks[next].priority)
+      {
+        unsigned long deadline = _tasks[i].dueMillis + _tasks[i].deadlineMillis;
+        unsigned long nextDeadline = _tasks[next].dueMillis + _tasks[next].deadlineMillis;
+        if ((long)(deadline - nextDeadline) < 0)
+        {
+          next = i;
+        }
+      }
+    }
+
+    if (next < 0)
+    {
+      break;
+    }
+
+    _taskReady[next] = false;
+    _taskRun(_tasks[next]);
+  }
+}
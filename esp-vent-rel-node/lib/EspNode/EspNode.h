@@ -18,10 +18,21 @@
 
 #include <EEPROM.h>
 #include <ArduinoJson.h>
-#include <WiFiManager.h>
 #include <MQTTClient.h>
 
 #ifdef ESP8266
+#include <ESP8266WiFi.h>
+#include <FS.h>
+#elif ESP32
+#include <WiFi.h>
+#include <SPIFFS.h>
+#endif
+
+#include <strings_en.h>
+
+#ifdef ESPNODE_WEB_ASYNC
+#include <EspNodeAsyncWeb.h>
+#elif ESP8266
 #include <ESP8266WebServer.h>
 #include <ESP8266HTTPUpdateServer.h>
 #elif ESP32
@@ -33,12 +44,52 @@
 
 const unsigned long CONNECT_TO = 300;         // Timeout for WiFi and MQTT connection attempts in seconds
 const unsigned long RECONNECT_TO = 15;        // Timeout for WiFi reconnection attempts in seconds
+const unsigned long WIFI_BACKOFF_MIN = 1000;  // Initial delay between failed WiFi reconnection attempts in ms
+const unsigned long WIFI_BACKOFF_MAX = 60000; // Max delay between failed WiFi reconnection attempts in ms
 const int CONFIG_SIZE = 10240;                // Configuration size
+const static int CONFIG_NODE_DOC_SIZE = 768;  // Size of the static document the node configuration is streamed into
+const uint32_t CONFIG_RECORD_MAGIC = 0x474E4345; // Magic of binary config records, "ECNG" little endian
+const static int CONFIG_RECORD_PATH_SIZE = 32; // Max path size of a binary config record, including termination
+const static int CONFIG_RECORD_SLOT_CNT = 2;  // Number of slots per record, saves go to the slot not holding the current copy
+const static int CONFIG_RECORD_CHUNK_SIZE = 32; // Bytes per read while a record's CRC is checked
+const char CONFIG_COMMIT_RECORD[] = "commit"; // Record name of the committed config generation
+const char CONFIG_NODE_RECORD[] = "node";     // Record name of the node configuration
+const uint16_t CONFIG_NODE_VERSION = 1;       // Schema version of the node configuration record
 const char MASKED_PASSWORD[] = "********";    // Masked password constant^
 const uint16_t MQTT_BUFFER = 4096;            // Size of buffer for incoming MQTT message
 const unsigned long MQTT_RETRY_DELAY = 10000; // Delay for reconnect
+const static int MQTT_QUEUE_CNT = 16;         // Number of messages in the outbound MQTT queue
+const static int MQTT_TOPIC_SIZE = 128;       // Max topic size of queued messages and interned topics, including termination
+const static int MQTT_SUBTOPIC_SIZE = 32;     // Max sub topic size of interned topics, including termination
+const static int MQTT_QUEUE_PAYLOAD_SIZE = 128; // Max payload size of a queued message, including termination, larger ones bypass the queue
+const uint8_t MQTT_QUEUE_DRAIN_RATE = 4;      // Default number of queued messages published per pass
+const static int MQTT_COMMAND_BUCKET_CNT = 16; // Number of hash buckets of the MQTT command table, a power of two
 const static int CALLBACK_CNT = 5;            // Max number of callbacks
+const uint8_t CONFIG_DIRTY_NODE = 1 << CALLBACK_CNT; // Dirty flag of the node configuration, the lower bits flag the save callbacks
+const unsigned long CONFIG_FLUSH_DELAY = 3000; // Quiet period after the last config change before it is written in ms
+const unsigned long CONFIG_FLUSH_PERIOD = 500; // Period of the config task checking for changes to write in ms
 const static int BUTTON_CNT = 5;              // Max number of buttons
+const static int TASK_CNT = 12;               // Max number of scheduled tasks
+const unsigned long TASK_EVENT = (unsigned long)-1; // Task period of event driven tasks, run only after taskTrigger()
+const uint8_t TASK_PRIO_LOW = 0;              // Task priority for slow polls (sensors, housekeeping)
+const uint8_t TASK_PRIO_NORMAL = 1;           // Task priority for regular work (web, debug)
+const uint8_t TASK_PRIO_HIGH = 2;             // Task priority for tight deadlines (buttons, mqtt keep-alive)
+const static int DEBUG_RING_SIZE = 2048;      // Size of the debug log ring buffer, drained by the debug task
+const static int DEBUG_LINE_SIZE = 160;       // Max size of a single formatted debug line, including time stamp
+const static int DEBUG_REMOTE_BATCH_SIZE = MQTT_BUFFER - MQTT_TOPIC_SIZE - 16; // Max payload size of a remote debug batch, leaves room for topic and header
+const unsigned long DEBUG_REMOTE_FLUSH_PERIOD = 2000; // Max age of the oldest line in a remote debug batch in ms
+const unsigned long DEBUG_DRAIN_PERIOD = 20;  // Period of the debug task draining the ring buffer in ms
+const static int WEB_BUFFER_SIZE = 1460;      // Size of the web send buffer, one TCP segment (MSS) per chunk
+const static int WEB_TEMPLATE_KEY_SIZE = 32;  // Max size of a template placeholder name, including termination
+const static int WEB_JSON_DOC_SIZE = 1024;    // Size of the static document an API response is built in
+const static int WEB_EVENTS_CLIENT_CNT = 2;   // Max number of open /events streams, more are answered with 503
+const static int WEB_EVENTS_MSG_SIZE = MQTT_TOPIC_SIZE + MQTT_QUEUE_PAYLOAD_SIZE + 16; // Max size of a formatted event
+const unsigned long WEB_EVENTS_KEEPALIVE_PERIOD = 15000; // Period of the keep-alive comment on open /events streams in ms
+const unsigned long WEB_EVENTS_WRITE_TO = 100; // Max time a write to a stalled /events stream may block in ms
+const uint8_t DEBUG_LEVEL_ERROR = 0;          // Debug level for failures
+const uint8_t DEBUG_LEVEL_WARN = 1;           // Debug level for recoverable problems
+const uint8_t DEBUG_LEVEL_INFO = 2;           // Debug level for state changes, default
+const uint8_t DEBUG_LEVEL_DEBUG = 3;          // Debug level for hot paths, only formatted when enabled
 
 //***** HTML Text - Root *****//
 const char HTML_BUTTON[] PROGMEM = "<a href='{uri}'><button>{name}</button></a><hr>";
@@ -81,14 +132,118 @@ const char HTML_STATUS_SKETCH_FREESIZE[] PROGMEM = "<br/><b>Free Sketch Space: <
 const char HTML_STATUS_HEAP[] PROGMEM = "<br/><b>Heap Free: </b> {freeHeap}";
 const char HTML_STATUS_IPADDR[] PROGMEM = "<br/><b>IP Address: </b> {ipAddr}";
 const char HTML_STATUS_SIGSTRENGTH[] PROGMEM = "<br/><b>Signal Strength: </b> {sigStrength}";
+const char HTML_STATUS_MQTT_QUEUE[] PROGMEM = "<br/><b>MQTT Queue: </b> {mqttQueue}";
+const char HTML_STATUS_DEBUG_LOG[] PROGMEM = "<br/><b>Debug Log: </b> {debugLog}";
 const char HTML_STATUS_UPTIME[] PROGMEM = "<br/><b>Uptime: </b> {uptime} sec";
+const char HTML_STATUS_TASKS[] PROGMEM = "<hr><b>Tasks</b> <i><small>(period ms / runs / avg us / max us / deadline misses)</small></i>";
+const char HTML_STATUS_TASK[] PROGMEM = "<br/><b>{taskName}: </b> {taskStats}";
 const char HTML_STATUS_BTN_BACK[] PROGMEM = "<hr><a href='/'><button>Back</button></a>";
 
+enum EspNodeWifiState
+{
+  WIFI_STATE_DISCONNECTED, // Link is down, next pass starts a connection attempt
+  WIFI_STATE_CONNECTING,   // Connection attempt running, waiting for an IP
+  WIFI_STATE_CONNECTED,    // Link is up with a valid IP
+  WIFI_STATE_BACKOFF       // Connection attempt failed, waiting before the next one
+};
+
+struct EspNodeMqttMsg
+{
+  char topic[MQTT_TOPIC_SIZE];           // Topic of the message
+  char payload[MQTT_QUEUE_PAYLOAD_SIZE]; // Payload of the message
+  uint8_t payloadLen;                    // Length of the payload
+  uint8_t topicLen;                      // Length of the topic
+  bool coalesce;                         // Flag indicating a state message, replaced by newer messages on the same topic
+};
+
+struct EspNodeTopic
+{
+  char subTopic[MQTT_SUBTOPIC_SIZE]; // Sub topic as registered
+  bool cmd;                          // Flag indicating a command topic below <node topic>/cmd
+  char topic[MQTT_TOPIC_SIZE];       // Full topic, rebuilt in place when the node topic changes
+  uint32_t eventHash;                // Hash of the payload last streamed to /events, 0 if none
+  EspNodeTopic *next;                // Next interned topic
+};
+
+struct EspNodeConfigHeader
+{
+  uint32_t magic;      // CONFIG_RECORD_MAGIC
+  uint16_t version;    // Schema version of the record, newer versions only append fields
+  uint16_t size;       // Size of the record following the header
+  uint32_t generation; // Config generation the record was written in, only committed generations are loaded
+  uint32_t crc;        // CRC32 of the record
+} __attribute__((packed));
+
+struct EspNodeConfig
+{
+  char nodeName[32];
+  char configUser[32];
+  char configPassword[32];
+  char mqttServer[64];
+  int32_t mqttPort;
+  char mqttUser[32];
+  char mqttPassword[32];
+  char mqttTopic[128];
+  uint8_t debugSerialEnabled;
+  uint8_t debugRemoteEnabled;
+} __attribute__((packed));
+
 typedef void (*ConfigSaveCallback)();
 typedef void (*MQTTAvailableCallback)();
+typedef std::function<void(void)> TaskCallback;
+typedef std::function<void(String &payload)> MQTTCommandHandler;
+typedef std::function<bool(const char *key, Print &out)> WebTemplateCallback;
+typedef std::function<void(JsonObject json)> WebJsonProvider;
+
+struct EspNodeCommand
+{
+  EspNodeTopic *topic;        // Interned command topic, holds the sub topic used for matching
+  uint32_t hash;              // FNV-1a hash of the sub topic
+  MQTTCommandHandler handler; // Handler called with the payload
+  EspNodeCommand *next;       // Next command in the same bucket
+};
+
+struct EspNodeTask
+{
+  const char *name;             // Name of the task, shown on the status page
+  TaskCallback callback;        // Work of the task
+  unsigned long periodMillis;   // Period of the task, 0 runs it on every pass, TASK_EVENT only after a trigger
+  unsigned long deadlineMillis; // Allowed delay after the task got due, before it is counted as deadline miss
+  uint8_t priority;             // Priority of the task, higher priorities run first
+  unsigned long dueMillis;      // Timestamp the task gets due next
+  bool triggered;               // Flag indicating a pending trigger of an event driven task
+  unsigned long runCount;       // Number of runs
+  unsigned long totalMicros;    // Summed up run time
+  unsigned long maxMicros;      // Longest run time
+  unsigned long deadlineMisses; // Number of runs started after the deadline
+};
+
+class EspNode;
+
+class EspNodeWebWriter : public Print
+{
+public:
+  EspNodeWebWriter(EspNode *node);
+  ~EspNodeWebWriter();
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  size_t write_P(PGM_P content, size_t size);
+  void flush() override;
+
+private:
+  bool _allocate();
+
+  EspNode *_node;          // Node sending the chunks
+  char *_buffer = nullptr; // Send buffer of WEB_BUFFER_SIZE, allocated on first use
+  size_t _len = 0;         // Number of buffered bytes
+};
 
 class EspNode
 {
+  friend class EspNodeWebWriter;
+
 public:
   EspNode(char *nodeName, char *fwName, char *fwVersion);
   ~EspNode();
@@ -97,30 +252,57 @@ public:
   void loop();
 
   void debugPrintln(String debugText);
+  void debugLog(uint8_t level, PGM_P format, ...) __attribute__((format(printf, 3, 4)));
+  bool debugIsEnabled(uint8_t level);
+  void debugSetLevel(uint8_t level);
 
   File configOpenFile(const char *path, const char *mode);
+  bool configLoad(const char *path, JsonDocument &configJson, const JsonDocument *filter = nullptr);
+  bool configImport(const char *path, JsonDocument &configJson, const JsonDocument *filter = nullptr);
+  void configImportDone(const char *path);
+  bool configRecordLoad(const char *name, uint16_t version, void *record, size_t size);
+  bool configRecordSave(const char *name, uint16_t version, const void *record, size_t size);
   void configSaveAddCallback(ConfigSaveCallback callback);
+  void configSetDirty(ConfigSaveCallback callback);
 
   void webStartHttpMsg(String type, int code);
   void webStartHttpMsg(String type, String meta, int code);
   void webStartHttpMsg(String type, String meta, int code, String redirectUrl);
   void webSendHttpContent(String content, String find, String replace);
+  void webSendHttpContent(PGM_P content, const String &find, const String &replace);
   void webSendHttpContent(String content);
+  void webSendHttpContent(PGM_P content);
+  void webSendTemplate(PGM_P content, WebTemplateCallback callback);
   void webEndHttpMsg();
   String webGetArg(const String &name);
   void webAddButtonHandler(const String, const String buttonName);
   void webRegisterHandler(const Uri &uri, std::function<void(void)> handler);
+  void webRegisterJsonProvider(const char *name, WebJsonProvider provider);
+  void webSendEvent(const char *event, const char *data);
 
   String mqttGetDefaultTopic();
   String mqttGetNodeTopic(String subTopic);
   String mqttGetNodeCmdTopic(String subTopic);
+  const char *mqttInternNodeTopic(const char *subTopic);
+  const char *mqttInternNodeCmdTopic(const char *subTopic);
   String mqttGetCommonDefaultTopic();
   String mqttGetCommonNodesCmdTopic(String subTopic);
   String mqttGetOnOffPayload(bool on);
   bool mqttSendAvailable(bool reset);
   bool mqttSend(String topic, String cmd);
+  bool mqttSend(const char *topic, const char *cmd);
+  bool mqttSend(const char *topic, const String &cmd);
+  bool mqttSendEvent(String topic, String cmd);
+  bool mqttSendEvent(const char *topic, const char *cmd);
+  void mqttSetQueueDrainRate(uint8_t rate);
   void mqttAvailableAddCallback(MQTTAvailableCallback callback);
   void mqttRcvAddCallback(MQTTClientCallbackSimple callback);
+  const char *mqttOnCommand(const char *subTopic, MQTTCommandHandler handler);
+
+  bool wifiIsConnected();
+
+  int taskAdd(const char *name, TaskCallback callback, unsigned long periodMillis, unsigned long deadlineMillis, uint8_t priority);
+  void taskTrigger(int taskId);
 
 private:
   char _fwName[16] = "esp_node";                                                                         // Name of the firmware
@@ -131,27 +313,75 @@ private:
   char _configUser[32] = "admin";                                                                        // User name for web access - default value, may be overridden
   char _configPassword[32] = "";                                                                         // Password for web access - default value, may be overridden
   ConfigSaveCallback _configSaveCallbacks[CALLBACK_CNT] = {nullptr, nullptr, nullptr, nullptr, nullptr}; // Save callback array to dispatch save calls
+  uint32_t _configGeneration = 0;  // Last committed config generation
+  bool _configBatch = false;       // Flag indicating an open batch, record saves are committed together
+  uint8_t _configBatchCnt = 0;     // Number of records written in the open batch
+  bool _configBatchFailed = false; // Flag indicating a failed record write, the open batch won't be committed
+  uint8_t _configDirty = 0;             // Flags of the modules with unsaved changes, see CONFIG_DIRTY_NODE
+  unsigned long _configDirtyMillis = 0; // Timestamp of the last config change, restarts the quiet period
 
   void _nodeSetup();
   void _nodeReset();
 
   bool _debugSerialEnabled = true;  // Enable serial debug - default value, may be overridden
   bool _debugRemoteEnabled = false; // Enable remote debug - default value, may be overridden
+  uint8_t _debugLevel = DEBUG_LEVEL_INFO; // Max level of logged lines
+
+  char _debugRing[DEBUG_RING_SIZE];   // Formatted lines waiting for output, separated by '\n'
+  unsigned long _debugWritePos = 0;   // Absolute write position in the ring, the index is pos % size
+  unsigned long _debugSerialPos = 0;  // Absolute read position of the serial output
+  unsigned long _debugRemotePos = 0;  // Absolute read position of the remote output
+  unsigned long _debugDropped = 0;    // Number of lines dropped, because the outputs fell behind
+  char *_debugRemoteBatch = nullptr;  // Lines collected for the next remote publish, allocated on first use
+  size_t _debugRemoteBatchLen = 0;    // Length of the collected lines
+  unsigned long _debugRemoteBatchMillis = 0; // Timestamp of the oldest line in the batch
+  bool _debugRemoteUrgent = false;    // Flag indicating an error line, which flushes the batch with the next drain
+  unsigned long _debugRemoteDropped = 0; // Number of batched lines dropped since the last successful publish
+  bool _debugDeferred = false;        // Flag indicating, that the debug task drains the ring, set after setup
 
   void _debugSetup();
   void _debugSetupFinalize();
+  void _debugWrite(uint8_t level, const char *line, size_t len);
+  void _debugDrain(bool all);
+  void _debugDrainSerial(bool all);
+  void _debugDrainRemote(bool all);
+  bool _debugFlushRemote();
+  void _debugDropRemote(size_t len);
   void _debugLoop();
 
   void _configRead();
   void _configSave();
+  void _configSetDirty(uint8_t flags);
+  void _configFlush();
+  void _configLoop();
+  bool _configSaveRecord();
+  void _configToJson(JsonObject configJson);
+  void _configFromJson(JsonDocument &configJson);
+  bool _configRecordRead(const char *name, uint16_t version, void *record, size_t size, uint32_t maxGeneration);
+  bool _configRecordWrite(const char *name, uint16_t version, const void *record, size_t size, uint32_t generation);
+  bool _configSlotHeader(const char *path, uint16_t version, size_t size, uint32_t maxGeneration, EspNodeConfigHeader &header);
+  bool _configSlotCrc(const char *path, const EspNodeConfigHeader &header);
+  void _configBatchBegin();
+  bool _configBatchCommit();
+  static uint32_t _configCrc32(const void *data, size_t len, uint32_t crc = 0);
   void _configClear(bool all);
 
+  EspNodeWifiState _wifiState = WIFI_STATE_DISCONNECTED; // State of the WiFi reconnect state machine
+  unsigned long _wifiStateMillis = 0;                    // Timestamp the current WiFi state was entered
+  unsigned long _wifiBackoffMillis = WIFI_BACKOFF_MIN;   // Backoff for the next failed WiFi reconnection attempt
+  unsigned long _wifiBackoffDelay = 0;                   // Jittered delay of the current WiFi backoff
+
   void _wifiResetSettings();
   void _wifiConfig(String wifiSsid, String wifiPass);
   void _wifiSetup();
+  bool _wifiLinkUp();
+  void _wifiSetState(EspNodeWifiState state);
   void _wifiLoop();
 
-#ifdef ESP8266
+#ifdef ESPNODE_WEB_ASYNC
+  EspNodeAsyncWebServer *_webServer;
+  EspNodeAsyncUpdateServer *_webUpdateServer;
+#elif ESP8266
   ESP8266WebServer *_webServer;
   ESP8266HTTPUpdateServer *_webUpdateServer;
 #elif ESP32
@@ -161,15 +391,32 @@ private:
 #error "Wrong board - ESP8266 or ESP32 must be used."
 #endif
   String _webButtons[BUTTON_CNT] = {"", "", "", "", ""};
+  EspNodeWebWriter _webWriter{this}; // Buffered writer of the current response, sends MSS sized chunks
+#ifndef ESPNODE_WEB_ASYNC
+  WiFiClient _webEventClients[WEB_EVENTS_CLIENT_CNT]; // Open /events streams, taken over from the web server
+#endif
+  bool _webEventsActive = false; // Flag indicating streams were open on the last published event
 
   void _webSetup();
   void _webCheckAuth();
+  void _webSendChunk(const char *content, size_t size);
   static void _webHandleRootCallback(void *ptr);
   void _webHandleRoot();
   void _webHandleSettings();
   void _webHandleSaveSettings();
   void _webHandleStatus();
+  void _webHandleConfigExport();
+  void _webHandleStatic(const uint8_t *content, size_t size, PGM_P type, PGM_P etag);
+  void _webHandleJson(const WebJsonProvider &provider);
+  void _webSendJson(JsonDocument &json);
+  void _webStatusToJson(JsonObject json);
   void _webHandleNotFound();
+#ifndef ESPNODE_WEB_ASYNC
+  void _webHandleEvents();
+#endif
+  bool _webHasEventClients();
+  void _webPublishEvent(const char *topic, const char *payload, bool state);
+  void _webEventsLoop();
   void _webLoop();
 
   WiFiClient *_mqttWifiClient;
@@ -188,22 +435,60 @@ private:
   const char _mqttDebugSubTopic[10] = "debug/log";                // MQTT debug remote subtopic for printing logs
   const char _mqttEnableDebugSubTopic[13] = "debug/serial";       // MQTT enable debug serial subtopic
   const char _mqttEnableRemoteDebugSubTopic[13] = "debug/remote"; // MQTT enable debug remote subtopic
+  const char _mqttDebugLevelSubTopic[12] = "debug/level";         // MQTT debug level subtopic
   const char _mqttOnPayload[3] = "on";
   const char _mqttOffPayload[4] = "off";
   const char _mqttSavePayload[5] = "save";
   const char _mqttAnnouncePayload[9] = "announce";
 
   boolean _mqttSendEnabled = true;                                                                          // MQTT flad indicating, if node specific payloads will be send
-  boolean _mqttAvailableMsgPending = false;                                                                 // MQTT flag indicating if availability status is pending
   MQTTAvailableCallback _mqttAvailableCallbacks[CALLBACK_CNT] = {nullptr, nullptr, nullptr, nullptr, nullptr}; // MQTT available callback array to dispatch available behaviour
-  MQTTClientCallbackSimple _mqttRcvCallbacks[CALLBACK_CNT] = {nullptr, nullptr, nullptr, nullptr, nullptr}; // MQTT callback array to dispatch received messages
+  MQTTClientCallbackSimple _mqttRcvCallbacks[CALLBACK_CNT] = {nullptr, nullptr, nullptr, nullptr, nullptr}; // MQTT callback array to dispatch received messages, fallback for unregistered commands
+  EspNodeCommand *_mqttCommands[MQTT_COMMAND_BUCKET_CNT] = {};                                              // MQTT command table, hashed by sub topic below <node topic>/cmd
 
   void _mqttSetup();
+  EspNodeTopic *_mqttInternTopic(const char *subTopic, bool cmd);
+  bool _mqttBuildTopic(EspNodeTopic *topic);
+  void _mqttBuildTopics();
   void _mqttConnect();
-  bool _mqttSend(String topic, String cmd);
-  void _mqttSendAvailableResend();
+  EspNodeMqttMsg _mqttQueue[MQTT_QUEUE_CNT];            // Outbound message ring buffer
+  int _mqttQueueHead = 0;                               // Index of the oldest queued message
+  int _mqttQueueCnt = 0;                                // Number of queued messages
+  unsigned long _mqttQueueDropped = 0;                  // Number of messages dropped due to a full queue or oversize
+  uint8_t _mqttQueueDrainRate = MQTT_QUEUE_DRAIN_RATE; // Number of queued messages published per pass
+  int _mqttAvailableTaskId = -1;                        // Event task announcing the availability after connect
+
+  EspNodeTopic *_mqttTopics = nullptr;        // Interned topics, allocated once and never freed
+  char _mqttNodeTopic[MQTT_TOPIC_SIZE] = "";  // Node topic all interned topics are built on
+  char _mqttCommonCmdTopic[16] = "";          // Common command topic of all nodes
+  const char *_mqttAvailableTopic;            // Interned topic handles of the node's own topics
+  const char *_mqttDebugTopic;
+  const char *_mqttEnableSendTopic;
+  const char *_mqttEnableDebugTopic;
+  const char *_mqttEnableRemoteDebugTopic;
+  const char *_mqttDebugLevelTopic;
+  const char *_mqttAllCmdTopic;
+  size_t _mqttCmdPrefixLen = 0;               // Length of "<node topic>/cmd/", stripped before the command lookup
+
+  bool _mqttSend(const char *topic, const char *cmd);
+  bool _mqttPublish(const char *topic, const char *payload, size_t payloadLen);
+  bool _mqttEnqueue(const char *topic, size_t topicLen, const char *payload, size_t payloadLen, bool coalesce);
+  void _mqttDrain(int maxCnt);
+  uint32_t _mqttCommandHash(const char *subTopic);
+  bool _mqttDispatchCommand(String &topic, String &payload);
+  void _mqttCommandReboot(String &payload);
+  void _mqttCommandEnable(bool *enabled, const char *stateTopic, String &payload);
   void _mqttRcvCallback(String &topic, String &payload);
   void _mqttLoop();
+
+  EspNodeTask _tasks[TASK_CNT]; // Registered tasks
+  int _taskCnt = 0;             // Number of registered tasks
+  bool _taskReady[TASK_CNT];    // Flags indicating the tasks, which are ready and not run yet within the current pass
+
+  void _taskSetup();
+  bool _taskIsReady(EspNodeTask &task, unsigned long now);
+  void _taskRun(EspNodeTask &task);
+  void _taskLoop();
 };
 
 #endif
\ No newline at end of file
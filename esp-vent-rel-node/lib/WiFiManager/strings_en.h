@@ -115,6 +115,129 @@ const char HTTP_STYLE[]            PROGMEM = "<style>"
 ":disabled {opacity: 0.5;}"
 "</style>";
 
+// static assets, HTTP_STYLE and HTTP_SCRIPT without their tags gzipped once (gzip -9n) and served from /static/*
+// regenerate both arrays and their etags (crc32 of the gzipped bytes) whenever the plain strings above change
+// the script also carries the live state subscriber, appended to HTTP_SCRIPT before gzipping:
+// window.addEventListener('load',function(){var n=document.querySelectorAll('[data-ev]');if(!n.length||!window.EventSource)return;var s=new EventSource('/events');n.forEach(function(e){s.addEventListener(e.getAttribute('data-ev'),function(m){if('value' in e)e.value=m.data;else e.textContent=m.data;});});});
+const char HTTP_STATIC_STYLE_ETAG[]  PROGMEM = "\"5d9073eb\"";
+const uint8_t HTTP_STATIC_STYLE_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xad, 0x56, 0xe9, 0x6f, 0xe2, 0x38,
+  0x14, 0xff, 0x57, 0xb2, 0x1a, 0x8d, 0x68, 0xc5, 0x15, 0x48, 0x02, 0x21, 0x68, 0xa4, 0x85, 0x00,
+  0x1d, 0x0a, 0xb4, 0x1c, 0xe5, 0x68, 0x57, 0xfd, 0xe0, 0xc4, 0x26, 0x31, 0x24, 0x71, 0xc8, 0xc1,
+  0xd1, 0x88, 0xff, 0x7d, 0xed, 0x24, 0x4c, 0xd3, 0x0e, 0x5b, 0xad, 0x56, 0x4b, 0x3e, 0x60, 0xbf,
+  0xf7, 0x7b, 0x87, 0xdf, 0xe1, 0xe7, 0x92, 0x5e, 0xd0, 0x08, 0x3c, 0x45, 0x01, 0x3a, 0x06, 0x45,
+  0x60, 0x61, 0xc3, 0x51, 0x74, 0xe4, 0x04, 0xc8, 0x6b, 0xae, 0x89, 0x13, 0x14, 0xd7, 0xc0, 0xc6,
+  0xd6, 0x49, 0xd9, 0x23, 0x0f, 0x02, 0x07, 0x9c, 0x21, 0xde, 0x17, 0xb0, 0xe3, 0x86, 0x41, 0xc1,
+  0x47, 0x16, 0xd2, 0x83, 0xc8, 0x05, 0x10, 0x62, 0xc7, 0x50, 0x24, 0xf7, 0x98, 0x08, 0xf8, 0xf8,
+  0x0d, 0x29, 0x15, 0x64, 0x37, 0x6d, 0xe0, 0x19, 0xd8, 0x61, 0x0c, 0x8e, 0x6f, 0x6a, 0xe4, 0xc8,
+  0x38, 0x0c, 0xa9, 0x11, 0x0f, 0x22, 0xaf, 0x48, 0x29, 0xe7, 0x44, 0x93, 0x16, 0x06, 0x01, 0x71,
+  0x52, 0x85, 0x85, 0x92, 0xed, 0x1b, 0x51, 0x8a, 0xf1, 0x00, 0xc4, 0xa1, 0xaf, 0x94, 0x04, 0x8f,
+  0xea, 0x3b, 0x60, 0x18, 0x98, 0x0a, 0x57, 0xe1, 0xf9, 0xef, 0x89, 0xe0, 0x5f, 0xc1, 0xc9, 0x45,
+  0x3f, 0x18, 0x86, 0xbc, 0x16, 0x32, 0x14, 0xdd, 0x44, 0xfa, 0x96, 0xaa, 0x7f, 0x8d, 0x12, 0x11,
+  0x10, 0x06, 0xe4, 0x9c, 0x1a, 0xc9, 0xc0, 0x72, 0x09, 0x29, 0xf7, 0x41, 0x36, 0xe7, 0x87, 0x9a,
+  0x8d, 0x83, 0xdc, 0x6b, 0xa4, 0x87, 0x9e, 0x4f, 0x3c, 0xc5, 0x25, 0x38, 0x0e, 0x46, 0xe2, 0x91,
+  0x42, 0x4f, 0x02, 0xf4, 0xad, 0xe1, 0x91, 0xd0, 0x81, 0x45, 0x9d, 0x58, 0x14, 0xf1, 0xad, 0xb2,
+  0x06, 0x02, 0xd2, 0x9b, 0xe9, 0x6e, 0xbd, 0x5e, 0x37, 0x2d, 0xec, 0xa0, 0xa2, 0x89, 0xb0, 0x61,
+  0x06, 0x4a, 0xb5, 0x24, 0x32, 0xef, 0x33, 0xb1, 0x29, 0x55, 0xdf, 0x8f, 0xf3, 0xf9, 0x34, 0xb9,
+  0x35, 0xb6, 0x10, 0xb5, 0x9e, 0x9a, 0xab, 0xd0, 0xe0, 0xf9, 0xc4, 0xc2, 0x90, 0x4b, 0xad, 0x9c,
+  0x4b, 0x07, 0x0f, 0xb8, 0x5c, 0x36, 0x5b, 0x16, 0x5a, 0x07, 0x4d, 0x88, 0x7d, 0xd7, 0x02, 0x27,
+  0x05, 0x3b, 0xb1, 0x6d, 0xcd, 0x22, 0xfa, 0xb6, 0x69, 0x63, 0xa7, 0x98, 0x98, 0xa9, 0xd6, 0x78,
+  0x9a, 0x1f, 0x1b, 0x1c, 0xd3, 0xbd, 0xc4, 0xd3, 0xfd, 0x19, 0x44, 0xa9, 0xcf, 0x3c, 0xcf, 0x27,
+  0x0e, 0x1e, 0x12, 0x9f, 0xeb, 0x74, 0x1f, 0x5b, 0x80, 0x48, 0x27, 0x1e, 0x08, 0x30, 0x71, 0x14,
+  0x87, 0x38, 0xe8, 0x0c, 0x14, 0x93, 0xd0, 0x52, 0x88, 0x3e, 0x9e, 0xfc, 0x33, 0x94, 0xc6, 0x06,
+  0x79, 0xcc, 0x8f, 0x73, 0x69, 0x17, 0xa5, 0x61, 0xa8, 0xd4, 0x62, 0x07, 0xe2, 0x92, 0xe0, 0x9b,
+  0x97, 0xaa, 0xe1, 0x39, 0x56, 0x37, 0x99, 0xc3, 0x78, 0x0c, 0x9c, 0x71, 0x5c, 0x90, 0x59, 0x5d,
+  0x59, 0x04, 0x04, 0x09, 0x8b, 0x6a, 0x2c, 0xed, 0x8a, 0xbc, 0x02, 0xd6, 0x34, 0x29, 0x51, 0x26,
+  0x17, 0x2e, 0xf1, 0x31, 0x33, 0x5e, 0x3c, 0x2a, 0x7c, 0x02, 0xaa, 0x7c, 0x09, 0x2a, 0x32, 0x87,
+  0x12, 0x60, 0xf5, 0x6b, 0xa0, 0x50, 0xbd, 0x00, 0x85, 0xaf, 0x81, 0xa2, 0x7c, 0x01, 0x8a, 0x5f,
+  0x03, 0x6b, 0x62, 0x02, 0xb4, 0x14, 0x0d, 0xad, 0x89, 0x87, 0xfe, 0x09, 0x27, 0xb3, 0xa4, 0xa5,
+  0xa1, 0x2a, 0xc6, 0xc7, 0x67, 0xdd, 0x44, 0x25, 0x2d, 0x8e, 0x06, 0x36, 0x89, 0x0a, 0xcb, 0x3e,
+  0xa5, 0x24, 0x06, 0x0b, 0x74, 0x91, 0xaa, 0xd4, 0x69, 0x3a, 0x69, 0x1b, 0x2b, 0xb9, 0xdc, 0xa5,
+  0xd2, 0x58, 0x02, 0xb2, 0xc9, 0xb8, 0x5a, 0x32, 0x19, 0x4f, 0x3c, 0xe4, 0x22, 0x6a, 0xc0, 0x21,
+  0xe9, 0xaa, 0x79, 0xc5, 0x4b, 0xda, 0x8e, 0xb5, 0xa4, 0xbf, 0xdf, 0x79, 0xd8, 0x06, 0x06, 0x52,
+  0x42, 0xcf, 0xba, 0xc9, 0x41, 0x10, 0x00, 0x25, 0xde, 0x97, 0x5d, 0xc7, 0xa0, 0x20, 0x1f, 0xd5,
+  0xc4, 0x02, 0x5e, 0xb4, 0x1f, 0xa7, 0x07, 0x7e, 0x70, 0x67, 0x90, 0x16, 0xfd, 0x3d, 0xcc, 0xe6,
+  0x66, 0x77, 0x6e, 0xd0, 0xd5, 0x1d, 0xdb, 0xb6, 0x26, 0x6a, 0x6b, 0x44, 0xff, 0x3a, 0xe8, 0xa5,
+  0xef, 0x0d, 0x19, 0xe1, 0xbe, 0xd7, 0x1e, 0x2d, 0xba, 0xab, 0x72, 0xb9, 0x2c, 0xb7, 0xfe, 0xfd,
+  0xaf, 0xf3, 0xf3, 0x7e, 0x23, 0x59, 0x6c, 0xa5, 0x0a, 0xd3, 0xd9, 0x93, 0x35, 0x6a, 0xf5, 0x37,
+  0x0f, 0x02, 0xbe, 0xb7, 0x77, 0xa1, 0xfc, 0x06, 0xeb, 0xfb, 0x9e, 0xec, 0xbe, 0xe9, 0x94, 0xdb,
+  0xf6, 0x67, 0xf3, 0x69, 0x7b, 0xf1, 0x73, 0x03, 0xea, 0xcf, 0x95, 0xb6, 0xea, 0xb7, 0x0e, 0x6a,
+  0x6b, 0xf6, 0x30, 0x5b, 0x10, 0xa1, 0xbc, 0xcf, 0x97, 0xdb, 0xf3, 0x2e, 0x5e, 0x39, 0x7d, 0xb2,
+  0xda, 0x92, 0x95, 0xb4, 0x69, 0x4d, 0x46, 0xc7, 0xa7, 0x9f, 0x6f, 0x83, 0x86, 0xbe, 0x98, 0x39,
+  0xfb, 0xce, 0xf1, 0xd0, 0x91, 0xb5, 0xde, 0x51, 0x1e, 0x9b, 0x2f, 0x8d, 0x9d, 0xdc, 0xb3, 0x0d,
+  0x73, 0xd5, 0x36, 0x77, 0x2d, 0xda, 0x15, 0xc7, 0x6d, 0xa3, 0x3a, 0xf6, 0x8f, 0xfb, 0xa9, 0x5e,
+  0x55, 0x55, 0xb5, 0x07, 0xcd, 0x89, 0xaa, 0x4d, 0xb7, 0x43, 0xd2, 0x9a, 0x08, 0xbb, 0xf2, 0x61,
+  0x39, 0x6f, 0xef, 0xee, 0x04, 0xe9, 0xe5, 0x18, 0x2c, 0xde, 0x96, 0x62, 0x17, 0xd6, 0x86, 0x8e,
+  0x31, 0x3e, 0xb5, 0xe7, 0x55, 0x95, 0x68, 0xb0, 0xdf, 0x99, 0x48, 0x64, 0xbc, 0xec, 0x4b, 0x8e,
+  0x3a, 0x3f, 0xc4, 0x27, 0x99, 0xcd, 0x17, 0x8f, 0xd3, 0x81, 0xa4, 0x3e, 0xf7, 0xfb, 0x3f, 0x72,
+  0xb7, 0xcd, 0xf3, 0x9f, 0x36, 0x82, 0x18, 0x70, 0x37, 0xb4, 0x5b, 0xb5, 0x2d, 0x0e, 0x8a, 0xac,
+  0x5b, 0x20, 0xda, 0x63, 0x1d, 0x15, 0x5d, 0x7c, 0x44, 0x56, 0x31, 0x6e, 0x43, 0x85, 0xab, 0xde,
+  0x16, 0x6e, 0x18, 0xcf, 0x43, 0xf4, 0x0a, 0x09, 0xd3, 0x74, 0x35, 0xaa, 0xd0, 0xc5, 0xb7, 0xd1,
+  0xaf, 0x42, 0x29, 0x5c, 0x6a, 0x87, 0x8b, 0xfe, 0x97, 0x1c, 0x0e, 0x63, 0x9f, 0x8d, 0x24, 0x87,
+  0xea, 0x7a, 0x94, 0x1f, 0x98, 0x8c, 0x30, 0x5c, 0xfc, 0x97, 0x1c, 0x7e, 0xc8, 0x67, 0xeb, 0xd1,
+  0x7b, 0x34, 0xe2, 0x95, 0x93, 0xe4, 0xb3, 0x3b, 0xeb, 0xbf, 0x4d, 0xef, 0x5e, 0xde, 0x73, 0x6a,
+  0x0c, 0x36, 0xea, 0x70, 0xc2, 0xec, 0xda, 0x49, 0x4e, 0x8d, 0x76, 0x1d, 0x76, 0xda, 0x2a, 0x19,
+  0x1d, 0xba, 0xdd, 0xd5, 0xd4, 0x1e, 0x58, 0x8b, 0x67, 0x61, 0x58, 0x2e, 0x0b, 0x0f, 0x43, 0xf3,
+  0xf4, 0xb6, 0xeb, 0xef, 0x66, 0x73, 0xc3, 0x38, 0xc9, 0xe1, 0xd1, 0x31, 0xd5, 0xa9, 0x34, 0x22,
+  0xf2, 0x71, 0x18, 0xe4, 0x2b, 0x22, 0x78, 0xa9, 0x1f, 0x0e, 0x86, 0xbf, 0xdf, 0x8f, 0x5b, 0x65,
+  0xb2, 0xde, 0x37, 0xf2, 0xa2, 0x28, 0x08, 0xe2, 0x7c, 0xb5, 0x72, 0x8c, 0xbd, 0x56, 0x5b, 0xf9,
+  0x3d, 0xf3, 0xb1, 0xbc, 0x20, 0x6a, 0x75, 0xea, 0xcf, 0xf6, 0x8d, 0xfb, 0xfa, 0x51, 0x6e, 0x3b,
+  0xcf, 0xc3, 0x65, 0xbe, 0xb5, 0x79, 0x92, 0x6a, 0x21, 0x2c, 0x87, 0x68, 0x3c, 0x82, 0x5a, 0xbd,
+  0x3f, 0x96, 0xdb, 0xbe, 0x5e, 0x46, 0x75, 0x53, 0x56, 0xd7, 0xdb, 0x46, 0xa5, 0x6a, 0x98, 0xfe,
+  0xc3, 0x6a, 0x39, 0x76, 0x3b, 0xaa, 0x68, 0xee, 0x1f, 0xf2, 0x9d, 0x8a, 0x54, 0xe3, 0x5b, 0x95,
+  0xc9, 0xf8, 0x71, 0x7a, 0x32, 0x65, 0x71, 0x31, 0x18, 0x6e, 0x36, 0x70, 0xbf, 0x1e, 0xf7, 0xec,
+  0x7c, 0x1e, 0x37, 0xba, 0xcb, 0x1d, 0x2f, 0x88, 0x32, 0xb5, 0xb9, 0x31, 0xcd, 0xa7, 0xbc, 0x08,
+  0xfb, 0x9a, 0xba, 0xcc, 0x2f, 0x37, 0x2f, 0xd8, 0x6e, 0xb4, 0x06, 0x5b, 0x71, 0xfe, 0x32, 0x72,
+  0x1c, 0xb5, 0x1b, 0xc6, 0xa1, 0xe9, 0x5a, 0xbd, 0xa7, 0xed, 0x2c, 0x9c, 0xd8, 0xaa, 0x4a, 0xeb,
+  0x23, 0x93, 0xc6, 0x78, 0xde, 0x70, 0x0d, 0x36, 0x82, 0xe3, 0x96, 0x3f, 0x9f, 0xe3, 0xe9, 0x7a,
+  0xb9, 0x7d, 0xab, 0xfc, 0xfb, 0x9d, 0xcc, 0xd6, 0xf1, 0x9c, 0xfe, 0x3c, 0x77, 0x10, 0x42, 0x29,
+  0xb5, 0xc8, 0xee, 0x9a, 0xcb, 0x00, 0xa1, 0x92, 0x59, 0x6a, 0x3a, 0x10, 0xea, 0xf5, 0x7a, 0x6c,
+  0x82, 0x33, 0xc5, 0x28, 0x51, 0x5c, 0x0c, 0x88, 0x4b, 0x2f, 0xfc, 0x74, 0xa3, 0x11, 0x3a, 0x72,
+  0xed, 0xe4, 0x16, 0xa3, 0xb0, 0xd2, 0x38, 0xba, 0xa2, 0xe4, 0x32, 0xe9, 0x62, 0x00, 0xd3, 0x74,
+  0x85, 0xde, 0xb9, 0x26, 0x08, 0x75, 0xa1, 0x26, 0xf0, 0x29, 0x20, 0x23, 0x98, 0xa5, 0xcf, 0xae,
+  0x08, 0x72, 0xdf, 0x24, 0x5d, 0x93, 0xa5, 0x54, 0xf5, 0xec, 0x5d, 0xf2, 0x17, 0x03, 0x06, 0x51,
+  0x76, 0x3e, 0x6a, 0xc4, 0x82, 0x67, 0x08, 0xa3, 0x2b, 0xf3, 0x8c, 0x7e, 0x25, 0x09, 0xd9, 0x34,
+  0x94, 0xac, 0xf5, 0x2e, 0xf7, 0x2d, 0x1b, 0x21, 0x01, 0x8c, 0xe8, 0xe8, 0x0c, 0xb0, 0x0e, 0xac,
+  0x74, 0xd8, 0x71, 0x34, 0x36, 0xcd, 0x73, 0xc9, 0x8c, 0x2e, 0x57, 0x71, 0x3c, 0x63, 0x93, 0x67,
+  0x49, 0x14, 0x78, 0xc0, 0xb9, 0x5c, 0xb2, 0xbc, 0xcf, 0x11, 0x17, 0xe8, 0x38, 0x38, 0x35, 0xdf,
+  0xc9, 0xb4, 0xe7, 0x99, 0x0c, 0x27, 0xf8, 0x1f, 0x88, 0x61, 0x3a, 0x84, 0xa9, 0x50, 0x33, 0x7d,
+  0xc3, 0x70, 0xe9, 0x23, 0x26, 0x55, 0xcd, 0x82, 0xf7, 0xdb, 0x23, 0x26, 0x8d, 0x51, 0x82, 0x50,
+  0x80, 0x1e, 0xe0, 0x3d, 0x8a, 0x52, 0xa3, 0xf4, 0xb9, 0xf0, 0x9d, 0xfb, 0x03, 0xdb, 0x2e, 0xf1,
+  0x02, 0xe0, 0x04, 0x17, 0xb5, 0x07, 0x80, 0x83, 0x2b, 0xfe, 0xf0, 0xfe, 0x99, 0x3d, 0x28, 0x4b,
+  0xd8, 0x61, 0xc7, 0x2d, 0x64, 0xd6, 0x1c, 0xf8, 0xb0, 0x33, 0x2b, 0xdc, 0x15, 0x47, 0xf8, 0x1a,
+  0xfb, 0xb2, 0xaf, 0xa9, 0xac, 0x3a, 0x2e, 0x2e, 0xe0, 0x0c, 0xf3, 0x77, 0x05, 0x55, 0x99, 0x7d,
+  0x97, 0xea, 0x64, 0xe5, 0x97, 0xa9, 0x66, 0x49, 0x92, 0x2e, 0x9c, 0x64, 0xa0, 0x5e, 0xe7, 0xa5,
+  0x75, 0xfa, 0x89, 0xf9, 0xd1, 0x91, 0xdd, 0x5f, 0x1e, 0xb1, 0xd0, 0x0f, 0x6c, 0x1b, 0xaf, 0xd1,
+  0xe5, 0x2a, 0xa6, 0xaf, 0x37, 0x1a, 0x67, 0x25, 0x81, 0xdc, 0x54, 0x6e, 0x9b, 0xbf, 0x11, 0xce,
+  0x0a, 0x4d, 0x36, 0xd0, 0x2c, 0x04, 0xb9, 0x5f, 0xe1, 0x65, 0x25, 0xd3, 0x3c, 0xff, 0x0d, 0x6d,
+  0x9d, 0xc0, 0x4a, 0x89, 0x0b, 0x00, 0x00};
+const char HTTP_STATIC_SCRIPT_ETAG[]  PROGMEM = "\"fd7d2a5a\"";
+const uint8_t HTTP_STATIC_SCRIPT_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0x92, 0xc1, 0x6a, 0xc3, 0x30,
+  0x0c, 0x86, 0x5f, 0xc5, 0x3d, 0xd9, 0x86, 0xcd, 0xbb, 0xcf, 0x84, 0xd1, 0x8d, 0x1e, 0x06, 0xbb,
+  0x75, 0xb7, 0xb1, 0x83, 0x1b, 0x2b, 0xad, 0xc1, 0x95, 0x33, 0xdb, 0x49, 0x5a, 0x92, 0xbe, 0xfb,
+  0x94, 0x90, 0x76, 0x85, 0x6d, 0x05, 0x43, 0x2c, 0x4b, 0xf9, 0xfd, 0xfd, 0xb2, 0xaa, 0x06, 0xcb,
+  0xec, 0x02, 0xb2, 0x52, 0x78, 0xd9, 0xdb, 0x50, 0x36, 0x7b, 0xc0, 0xac, 0xb6, 0x90, 0x57, 0x1e,
+  0xc6, 0xed, 0xf3, 0xf1, 0xd5, 0x0a, 0x9e, 0xb8, 0x54, 0xad, 0xf1, 0x0d, 0x14, 0x7e, 0xcc, 0x2d,
+  0x73, 0x8e, 0x6e, 0xd3, 0x64, 0x10, 0xdc, 0x9a, 0x6c, 0xee, 0x53, 0x72, 0x96, 0xcb, 0x61, 0xf0,
+  0xca, 0x21, 0x42, 0x7c, 0x87, 0x43, 0x1e, 0x83, 0x4c, 0xdf, 0x97, 0x80, 0x99, 0x64, 0x74, 0xcd,
+  0x0a, 0xe6, 0x15, 0xd2, 0xc9, 0x2c, 0xbc, 0x76, 0x1b, 0xef, 0x70, 0xab, 0x4a, 0x6f, 0x52, 0x7a,
+  0x73, 0x29, 0xab, 0x92, 0x4a, 0x8d, 0xc3, 0x24, 0xb8, 0xe7, 0x52, 0xff, 0xcb, 0x52, 0x13, 0x8b,
+  0x75, 0xc9, 0x6c, 0x3c, 0x58, 0x12, 0x5d, 0xd4, 0xda, 0x55, 0xa2, 0x96, 0x37, 0xeb, 0x2b, 0x4a,
+  0x26, 0x21, 0xf5, 0x49, 0x57, 0x67, 0xc3, 0x95, 0x90, 0xac, 0x6f, 0x4d, 0x64, 0x07, 0x12, 0xb9,
+  0xf5, 0xb3, 0x3e, 0xa8, 0x7c, 0xac, 0xa1, 0x28, 0x0a, 0x5e, 0x13, 0x6a, 0x17, 0xa2, 0xe5, 0x4f,
+  0xf3, 0x19, 0x1f, 0x2d, 0xf2, 0xc7, 0x73, 0x74, 0xc9, 0xeb, 0x53, 0xe7, 0xd0, 0x86, 0x4e, 0x19,
+  0x6b, 0x57, 0x2d, 0xa9, 0x8d, 0x06, 0x81, 0x5a, 0x43, 0xde, 0x82, 0xb1, 0xfc, 0xee, 0x8c, 0x21,
+  0xe4, 0xc4, 0x80, 0xc5, 0x85, 0xe0, 0xab, 0x81, 0x78, 0x5c, 0x83, 0x87, 0x32, 0x87, 0xb8, 0xf4,
+  0x5e, 0xf0, 0x8f, 0xa9, 0xc7, 0xd0, 0x7e, 0x12, 0x0b, 0x59, 0x5d, 0xa0, 0xf2, 0x80, 0xdb, 0xbc,
+  0x1b, 0x86, 0xc5, 0x7c, 0xcb, 0x74, 0xc5, 0x3a, 0x34, 0xb1, 0x04, 0x19, 0x21, 0x37, 0x11, 0xf5,
+  0xa8, 0x9a, 0x0a, 0x84, 0x8e, 0x5d, 0x25, 0x05, 0x7f, 0x80, 0x31, 0xa2, 0xe7, 0xd4, 0x48, 0x4d,
+  0x89, 0x2b, 0x53, 0xee, 0xc4, 0x85, 0x05, 0x64, 0x9f, 0x7e, 0x13, 0xc3, 0x5f, 0x2f, 0x0e, 0x2d,
+  0x97, 0x3f, 0x26, 0xf6, 0xb2, 0x27, 0x30, 0x3e, 0x4d, 0x08, 0x67, 0x0e, 0x19, 0x48, 0x98, 0xe7,
+  0x65, 0xaf, 0xc6, 0x7a, 0x0d, 0x3e, 0x01, 0x83, 0xeb, 0x89, 0x38, 0x67, 0x4e, 0x72, 0x5e, 0xdf,
+  0xd5, 0x0d, 0xdc, 0x79, 0x8b, 0x02, 0x00, 0x00};
+const char HTTP_HEAD_STATIC[]      PROGMEM = "<link rel='stylesheet' href='/static/style.css?v=5d9073eb'><script src='/static/script.js?v=fd7d2a5a'></script>"; // cache busting query, the assets are immutable
+
 #ifndef WM_NOHELP
 const char HTTP_HELP[]             PROGMEM =
  "<br/><h3>Available Pages</h3><hr>"
@@ -290,6 +413,8 @@ const char R_erase[]              PROGMEM = "/erase";
 const char R_status[]             PROGMEM = "/status";
 const char R_update[]             PROGMEM = "/update";
 const char R_updatedone[]         PROGMEM = "/u";
+const char R_static_style[]       PROGMEM = "/static/style.css";
+const char R_static_script[]      PROGMEM = "/static/script.js";
 
 
 //Strings
@@ -333,6 +458,9 @@ const char T_h[]                  PROGMEM = "{h}"; // @token h
 const char HTTP_HEAD_CL[]         PROGMEM = "Content-Length";
 const char HTTP_HEAD_CT[]         PROGMEM = "text/html";
 const char HTTP_HEAD_CT2[]        PROGMEM = "text/plain";
+const char HTTP_HEAD_CT_CSS[]     PROGMEM = "text/css";
+const char HTTP_HEAD_CT_JS[]      PROGMEM = "application/javascript";
+const char HTTP_HEAD_CACHE_IMMUTABLE[] PROGMEM = "public, max-age=31536000, immutable";
 const char HTTP_HEAD_CORS[]       PROGMEM = "Access-Control-Allow-Origin";
 const char HTTP_HEAD_CORS_ALLOW_ALL[]  PROGMEM = "*";
 
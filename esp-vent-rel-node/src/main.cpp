@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <EspNode.h>
+#include <EspNodeTelemetry.h>
 #include <EEPROM.h>
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
@@ -26,6 +27,10 @@ EspNode *espNode;
 
 #define DHT_S1_PIN 19
 #define DHT_S2_PIN 23
+#define DHT_TEMP_DEADBAND 0.5         // Temperature change needed to publish in °C
+#define DHT_HUMIDITY_DEADBAND 2       // Humidity change needed to publish in %
+#define DHT_MIN_INTERVAL 10000        // Min. time between two publishes of a value in ms
+#define DHT_HEARTBEAT 300000          // Max. time without a publish of a value in ms
 
 DHT_Unified dhtSensor1(DHT_S1_PIN, DHTTYPE);
 uint32_t dhtSensor1Delay = 0;
@@ -33,6 +38,8 @@ unsigned long dhtSensor1Millis = 0;
 int dhtSensor1Temp = 0;
 int dhtSensor1Humidity = 0;
 bool dhtSensor1Error = false;
+EspNodeTelemetry dhtSensor1TempTelemetry(DHT_TEMP_DEADBAND, 0, DHT_MIN_INTERVAL, DHT_HEARTBEAT);
+EspNodeTelemetry dhtSensor1HumidityTelemetry(DHT_HUMIDITY_DEADBAND, 0, DHT_MIN_INTERVAL, DHT_HEARTBEAT);
 
 DHT_Unified dhtSensor2(DHT_S2_PIN, DHTTYPE);
 uint32_t dhtSensor2Delay = 0;
@@ -40,6 +47,8 @@ unsigned long dhtSensor2Millis = 0;
 int dhtSensor2Temp = 0;
 int dhtSensor2Humidity = 0;
 bool dhtSensor2Error = false;
+EspNodeTelemetry dhtSensor2TempTelemetry(DHT_TEMP_DEADBAND, 0, DHT_MIN_INTERVAL, DHT_HEARTBEAT);
+EspNodeTelemetry dhtSensor2HumidityTelemetry(DHT_HUMIDITY_DEADBAND, 0, DHT_MIN_INTERVAL, DHT_HEARTBEAT);
 
 void dhtSetup();
 void dhtLoop();
@@ -74,6 +83,7 @@ const String ventSpeedMidText = String(F("2"));
 const String ventSpeedHighText = String(F("3"));
 
 ventSpeed ventSpeedCurrent = none; 
+const char *ventSpeedTopic;
 
 
 enum ventMode
@@ -88,11 +98,13 @@ const String ventModeSuckInText = String(F("suck_in"));
 const String ventModeBlowOutText = String(F("blow_out"));
 const String ventModePendingText = String(F("pending"));
 
-bool ventSendError = false;
 ventMode ventModeWanted = unknown;  // wanted is set to unknown at first
 ventMode ventModeCurrent = unknown; // at boot-up the current mode is unknown
 unsigned long ventModeTimerMillis = 0;
 const unsigned long long ventModeTimout = 90000;
+const unsigned long VENT_LOOP_PERIOD = 250; // Period of the vent task in ms
+const char *ventStateTopic;
+const char *ventModeTopic;
 
 void ventSetup();
 
@@ -111,7 +123,7 @@ ventMode ventGetMode();
 String ventGetModeText();
 ventMode ventGetModeFromText(String payload);
 void ventRefreshMode();
-void ventSendStatus(bool force);
+void ventSendStatus();
 
 void ventLoop();
 
@@ -119,22 +131,28 @@ void ventLoop();
 #define VENTREL_RELAY_PIN_0 32   // Relay pin 0
 #define VENTREL_RELAY_PIN_1 33   // Relay pin 1
 
+const char *ventRelRelay0Topic;
+const char *ventRelRelay1Topic;
+
 //***** MQTT & Web *****//
 
-void ventRelRcvCallback(String &topic, String &payload);
+void ventRelRelayCommand(uint8_t pin, String &payload);
 void ventRelAvailable();
 
+bool ventRelWebValues(const char *key, Print &out);
+bool ventRelWebSensorValue(const char *key, Print &out, int humidity, int temp);
 void webHandleVentRelay();
-
-const char HTML_VENTREL_STATE[] PROGMEM = "<b>Vent State</b><input id='ventState' readonly name='ventState' placeholder='unknown' value='{ventState}'>";
-const char HTML_VENTREL_SPEED[] PROGMEM = "<br/><b>Vent Speed</b><input id='ventSpeed' readonly name='ventSpeed' placeholder='unknown' value='{ventSpeed}'>";
-const char HTML_VENTREL_MODE[] PROGMEM = "<br/><b>Vent Mode</b><input id='ventMode' readonly name='ventMode' placeholder='unknown' value='{ventMode}'>";
-const char HTML_VENTREL_HUM_1[] PROGMEM = "<br/><br/><b>Humidity_1</b><input id='ventHum1' readonly name='ventHum1' type='number'placeholder='-1' value='{ventHum}'>";
-const char HTML_VENTREL_TEMP_1[] PROGMEM = "<br/><b>Temperature_1</b><input id='ventTemp1' readonly name='ventTemp1' type='number' placeholder='-1' value='{ventTemp}'>";
-const char HTML_VENTREL_HUM_2[] PROGMEM = "<br/><br/><b>Humidity_1</b><input id='ventHum2' readonly name='ventHum2' type='number'placeholder='-1' value='{ventHum}'>";
-const char HTML_VENTREL_TEMP_2[] PROGMEM = "<br/><b>Temperature_1</b><input id='ventTemp2' readonly name='ventTemp2' type='number' placeholder='-1' value='{ventTemp}'>";
-const char HTML_VENTREL_RELAY_0_STATE[] PROGMEM = "<br/><br/><b>Relay 0</b><input id='ventRelayState0' readonly name='ventRelayState0' placeholder='unknown' value='{ventRelayState}'>";
-const char HTML_VENTREL_RELAY_1_STATE[] PROGMEM = "<br/><b>Relay 1</b><input id='ventRelayState1' readonly name='ventRelayState1' placeholder='unknown' value='{ventRelayState}'>";
+void webJsonVentRelay(JsonObject json);
+
+const char HTML_VENTREL_STATE[] PROGMEM = "<b>Vent State</b><input id='ventState' data-ev='vent/state' readonly name='ventState' placeholder='unknown' value='{ventState}'>";
+const char HTML_VENTREL_SPEED[] PROGMEM = "<br/><b>Vent Speed</b><input id='ventSpeed' data-ev='vent/speed' readonly name='ventSpeed' placeholder='unknown' value='{ventSpeed}'>";
+const char HTML_VENTREL_MODE[] PROGMEM = "<br/><b>Vent Mode</b><input id='ventMode' data-ev='vent/mode' readonly name='ventMode' placeholder='unknown' value='{ventMode}'>";
+const char HTML_VENTREL_HUM_1[] PROGMEM = "<br/><br/><b>Humidity_1</b><input id='ventHum1' data-ev='sensor1/humidity' readonly name='ventHum1' type='number'placeholder='-1' value='{ventHum}'>";
+const char HTML_VENTREL_TEMP_1[] PROGMEM = "<br/><b>Temperature_1</b><input id='ventTemp1' data-ev='sensor1/temperature' readonly name='ventTemp1' type='number' placeholder='-1' value='{ventTemp}'>";
+const char HTML_VENTREL_HUM_2[] PROGMEM = "<br/><br/><b>Humidity_1</b><input id='ventHum2' data-ev='sensor2/humidity' readonly name='ventHum2' type='number'placeholder='-1' value='{ventHum}'>";
+const char HTML_VENTREL_TEMP_2[] PROGMEM = "<br/><b>Temperature_1</b><input id='ventTemp2' data-ev='sensor2/temperature' readonly name='ventTemp2' type='number' placeholder='-1' value='{ventTemp}'>";
+const char HTML_VENTREL_RELAY_0_STATE[] PROGMEM = "<br/><br/><b>Relay 0</b><input id='ventRelayState0' data-ev='relay/0' readonly name='ventRelayState0' placeholder='unknown' value='{ventRelayState}'>";
+const char HTML_VENTREL_RELAY_1_STATE[] PROGMEM = "<br/><b>Relay 1</b><input id='ventRelayState1' data-ev='relay/1' readonly name='ventRelayState1' placeholder='unknown' value='{ventRelayState}'>";
 const char HTML_VENTREL_BTN_BACK[] PROGMEM = "<hr><a href='/'><button>Back</button></a>";
 
 void setup()
@@ -142,6 +160,17 @@ void setup()
   espNode = new EspNode(nodeName, fwName, fwVersion);
   espNode->setup();
 
+  // Intern the topics once, published without building strings
+  dhtSensor1TempTelemetry.begin(espNode, "sensor1/temperature");
+  dhtSensor1HumidityTelemetry.begin(espNode, "sensor1/humidity");
+  dhtSensor2TempTelemetry.begin(espNode, "sensor2/temperature");
+  dhtSensor2HumidityTelemetry.begin(espNode, "sensor2/humidity");
+  ventSpeedTopic = espNode->mqttInternNodeTopic("vent/speed");
+  ventStateTopic = espNode->mqttInternNodeTopic("vent/state");
+  ventModeTopic = espNode->mqttInternNodeTopic("vent/mode");
+  ventRelRelay0Topic = espNode->mqttInternNodeTopic("relay/0");
+  ventRelRelay1Topic = espNode->mqttInternNodeTopic("relay/1");
+
   dhtSetup();
 
   ventSetup();
@@ -152,22 +181,32 @@ void setup()
   pinMode(VENTREL_RELAY_PIN_1, OUTPUT);
   digitalWrite(VENTREL_RELAY_PIN_1, HIGH); // init with HIGH - relay active low
 
-  // Register mqtt callback
-  espNode->mqttRcvAddCallback(ventRelRcvCallback);
+  // Register mqtt callback and commands
   espNode->mqttAvailableAddCallback(ventRelAvailable);
+  espNode->mqttOnCommand("vent/speed", [](String &payload)
+                         { ventSetSpeed(ventGetSpeedFromText(payload)); });
+  espNode->mqttOnCommand("vent/state", [](String &payload)
+                         { ventSetState(ventGetStateFromText(payload)); });
+  espNode->mqttOnCommand("vent/mode", [](String &payload)
+                         { ventSetMode(ventGetModeFromText(payload)); });
+  espNode->mqttOnCommand("relay/0", [](String &payload)
+                         { ventRelRelayCommand(VENTREL_RELAY_PIN_0, payload); });
+  espNode->mqttOnCommand("relay/1", [](String &payload)
+                         { ventRelRelayCommand(VENTREL_RELAY_PIN_1, payload); });
 
   // Register web handles
   espNode->webRegisterHandler("/ventRel", webHandleVentRelay);
   espNode->webAddButtonHandler("/ventRel", "Ventilation & Relay");
+  espNode->webRegisterJsonProvider("vent", webJsonVentRelay);
+
+  // Register tasks, the dht sensors are polled at their minimum delay
+  espNode->taskAdd("dht", dhtLoop, max(dhtSensor1Delay, dhtSensor2Delay), 1000, TASK_PRIO_LOW);
+  espNode->taskAdd("vent", ventLoop, VENT_LOOP_PERIOD, 100, TASK_PRIO_NORMAL);
 }
 
 void loop()
 {
   espNode->loop();
-
-  dhtLoop();
-
-  ventLoop();
 }
 
 void dhtSetupSensor(DHT_Unified *dht, String sensorText, uint32_t *sensorDelay, unsigned long *sensorMillis, boolean *sensorError)
@@ -208,7 +247,7 @@ void dhtSetupSensor(DHT_Unified *dht, String sensorText, uint32_t *sensorDelay,
   *sensorError = false;
 }
 
-void dhtReadSensor(DHT_Unified *dht, String sensorText, uint32_t *sensorDelay, unsigned long *sensorMillis, boolean *sensorError, int *sensorTemp, int *sensorHumidity)
+void dhtReadSensor(DHT_Unified *dht, String sensorText, uint32_t *sensorDelay, unsigned long *sensorMillis, boolean *sensorError, int *sensorTemp, int *sensorHumidity, EspNodeTelemetry *tempTelemetry, EspNodeTelemetry *humidityTelemetry)
 {
   // Check the delay
   unsigned long millisPassed = millis() - *sensorMillis;
@@ -229,13 +268,12 @@ void dhtReadSensor(DHT_Unified *dht, String sensorText, uint32_t *sensorDelay, u
   {
     *sensorError = false;
 
-    bool changed = (*sensorTemp != int(event.temperature));
     *sensorTemp = event.temperature;
 
-    if (changed)
+    // Published once it moved out of the deadband, noise around a degree doesn't flap
+    if (tempTelemetry->update(event.temperature))
     {
       espNode->debugPrintln(String(F(" * DHT: ")) + sensorText + String(F(" temperature read - ")) + String(*sensorTemp) + String(F("°C")));
-      espNode->mqttSend(espNode->mqttGetNodeTopic(sensorText + String(F("/temperature"))), String(*sensorTemp));
     }
   }
 
@@ -250,13 +288,11 @@ void dhtReadSensor(DHT_Unified *dht, String sensorText, uint32_t *sensorDelay, u
   {
     *sensorError = false;
 
-    bool changed = (*sensorHumidity != int(event.relative_humidity));
     *sensorHumidity = event.relative_humidity;
 
-    if (changed)
+    if (humidityTelemetry->update(event.relative_humidity))
     {
       espNode->debugPrintln(String(F(" * DHT: ")) + sensorText + String(F(" humidity read - ")) + String(*sensorHumidity) + String(F("%")));
-      espNode->mqttSend(espNode->mqttGetNodeTopic(sensorText + String(F("/humidity"))), String(*sensorHumidity));
     }
   }
 }
@@ -269,8 +305,8 @@ void dhtSetup()
 
 void dhtLoop()
 {
-  dhtReadSensor(&dhtSensor1, F("sensor1"), &dhtSensor1Delay, &dhtSensor1Millis, &dhtSensor1Error, &dhtSensor1Temp, &dhtSensor1Humidity);
-  dhtReadSensor(&dhtSensor2, F("sensor2"), &dhtSensor2Delay, &dhtSensor2Millis, &dhtSensor2Error, &dhtSensor2Temp, &dhtSensor2Humidity);
+  dhtReadSensor(&dhtSensor1, F("sensor1"), &dhtSensor1Delay, &dhtSensor1Millis, &dhtSensor1Error, &dhtSensor1Temp, &dhtSensor1Humidity, &dhtSensor1TempTelemetry, &dhtSensor1HumidityTelemetry);
+  dhtReadSensor(&dhtSensor2, F("sensor2"), &dhtSensor2Delay, &dhtSensor2Millis, &dhtSensor2Error, &dhtSensor2Temp, &dhtSensor2Humidity, &dhtSensor2TempTelemetry, &dhtSensor2HumidityTelemetry);
 }
 
 void ventSetup()
@@ -292,7 +328,7 @@ void ventSetup()
   ventSetState(off, true);
   ventSetSpeed(low, true);
   ventSetMode(suck_in, true); // setup to suck mode on start up - air will flow through the filter into the room
-  ventSendStatus(true);
+  ventSendStatus();
 }
 
 void ventSetSpeed(ventSpeed speed, bool silent)
@@ -309,13 +345,13 @@ void ventSetSpeed(ventSpeed speed, bool silent)
 
   if (!silent) // send change silence is false
   {
-    ventSendStatus(true);
+    ventSendStatus();
   }
 }
 
 ventSpeed ventGetSpeed()
 {
-  espNode->debugPrintln(String(F("VENT: Read speed pwm/")) + String(ventSpeedCurrent));
+  espNode->debugLog(DEBUG_LEVEL_DEBUG, PSTR("VENT: Read speed pwm/%d"), (int)ventSpeedCurrent);
 
   return static_cast<ventSpeed>(ventSpeedCurrent);
 }
@@ -336,7 +372,7 @@ String ventGetSpeedText()
     return ventSpeedHighText;
 
   default:
-    espNode->debugPrintln(String(F("VENT: Unknown speed '")) + String(speedVal) + String(F("'...reset.")));
+    espNode->debugLog(DEBUG_LEVEL_WARN, PSTR("VENT: Unknown speed '%d'...reset."), (int)speedVal);
     return "unknown";
   }
 }
@@ -352,7 +388,7 @@ ventSpeed ventGetSpeedFromText(String payload)
   if (ventSpeedHighText.equals(payload))
     return high;
 
-  espNode->debugPrintln(String(F("VENT: Unknown speed payload '")) + payload + String(F("'...reset.")));
+  espNode->debugLog(DEBUG_LEVEL_WARN, PSTR("VENT: Unknown speed payload '%s'...reset."), payload.c_str());
   return ventGetSpeed();
 }
 
@@ -387,7 +423,7 @@ void ventSetState(ventState state, bool silent)
 
       if (!silent) // send change silence is false
       {
-        ventSendStatus(true);
+        ventSendStatus();
       }
     }
     else
@@ -399,13 +435,13 @@ void ventSetState(ventState state, bool silent)
 
       if (!silent) // send change silence is false
       {
-        ventSendStatus(true);
+        ventSendStatus();
       }
     }
   }
   else
   {
-    espNode->debugPrintln(String(F("VENT: State unchanged.")));
+    espNode->debugLog(DEBUG_LEVEL_DEBUG, PSTR("VENT: State unchanged."));
   }
 }
 
@@ -414,7 +450,7 @@ ventState ventGetState()
   int stateVal = digitalRead(VENT_STATE_PIN);
   ventState state = (stateVal == on ? on : off);
 
-  espNode->debugPrintln(String(F("VENT: Read state - ")) + (state == on ? String(F("ON")) : String(F("OFF"))));
+  espNode->debugLog(DEBUG_LEVEL_DEBUG, PSTR("VENT: Read state - %s"), (state == on) ? "ON" : "OFF");
   return state;
 }
 
@@ -430,7 +466,7 @@ String ventGetStateText()
     return ventStateOffText;
 
   default:
-    espNode->debugPrintln(String(F("VENT: Unknown state '")) + String(sateVal) + String(F("'...reset.")));
+    espNode->debugLog(DEBUG_LEVEL_WARN, PSTR("VENT: Unknown state '%d'...reset."), (int)sateVal);
     return "unknown";
   }
 }
@@ -442,7 +478,7 @@ ventState ventGetStateFromText(String payload)
   if (ventStateOffText.equals(payload))
     return off;
 
-  espNode->debugPrintln(String(F("VENT: Unknown state payload '")) + payload + String(F("'...reset.")));
+  espNode->debugLog(DEBUG_LEVEL_WARN, PSTR("VENT: Unknown state payload '%s'...reset."), payload.c_str());
   return ventGetState();
 }
 
@@ -479,7 +515,7 @@ void ventSetMode(ventMode mode, bool silent)
 
     if (!silent) // send change silence is false
     {
-      ventSendStatus(true);
+      ventSendStatus();
     }
   }
 }
@@ -538,87 +574,89 @@ void ventRefreshMode()
       digitalWrite(VENT_FLAP_SUCKIN_PIN, HIGH);  // set desired flap state closed - inactive relay mode
       digitalWrite(VENT_FLAP_BLOWOUT_PIN, HIGH); // set desired flap state closed - inactive relay mode
 
-      ventSendStatus(true);
+      ventSendStatus();
     }
   }
 }
 
-void ventSendStatus(bool force)
+void ventSendStatus()
 {
-  if (force || ventSendError)
-  {
-    ventSendError = !(espNode->mqttSend(espNode->mqttGetNodeTopic(F("vent/speed")), ventGetSpeedText()) && espNode->mqttSend(espNode->mqttGetNodeTopic(F("vent/state")), ventGetStateText()) && espNode->mqttSend(espNode->mqttGetNodeTopic(F("vent/mode")), ventGetModeText()));
-    espNode->debugPrintln(String(F("VENT: Send status via mqtt.")));
-  }
+  espNode->mqttSend(ventSpeedTopic, ventGetSpeedText());
+  espNode->mqttSend(ventStateTopic, ventGetStateText());
+  espNode->mqttSend(ventModeTopic, ventGetModeText());
+  espNode->debugPrintln(String(F("VENT: Send status via mqtt.")));
 }
 
 void ventLoop()
 {
   ventRefreshMode();
-  ventSendStatus(false);
 }
 
-void ventRelRcvCallback(String &topic, String &payload)
+void ventRelRelayCommand(uint8_t pin, String &payload)
 {
-  espNode->debugPrintln(String(F("VENT: Message arrived on topic: '")) + topic + String(F("' with payload: '")) + payload + String(F("'.")));
+  espNode->debugPrintln(String(F("VENT: Relay command on pin ")) + String(pin) + String(F(" with payload: '")) + payload + String(F("'.")));
 
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(F("vent/speed"))))
-  {
-    ventSetSpeed(ventGetSpeedFromText(payload));
+  if (payload.equals(espNode->mqttGetOnOffPayload(true))) {
+    digitalWrite(pin, LOW);   // relay is active low
   }
 
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(F("vent/state"))))
-  {
-    ventSetState(ventGetStateFromText(payload));
+  if (payload.equals(espNode->mqttGetOnOffPayload(false))) {
+    digitalWrite(pin, HIGH);
   }
 
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(F("vent/mode"))))
-  {
-    ventSetMode(ventGetModeFromText(payload));
+  if (payload.equals(String(F("toogle")))) {
+    digitalWrite(pin, !digitalRead(pin));
   }
 
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(String(F("relay/0")))))
-  {
-    if (payload.equals(espNode->mqttGetOnOffPayload(true))) {
-      digitalWrite(VENTREL_RELAY_PIN_0, LOW);   // relay is active low
-    }
+  ventRelAvailable();
+}
 
-    if (payload.equals(espNode->mqttGetOnOffPayload(false))) {
-      digitalWrite(VENTREL_RELAY_PIN_0, HIGH);
-    }
+void ventRelAvailable()
+{
+  ventSendStatus();
 
-    if (payload.equals(String(F("toogle")))) {
-      digitalWrite(VENTREL_RELAY_PIN_0, !digitalRead(VENTREL_RELAY_PIN_0));
-    }
+  // relay is active low
+  espNode->mqttSend(ventRelRelay0Topic, espNode->mqttGetOnOffPayload(!digitalRead(VENTREL_RELAY_PIN_0)));
+  espNode->mqttSend(ventRelRelay1Topic, espNode->mqttGetOnOffPayload(!digitalRead(VENTREL_RELAY_PIN_1)));
+}
 
-    ventRelAvailable();
+bool ventRelWebValues(const char *key, Print &out)
+{
+  // Fills the vent placeholders, written straight into the node's send buffer
+  if (strcmp_P(key, PSTR("ventState")) == 0)
+  {
+    out.print(ventGetStateText());
   }
-
-  if (topic.equals(espNode->mqttGetNodeCmdTopic(String(F("relay/1")))))
+  else if (strcmp_P(key, PSTR("ventSpeed")) == 0)
   {
-    if (payload.equals(espNode->mqttGetOnOffPayload(true))) {
-      digitalWrite(VENTREL_RELAY_PIN_1, LOW);  // relay is active low
-    }
-
-    if (payload.equals(espNode->mqttGetOnOffPayload(false))) {
-      digitalWrite(VENTREL_RELAY_PIN_1, HIGH);
-    }
-
-    if (payload.equals(String(F("toogle")))) {
-      digitalWrite(VENTREL_RELAY_PIN_1, !digitalRead(VENTREL_RELAY_PIN_1));
-    }
-
-    ventRelAvailable();
+    out.print(ventGetSpeedText());
+  }
+  else if (strcmp_P(key, PSTR("ventMode")) == 0)
+  {
+    out.print(ventGetModeText());
+  }
+  else
+  {
+    return false;
   }
+  return true;
 }
 
-void ventRelAvailable()
+bool ventRelWebSensorValue(const char *key, Print &out, int humidity, int temp)
 {
-  ventSendStatus(true);
-
-  // relay is active low
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("relay/0"))), espNode->mqttGetOnOffPayload(!digitalRead(VENTREL_RELAY_PIN_0)));
-  espNode->mqttSend(espNode->mqttGetNodeTopic(String(F("relay/1"))), espNode->mqttGetOnOffPayload(!digitalRead(VENTREL_RELAY_PIN_1)));
+  if (strcmp_P(key, PSTR("ventHum")) == 0)
+  {
+    out.print(humidity);
+  }
+  else if (strcmp_P(key, PSTR("ventTemp")) == 0)
+  {
+    out.print(temp);
+  }
+  else
+  {
+    return false;
+  }
+  return true;
 }
 
 void webHandleVentRelay()
@@ -627,14 +665,19 @@ void webHandleVentRelay()
 
   espNode->webStartHttpMsg(String(F("Ventilation & Relay")), 200);
 
-  espNode->webSendHttpContent(HTML_VENTREL_STATE, String(F("{ventState}")), ventGetStateText());
-  espNode->webSendHttpContent(HTML_VENTREL_SPEED, String(F("{ventSpeed}")), ventGetSpeedText());
-  espNode->webSendHttpContent(HTML_VENTREL_MODE, String(F("{ventMode}")), ventGetModeText());
+  espNode->webSendTemplate(HTML_VENTREL_STATE, ventRelWebValues);
+  espNode->webSendTemplate(HTML_VENTREL_SPEED, ventRelWebValues);
+  espNode->webSendTemplate(HTML_VENTREL_MODE, ventRelWebValues);
 
-  espNode->webSendHttpContent(HTML_VENTREL_HUM_1, String(F("{ventHum}")), String(dhtSensor1Humidity));
-  espNode->webSendHttpContent(HTML_VENTREL_TEMP_1, String(F("{ventTemp}")), String(dhtSensor1Temp));
-  espNode->webSendHttpContent(HTML_VENTREL_HUM_2, String(F("{ventHum}")), String(dhtSensor2Humidity));
-  espNode->webSendHttpContent(HTML_VENTREL_TEMP_2, String(F("{ventTemp}")), String(dhtSensor2Temp));
+  // Both sensors share their templates, the sensor is picked per fragment
+  espNode->webSendTemplate(HTML_VENTREL_HUM_1, [](const char *key, Print &out)
+                           { return ventRelWebSensorValue(key, out, dhtSensor1Humidity, dhtSensor1Temp); });
+  espNode->webSendTemplate(HTML_VENTREL_TEMP_1, [](const char *key, Print &out)
+                           { return ventRelWebSensorValue(key, out, dhtSensor1Humidity, dhtSensor1Temp); });
+  espNode->webSendTemplate(HTML_VENTREL_HUM_2, [](const char *key, Print &out)
+                           { return ventRelWebSensorValue(key, out, dhtSensor2Humidity, dhtSensor2Temp); });
+  espNode->webSendTemplate(HTML_VENTREL_TEMP_2, [](const char *key, Print &out)
+                           { return ventRelWebSensorValue(key, out, dhtSensor2Humidity, dhtSensor2Temp); });
 
   espNode->webSendHttpContent(HTML_VENTREL_RELAY_0_STATE,String(F("{ventRelayState}")), String(espNode->mqttGetOnOffPayload(!digitalRead(VENTREL_RELAY_PIN_0))));
   espNode->webSendHttpContent(HTML_VENTREL_RELAY_1_STATE,String(F("{ventRelayState}")), String(espNode->mqttGetOnOffPayload(!digitalRead(VENTREL_RELAY_PIN_1))));
@@ -646,3 +689,25 @@ void webHandleVentRelay()
 
   espNode->debugPrintln(String(F("HTTP: webHandleVent page sent.")));
 }
+
+void webJsonVentRelay(JsonObject json)
+{
+  // Same values as the vent page, the relays are active low
+  json["ventState"] = ventGetStateText();
+  json["ventSpeed"] = ventGetSpeedText();
+  json["ventMode"] = ventGetModeText();
+
+  JsonArray sensors = json.createNestedArray("sensors");
+  JsonObject sensor1 = sensors.createNestedObject();
+  sensor1["humidity"] = dhtSensor1Humidity;
+  sensor1["temperature"] = dhtSensor1Temp;
+  sensor1["error"] = dhtSensor1Error;
+  JsonObject sensor2 = sensors.createNestedObject();
+  sensor2["humidity"] = dhtSensor2Humidity;
+  sensor2["temperature"] = dhtSensor2Temp;
+  sensor2["error"] = dhtSensor2Error;
+
+  JsonArray relays = json.createNestedArray("ventRelayState");
+  relays.add(digitalRead(VENTREL_RELAY_PIN_0) == LOW);
+  relays.add(digitalRead(VENTREL_RELAY_PIN_1) == LOW);
+}